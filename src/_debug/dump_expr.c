@@ -77,6 +77,9 @@ void dump_init(FILE *fp, const Initializer *init) {
     fprintf(fp, "[%zu]=", init->bracket.index);
     dump_init(fp, init->bracket.value);
     break;
+  case IK_EMBED:
+    fprintf(fp, "%.*s", (int)(init->token->end - init->token->begin), init->token->begin);
+    break;
   }
 }
 
@@ -337,6 +337,7 @@ void do_dump_ir(Vector *decls) {
     FuncBackend *fnbe = func->extra;
     curfunc = func;
     curra = fnbe->ra;
+    curarena = fnbe->arena;
 
     optimize(fnbe->ra, fnbe->bbcon);
 
@@ -355,6 +356,7 @@ void do_dump_ir(Vector *decls) {
 
     curfunc = NULL;
     curra = NULL;
+    curarena = NULL;
 
     dump_func_ir(func);
   }
@@ -407,10 +409,7 @@ int main(int argc, char *argv[]) {
       break;
 
     case OPT_SSA:
-      {
-        extern bool apply_ssa;
-        apply_ssa = true;
-      }
+      enable_pass("ssa", true);
       break;
 
     case '?':
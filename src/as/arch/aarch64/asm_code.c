@@ -28,7 +28,7 @@ void make_code32(Inst *inst, Code *code, unsigned int *buf, int len) {
 }
 
 static inline bool assemble_error(ParseInfo *info, const char *message) {
-  parse_error(info, message);
+  parse_asm_error(info, message);
   return false;
 }
 
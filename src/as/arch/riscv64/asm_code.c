@@ -38,7 +38,7 @@ static inline bool is_im12(int64_t x) {
 }
 
 static inline bool assemble_error(ParseInfo *info, const char *message) {
-  parse_error(info, message);
+  parse_asm_error(info, message);
   return false;
 }
 
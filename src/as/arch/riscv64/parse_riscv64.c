@@ -310,11 +310,11 @@ static bool parse_indirect_register(ParseInfo *info, Expr *offset, Operand *oper
   // Already read "(".
   enum RegType base_reg = find_register(&info->p);
   if (base_reg == NOREG) {
-    parse_error(info, "register expected");
+    parse_asm_error(info, "register expected");
     return false;
   }
   if (*info->p != ')') {
-    parse_error(info, "`)' expected");
+    parse_asm_error(info, "`)' expected");
     return false;
   }
   ++info->p;
@@ -354,7 +354,7 @@ unsigned int parse_operand(ParseInfo *info, unsigned int opr_flag, Operand *oper
     }
   }
 
-  Expr *expr = parse_expr(info);
+  Expr *expr = parse_asm_expr(info);
   if (opr_flag & IND) {
     if (*info->p == '(') {
       info->p += 1;
@@ -39,7 +39,7 @@ static inline bool opr_reg8(const Reg *reg) {
 }
 
 static inline bool assemble_error(ParseInfo *info, const char *message) {
-  parse_error(info, message);
+  parse_asm_error(info, message);
   return false;
 }
 
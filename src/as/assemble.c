@@ -0,0 +1,218 @@
+#include "../config.h"
+#include "assemble.h"
+
+#include <assert.h>
+#include <stdlib.h>  // qsort
+#include <string.h>
+
+#include "asm_code.h"
+#include "ir_asm.h"
+#include "parse_asm.h"
+#include "table.h"
+#include "util.h"
+
+#define PROG_START      (0x100)
+#define START_ADDRESS   (0x01000000 + PROG_START)
+#define LOAD_ADDRESS    START_ADDRESS
+
+ParseInfo *new_parse_info(const char *filename) {
+  Table *section_infos = alloc_table();
+  Table *label_table = alloc_table();
+
+  ParseInfo *info = calloc_or_die(sizeof(*info));
+  info->filename = filename;
+  info->lineno = 0;
+  info->error_count = 0;
+  info->block_comment = false;
+  info->section_infos = section_infos;
+  info->label_table = label_table;
+  info->rawline = info->p = NULL;
+  info->prefetched = NULL;
+  set_current_section(info, kSecText, kSegText, SF_EXECUTABLE);
+  return info;
+}
+
+// Skip comments, and returns the position where the instruction starts, or NULL.
+static const char *skip_line_comment(ParseInfo *info, const char *p) {
+  bool wait_line_end = false;
+  for (;;) {
+    if (!info->block_comment) {
+      const char *q = block_comment_start(p);
+      if (q != NULL) {
+        info->block_comment = true;
+        p = q + 2;
+      }
+    }
+    if (info->block_comment) {
+      p = block_comment_end(p);
+      if (p == NULL)
+        return NULL;  // Continue block comment.
+      info->block_comment = false;
+      wait_line_end = true;
+      continue;
+    }
+
+    p = skip_whitespaces(p);
+    if (*p == '/' && p[1] == '/')  // Line comment.
+      return NULL;
+
+    if (wait_line_end) {
+      if (*p != '\0')
+        parse_asm_error(info, "Line end expected");
+      return NULL;
+    }
+    return p;
+  }
+}
+
+static void assemble_parsed(ParseInfo *info, SectionInfo *section, const Line *line) {
+  Vector *irs = section->irs;
+  if (line->label != NULL) {
+    vec_push(irs, new_ir_label(line->label));
+
+    if (!add_label_table(info->label_table, line->label, section, true, false))
+      ++info->error_count;
+  }
+
+  if (line->dir != NODIRECTIVE)
+    return;
+
+  if (line->inst != NULL) {
+    Code code;
+    assemble_inst(line->inst, info, &code);
+    if (code.len > 0)
+      vec_push(irs, new_ir_code(&code));
+  }
+}
+
+void assemble_line(ParseInfo *info, const char *rawline) {
+  ++info->lineno;
+  info->rawline = rawline;
+  const char *p = skip_line_comment(info, rawline);
+  if (p == NULL)
+    return;
+  info->p = p;
+
+  SectionInfo *section = info->current_section;
+  Line line;
+  if (!parse_line(&line, info))
+    return;
+  assemble_parsed(info, section, &line);
+}
+
+void assemble_label(ParseInfo *info, const char *label) {
+  ++info->lineno;
+  info->rawline = label;
+  const Name *name = unquote_label(label, label + strlen(label));
+  if (name == NULL) {
+    parse_asm_error(info, "Illegal label");
+    return;
+  }
+  Line line = {.label = name, .inst = NULL, .dir = NODIRECTIVE};
+  assemble_parsed(info, info->current_section, &line);
+}
+
+void assemble_op(ParseInfo *info, const char *op, const char **operands, int count) {
+  ++info->lineno;
+  info->rawline = op;
+  SectionInfo *section = info->current_section;
+  Line line;
+  if (!parse_op(&line, info, op, operands, count))
+    return;
+  assemble_parsed(info, section, &line);
+}
+
+static LabelInfo *make_label_referred(Table *label_table, const Name *label, bool und) {
+  LabelInfo *label_info = table_get(label_table, label);
+  if (label_info == NULL) {
+    if (!und)
+      return NULL;
+    label_info = add_label_table(label_table, label, NULL, false, true);
+  }
+  label_info->flag |= LF_REFERRED;
+  return label_info;
+}
+
+static void fix_section_size(Vector *sections, uintptr_t start_address) {
+  uintptr_t addr = start_address;
+  for (int i = 0; i < sections->len; ++i) {
+    SectionInfo *section = sections->data[i];
+    if ((section->flag & SF_BSS ? section->bss_size : section->ds->len) <= 0)
+      continue;
+    section->start_address = addr = ALIGN(addr, section->align);
+    addr += (section->flag & SF_BSS) ? section->bss_size : section->ds->len;
+  }
+}
+
+static inline int section_key(const SectionInfo *p) {
+  int flag = p->flag;
+  // if (flag & SF_BSS)
+  //   return 4;
+  // if (flag & SF_EXECUTABLE)
+  //   return 1;
+  // if (flag & SF_WRITABLE)
+  //   return 3;
+  // return 2;
+
+  // .text(0), .rodata(1), .data(2), .bss(6)
+  return (flag & (SF_BSS | SF_WRITABLE | SF_EXECUTABLE)) ^ SF_EXECUTABLE;
+}
+
+static int cmp_section(const void *pa, const void *pb) {
+  const SectionInfo *sa = *(const SectionInfo**)pa;
+  int ka = section_key(sa);
+  const SectionInfo *sb = *(const SectionInfo**)pb;
+  int kb = section_key(sb);
+  int d = ka - kb;
+  if (d != 0)
+    return d;
+  return pa < pb ? -1 : 1;
+}
+
+static Vector *sort_sections(Table *section_infos) {
+  Vector *sections = new_vector();
+  const Name *name;
+  SectionInfo *section;
+  for (int it = 0; (it = table_iterate(section_infos, it, &name, (void**)&section)) != -1; )
+    vec_push(sections, section);
+  qsort(sections->data, sections->len, sizeof(void*), cmp_section);
+  return sections;
+}
+
+int emit_asm_obj(ParseInfo *info, const char *ofn) {
+  if (info->block_comment) {
+    parse_asm_error(info, "Block comment not closed");
+    info->block_comment = false;
+  }
+  if (info->error_count != 0)
+    return 1;
+
+  Table *label_table = info->label_table;
+  Vector *sections = sort_sections(info->section_infos);
+  Vector *unresolved = new_vector();
+  bool settle1, settle2;
+  do {
+    settle1 = calc_label_address(LOAD_ADDRESS, sections, label_table);
+    settle2 = resolve_relative_address(sections, label_table, unresolved);
+  } while (!(settle1 && settle2));
+
+  for (int i = 0; i < unresolved->len; ++i) {
+    UnresolvedInfo *u = unresolved->data[i];
+    make_label_referred(label_table, u->label, true);
+  }
+
+  emit_irs(sections);
+
+  fix_section_size(sections, LOAD_ADDRESS);
+
+#if XCC_TARGET_PLATFORM == XCC_PLATFORM_APPLE
+  extern int emit_macho_obj(const char *ofn, Vector *sections, Table *label_table,
+                            Vector *unresolved);
+# define EMIT_OBJ emit_macho_obj
+#else
+  extern int emit_elf_obj(const char *ofn, Vector *sections, Table *label_table,
+                          Vector *unresolved);
+# define EMIT_OBJ emit_elf_obj
+#endif
+  return EMIT_OBJ(ofn, sections, label_table, unresolved);
+}
@@ -0,0 +1,13 @@
+// Assembler driver
+//
+// Used by `as`, and also by `cc1` as an integrated assembler.
+
+#pragma once
+
+typedef struct ParseInfo ParseInfo;
+
+ParseInfo *new_parse_info(const char *filename);
+void assemble_line(ParseInfo *info, const char *rawline);
+void assemble_label(ParseInfo *info, const char *label);
+void assemble_op(ParseInfo *info, const char *op, const char **operands, int count);
+int emit_asm_obj(ParseInfo *info, const char *ofn);
@@ -144,7 +144,7 @@ LabelInfo *add_label_table(Table *label_table, const Name *label, SectionInfo *s
   return info;
 }
 
-bool parse_error(ParseInfo *info, const char *message) {
+bool parse_asm_error(ParseInfo *info, const char *message) {
   fprintf(stderr, "%s(%d): %s\n", info->filename, info->lineno, message);
   fprintf(stderr, "%s\n", info->rawline);
   ++info->error_count;
@@ -211,7 +211,7 @@ static const char *get_label_end(ParseInfo *info) {
     for (;;) {
       char c = *p;
       if (c == '\0') {
-        parse_error(info, "String not closed");
+        parse_asm_error(info, "String not closed");
         break;
       }
 
@@ -229,7 +229,7 @@ static const char *get_label_end(ParseInfo *info) {
       int uc = *++q;
       if (ucc > 0) {
         if (!isutf8follow(uc)) {
-          parse_error(info, "Illegal byte sequence");
+          parse_asm_error(info, "Illegal byte sequence");
           return NULL;
         }
         --ucc;
@@ -243,17 +243,18 @@ static const char *get_label_end(ParseInfo *info) {
     p = (const char*)q;
   }
   if (p <= start)
-    parse_error(info, "Empty label");
+    parse_asm_error(info, "Empty label");
   return p;
 }
 
+// Names are copied, so that the input line need not be kept alive.
 const Name *unquote_label(const char *p, const char *q) {
   if (*p != '"')
-    return alloc_name(p, q, false);
+    return alloc_name(p, q, true);
   if (q[-1] != '"' || q == p + 2)
     return NULL;
   // TODO: Unescape
-  return alloc_name(p + 1, q - 1, false);
+  return alloc_name(p + 1, q - 1, true);
 }
 
 static const Name *parse_label(ParseInfo *info) {
@@ -277,7 +278,7 @@ static const Name *parse_section_name(ParseInfo *info) {
     ++p;
   } while (isalnum_(*p) || *p == '.');
   info->p = p;
-  return alloc_name(start, p, false);
+  return alloc_name(start, p, true);
 }
 
 enum TokenKind {
@@ -334,7 +335,7 @@ static Token *read_flonum(ParseInfo *info, int base) {
         break;
     }
     if (q >= next) {
-      parse_error(info, "Hex float literal must have exponent part");
+      parse_asm_error(info, "Hex float literal must have exponent part");
     }
   }
 
@@ -416,7 +417,7 @@ static const Token *fetch_token(ParseInfo *info) {
     while (c = *++p, is_label_chr(c))
       ;
     Token *token = new_token(TK_LABEL);
-    token->label.name = alloc_name(label, p, false);
+    token->label.name = alloc_name(label, p, true);
     info->p = p;
     return token;
   }
@@ -438,7 +439,7 @@ static const Token *match(ParseInfo *info, enum TokenKind kind) {
   return token;
 }
 
-Expr *new_expr(enum ExprKind kind) {
+Expr *new_asm_expr(enum ExprKind kind) {
   Expr *expr = calloc_or_die(sizeof(*expr));
   expr->kind = kind;
   return expr;
@@ -448,14 +449,14 @@ static Expr *prim(ParseInfo *info) {
   Expr *expr = NULL;
   const Token *tok;
   if ((tok = match(info, TK_LABEL)) != NULL) {
-    expr = new_expr(EX_LABEL);
+    expr = new_asm_expr(EX_LABEL);
     expr->label.name = tok->label.name;
   } else if ((tok = match(info, TK_FIXNUM)) != NULL) {
-    expr = new_expr(EX_FIXNUM);
+    expr = new_asm_expr(EX_FIXNUM);
     expr->fixnum = tok->fixnum;
 #ifndef __NO_FLONUM
   } else if ((tok = match(info, TK_FLONUM)) != NULL) {
-    expr = new_expr(EX_FLONUM);
+    expr = new_asm_expr(EX_FLONUM);
     expr->flonum = tok->flonum;
 #endif
   }
@@ -474,7 +475,7 @@ static Expr *unary(ParseInfo *info) {
       return expr;
     default:
       {
-        Expr *op = new_expr(EX_POS);
+        Expr *op = new_asm_expr(EX_POS);
         op->unary.sub = expr;
         return op;
       }
@@ -496,7 +497,7 @@ static Expr *unary(ParseInfo *info) {
 #endif
     default:
       {
-        Expr *op = new_expr(EX_NEG);
+        Expr *op = new_asm_expr(EX_NEG);
         op->unary.sub = expr;
         return op;
       }
@@ -516,7 +517,7 @@ static Expr *parse_mul(ParseInfo *info) {
          (tok = match(info, TK_DIV)) != NULL) {
     Expr *rhs = unary(info);
     if (rhs == NULL) {
-      parse_error(info, "expression error");
+      parse_asm_error(info, "expression error");
       break;
     }
 
@@ -528,7 +529,7 @@ static Expr *parse_mul(ParseInfo *info) {
       default:  assert(false); break;
       }
     } else {
-      expr = new_expr((enum ExprKind)(tok->kind + (EX_MUL - TK_MUL)));  // Assume ExprKind is same order with TokenKind.
+      expr = new_asm_expr((enum ExprKind)(tok->kind + (EX_MUL - TK_MUL)));  // Assume ExprKind is same order with TokenKind.
       expr->bop.lhs = lhs;
       expr->bop.rhs = rhs;
     }
@@ -546,7 +547,7 @@ static Expr *parse_add(ParseInfo *info) {
          (tok = match(info, TK_SUB)) != NULL) {
     Expr *rhs = parse_mul(info);
     if (rhs == NULL) {
-      parse_error(info, "expression error");
+      parse_asm_error(info, "expression error");
       break;
     }
 
@@ -559,7 +560,7 @@ static Expr *parse_add(ParseInfo *info) {
       }
     } else {
       // Assume ExprKind is same order with TokenKind.
-      expr = new_expr((enum ExprKind)(tok->kind + (EX_ADD - TK_ADD)));
+      expr = new_asm_expr((enum ExprKind)(tok->kind + (EX_ADD - TK_ADD)));
       expr->bop.lhs = lhs;
       expr->bop.rhs = rhs;
     }
@@ -567,7 +568,7 @@ static Expr *parse_add(ParseInfo *info) {
   return expr;
 }
 
-Expr *parse_expr(ParseInfo *info) {
+Expr *parse_asm_expr(ParseInfo *info) {
   info->prefetched = NULL;
   return parse_add(info);
 }
@@ -585,6 +586,18 @@ static const Name *alloc_dummy_label(void) {
 }
 #endif
 
+static /*enum RawOpcode*/int lookup_raw_opcode(const char *start, size_t n) {
+  for (int i = 0; ; ++i) {
+    const char *name = kRawOpTable[i];
+    if (name == NULL)
+      break;
+    size_t len = strlen(name);
+    if (n == len && strncasecmp(start, name, n) == 0)
+      return i + 1;
+  }
+  return R_NOOP;
+}
+
 static /*enum RawOpcode*/int find_raw_opcode(ParseInfo *info) {
   const char *p = info->p;
   const char *start = p;
@@ -592,28 +605,23 @@ static /*enum RawOpcode*/int find_raw_opcode(ParseInfo *info) {
   while (isalnum(*p) || *p == '.')
     ++p;
   if (*p == '\0' || isspace(*p)) {
-    size_t n = p - start;
-    for (int i = 0; ; ++i) {
-      const char *name = kRawOpTable[i];
-      if (name == NULL)
-        break;
-      size_t len = strlen(name);
-      if (n == len && strncasecmp(start, name, n) == 0) {
-        info->p = skip_whitespaces(p);
-        return i + 1;
-      }
+    int op = lookup_raw_opcode(start, p - start);
+    if (op != R_NOOP) {
+      info->p = skip_whitespaces(p);
+      return op;
     }
   }
   return R_NOOP;
 }
 
-static bool parse_inst(ParseInfo *info, Line *line) {
+// Operands are read from `operands` if given, otherwise from the line separated by commas.
+static bool build_inst(ParseInfo *info, /*enum RawOpcode*/int op, const char **operands,
+                       int count, Line *line) {
   Inst inst;
   inst.op = NOOP;
   for (int i = 0; i < (int)ARRAY_SIZE(inst.opr); ++i)
     inst.opr[i].type = NOOPERAND;
 
-  /*enum RawOpcode*/int op = find_raw_opcode(info);
   if (op != R_NOOP) {
     const ParseInstTable *pt = &kParseInstTable[op];
     int n = pt->count;
@@ -631,11 +639,19 @@ static bool parse_inst(ParseInfo *info, Line *line) {
       if (opr_flags == 0)
         break;
 
-      if (i > 0) {
+      if (operands != NULL) {
+        if (i >= count) {
+          if (candidates[0]->opr_flags[i] == 0)
+            break;
+          parse_asm_error(info, "operand expected");
+          return false;  // Error
+        }
+        parse_set_p(info, operands[i]);
+      } else if (i > 0) {
         if (*info->p != ',') {
           if (candidates[0]->opr_flags[i] == 0)
             break;
-          parse_error(info, "comma expected");
+          parse_asm_error(info, "comma expected");
           return false;  // Error
         }
         info->p = skip_whitespaces(info->p + 1);
@@ -645,7 +661,7 @@ static bool parse_inst(ParseInfo *info, Line *line) {
       const char *before = info->p;
       unsigned int result = parse_operand(info, opr_flags, opr);
       if (result == 0) {
-        parse_error(info, "illegal operand");
+        parse_asm_error(info, "illegal operand");
         info->p = before;
         return false;  // Error
       }
@@ -659,6 +675,10 @@ static bool parse_inst(ParseInfo *info, Line *line) {
       }
 
       info->p = skip_whitespaces(info->p);
+      if (operands != NULL && *info->p != '\0') {
+        parse_asm_error(info, "illegal operand");
+        return false;  // Error
+      }
     }
 
     if (n > 0) {
@@ -675,7 +695,7 @@ static bool parse_inst(ParseInfo *info, Line *line) {
           line->label = label;
         }
         if (inst.opr[2].type == NOOPERAND) {
-          Expr *expr = new_expr(EX_LABEL);
+          Expr *expr = new_asm_expr(EX_LABEL);
           expr->label.name = line->label;
 
           Operand *opr = &inst.opr[2];
@@ -697,6 +717,10 @@ static bool parse_inst(ParseInfo *info, Line *line) {
   return true;
 }
 
+static bool parse_inst(ParseInfo *info, Line *line) {
+  return build_inst(info, find_raw_opcode(info), NULL, 0, line);
+}
+
 void parse_set_p(ParseInfo *info, const char *p) {
   info->p = p;
   info->prefetched = NULL;
@@ -728,7 +752,7 @@ static char unescape_char(ParseInfo *info) {
   case 'v':  return '\v';
 
   default:
-    parse_error(info, "Illegal escape");
+    parse_asm_error(info, "Illegal escape");
     // Fallthrough
   case '\'': case '"': case '\\':
     return c;
@@ -740,7 +764,7 @@ static size_t unescape_string(ParseInfo *info, char *dst) {
   for (; *info->p != '"'; ++info->p, ++len) {
     char c = *info->p;
     if (c == '\0')
-      parse_error(info, "string not closed");
+      parse_asm_error(info, "string not closed");
     if (c == '\\') {
       ++info->p;
       c = unescape_char(info);
@@ -773,7 +797,7 @@ static uint32_t parse_section_flag(ParseInfo *info) {
   uint32_t flag = 0;
   char *flag_str = parse_string(info);
   if (flag_str == NULL) {
-    parse_error(info, ".section: flag string expected");
+    parse_asm_error(info, ".section: flag string expected");
   } else {
     for (char *p = flag_str; *p != '\0'; ++p) {
       switch (*p) {
@@ -781,7 +805,7 @@ static uint32_t parse_section_flag(ParseInfo *info) {
       case 'w':  flag |= SF_WRITABLE; break;
       case 'x':  flag |= SF_EXECUTABLE; break;
       default:
-        parse_error(info, ".section: illegal flag character");
+        parse_asm_error(info, ".section: illegal flag character");
         break;
       }
     }
@@ -801,7 +825,7 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
   case DT_STRING:
     {
       if (*info->p != '"')
-        return parse_error(info, "`\"' expected");
+        return parse_asm_error(info, "`\"' expected");
       ++info->p;
       const char *p = info->p;
       size_t len = unescape_string(info, NULL);
@@ -819,14 +843,14 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
     {
       const Name *name = parse_label(info);
       if (name == NULL)
-        return parse_error(info, ".comm: label expected");
+        return parse_asm_error(info, ".comm: label expected");
       info->p = skip_whitespaces(info->p);
       if (*info->p != ',')
-        return parse_error(info, ".comm: `,' expected");
+        return parse_asm_error(info, ".comm: `,' expected");
       info->p = skip_whitespaces(info->p + 1);
       int64_t size;
       if (!immediate(&info->p, &size) || size <= 0)
-        return parse_error(info, ".comm: size expected");
+        return parse_asm_error(info, ".comm: size expected");
 
       int64_t align = 0;
       if (*info->p == ',') {
@@ -838,7 +862,7 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
             align < 1
 #endif
         ) {
-          return parse_error(info, ".comm: optional alignment expected");
+          return parse_asm_error(info, ".comm: optional alignment expected");
         }
 #if XCC_TARGET_PLATFORM == XCC_PLATFORM_APPLE
         // p2align on macOS.
@@ -866,7 +890,7 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
     {
       int64_t num;
       if (!immediate(&info->p, &num))
-        return parse_error(info, ".zero: number expected");
+        return parse_asm_error(info, ".zero: number expected");
       vec_push(irs, new_ir_zero(num));
     }
     break;
@@ -887,7 +911,7 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
     {
       int64_t align;
       if (!immediate(&info->p, &align))
-        return parse_error(info, ".align: number expected");
+        return parse_asm_error(info, ".align: number expected");
       vec_push(irs, new_ir_align(align));
     }
     break;
@@ -895,7 +919,7 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
     {
       int64_t align;
       if (!immediate(&info->p, &align))
-        return parse_error(info, ".align: number expected");
+        return parse_asm_error(info, ".align: number expected");
       vec_push(irs, new_ir_align(1 << align));
     }
     break;
@@ -904,9 +928,9 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
     {
       const Name *name = parse_label(info);
       if (name == NULL)
-        return parse_error(info, ".type: label expected");
+        return parse_asm_error(info, ".type: label expected");
       if (*info->p != ',')
-        return parse_error(info, ".type: `,' expected");
+        return parse_asm_error(info, ".type: `,' expected");
       info->p = skip_whitespaces(info->p + 1);
       enum LabelKind kind = LK_NONE;
       if (strcmp(info->p, "@function") == 0) {
@@ -916,7 +940,7 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
         kind = LK_OBJECT;
         info->p += 7;
       } else {
-        return parse_error(info, "illegal .type");
+        return parse_asm_error(info, "illegal .type");
       }
 
       LabelInfo *label = add_label_table(info->label_table, name, section, false, false);
@@ -931,9 +955,9 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
   case DT_LONG:
   case DT_QUAD:
     {
-      Expr *expr = parse_expr(info);
+      Expr *expr = parse_asm_expr(info);
       if (expr == NULL)
-        return parse_error(info, "expression expected");
+        return parse_asm_error(info, "expression expected");
 
       assert(expr->kind != EX_FLONUM);
       if (expr->kind == EX_FIXNUM) {
@@ -954,9 +978,9 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
   case DT_FLOAT:
   case DT_DOUBLE:
     {
-      Expr *expr = parse_expr(info);
+      Expr *expr = parse_asm_expr(info);
       if (expr == NULL)
-        return parse_error(info, "expression expected");
+        return parse_asm_error(info, "expression expected");
 
       Flonum value;
       switch (expr->kind) {
@@ -994,7 +1018,7 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
       if (name == NULL) {
         char buf[32];
         snprintf(buf, sizeof(buf), "%s: label expected", dir == DT_GLOBL ? ".globl" : ".local");
-        return parse_error(info, buf);
+        return parse_asm_error(info, buf);
       }
 
       LabelInfo *label = add_label_table(info->label_table, name, section, false, dir == DT_GLOBL);
@@ -1011,7 +1035,7 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
     {
       const Name *name = parse_section_name(info);
       if (name == NULL)
-        return parse_error(info, ".section: section name expected");
+        return parse_asm_error(info, ".section: section name expected");
 #if XCC_TARGET_PLATFORM != XCC_PLATFORM_APPLE
       int flag = 0;
       const char *p = skip_whitespaces(info->p);
@@ -1025,11 +1049,11 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
 #else
       const char *p = skip_whitespaces(info->p);
       if (*p != ',')
-        return parse_error(info, "`,' expected");
+        return parse_asm_error(info, "`,' expected");
       info->p = skip_whitespaces(p + 1);
       const Name *name2 = parse_section_name(info);
       if (name2 == NULL)
-        return parse_error(info, ".section: section name expected");
+        return parse_asm_error(info, ".section: section name expected");
 
       int flag = 0;
       p = skip_whitespaces(info->p);
@@ -1044,7 +1068,7 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
           }
         }
         if (flag == 0)
-          return parse_error(info, ".section: section name expected");
+          return parse_asm_error(info, ".section: section name expected");
       }
 
       char *segname = strndup(name->chars, name->bytes);
@@ -1075,18 +1099,20 @@ bool parse_line(Line *line, ParseInfo *info) {
 
   const char *p = skip_whitespaces(info->p);
   info->p = p;
+  if (*p == '\0')
+    return true;
   const char *q = get_label_end(info);
   const char *r = skip_whitespaces(q);
   if (*r == ':') {
     const Name *label = unquote_label(p, q);
     if (label == NULL)
-      return parse_error(info, "Illegal label");
+      return parse_asm_error(info, "Illegal label");
     line->label = label;
     info->p = p = skip_whitespaces(r + 1);
   } else if (*p == '.') {
     enum DirectiveType dir = find_directive(p + 1, q - p - 1);
     if (dir == NODIRECTIVE) {
-      parse_error(info, "Unknown directive");
+      parse_asm_error(info, "Unknown directive");
       return false;
     }
     line->dir = dir;
@@ -1102,6 +1128,39 @@ bool parse_line(Line *line, ParseInfo *info) {
   return true;
 }
 
+bool parse_op(Line *line, ParseInfo *info, const char *op, const char **operands, int count) {
+  memset(line, 0, sizeof(*line));
+  line->label = NULL;
+  line->inst = NULL;
+  line->dir = NODIRECTIVE;
+
+  if (*op == '.') {
+    enum DirectiveType dir = find_directive(op + 1, strlen(op + 1));
+    if (dir == NODIRECTIVE)
+      return parse_asm_error(info, "Unknown directive");
+    line->dir = dir;
+
+    // Directives parse their arguments as one text.
+    static char *buf;
+    static size_t size;
+    size_t len = 0;
+    for (int i = 0; i < count; ++i)
+      len += strlen(operands[i]) + 2;
+    if (len >= size) {
+      size = len + (len >> 1) + 1;
+      buf = realloc_or_die(buf, size);
+    }
+    char *p = buf;
+    *p = '\0';
+    for (int i = 0; i < count; ++i)
+      p += sprintf(p, i == 0 ? "%s" : ", %s", operands[i]);
+    parse_set_p(info, buf);
+    return handle_directive(info, dir);
+  }
+
+  return build_inst(info, lookup_raw_opcode(op, strlen(op)), operands, count, line);
+}
+
 Value calc_expr(Table *label_table, const Expr *expr) {
   assert(expr != NULL);
   switch (expr->kind) {
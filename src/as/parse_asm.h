@@ -74,6 +74,7 @@ typedef struct ParseInfo {
   const char *p;
   int lineno;
   int error_count;
+  bool block_comment;
 
   const Token *prefetched;
 
@@ -145,8 +146,10 @@ typedef struct Expr {
 } Expr;
 
 bool parse_line(Line *line, ParseInfo *info);
+// Parse an opcode or a directive with its operands given separately.
+bool parse_op(Line *line, ParseInfo *info, const char *op, const char **operands, int count);
 void parse_set_p(ParseInfo *info, const char *p);
-bool parse_error(ParseInfo *info, const char *message);
+bool parse_asm_error(ParseInfo *info, const char *message);
 
 typedef struct {
   /*enum Opcode*/ int op;
@@ -165,8 +168,8 @@ unsigned int parse_operand(ParseInfo *info, unsigned int opr_flag, Operand *oper
 
 bool immediate(const char **pp, int64_t *value);
 const Name *unquote_label(const char *p, const char *q);
-Expr *parse_expr(ParseInfo *info);
-Expr *new_expr(enum ExprKind kind);
+Expr *parse_asm_expr(ParseInfo *info);
+Expr *new_asm_expr(enum ExprKind kind);
 
 typedef struct {
   const Name *label;
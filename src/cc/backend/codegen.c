@@ -5,7 +5,7 @@
 #include <inttypes.h>
 #include <limits.h>  // CHAR_BIT
 #include <stdbool.h>
-#include <stdlib.h>  // qsort
+#include <stdlib.h>  // free, qsort
 #include <string.h>
 
 #include "ast.h"
@@ -15,11 +15,14 @@
 #include "ir.h"
 #include "optimize.h"
 #include "regalloc.h"
+#include "report.h"
 #include "table.h"
 #include "type.h"
 #include "util.h"
 #include "var.h"
 
+bool static_usage_settled = true;
+
 void set_curbb(BB *bb) {
   assert(bb != NULL);
   assert(curfunc != NULL);
@@ -96,7 +99,7 @@ static void alloc_variable_registers(Function *func) {
       }
 #endif
       if (!is_prim_type(type)) {
-        FrameInfo *fi = malloc_or_die(sizeof(*fi));
+        FrameInfo *fi = arena_alloc(curarena, sizeof(*fi));
         fi->offset = 0;
         varinfo->local.frameinfo = fi;
         continue;
@@ -729,13 +732,9 @@ void detect_living_registers(RegAlloc *ra, BBContainer *bbcon) {
         }
       }
 
-      // Store living vregs to IR_CALL.
-      IR *ir = bb->irs->data[j];
-      if (ir->kind == IR_CALL) {
-        ir->call->living_pregs = living_pregs;
-      }
-
       // Add activated registers.
+      IR *ir = bb->irs->data[j];
+      unsigned long defined = 0;
       for (; head < ra->vregs->len; ++head) {
         LiveInterval *li = ra->sorted_intervals[head];
         if (li->start > nip)
@@ -747,8 +746,16 @@ void detect_living_registers(RegAlloc *ra, BBContainer *bbcon) {
           int bitno = BITNO(li, ra);
           living_pregs |= 1UL << bitno;
           livings[bitno] = li;
+          if (ir->dst != NULL && li->virt == ir->dst->virt)
+            defined = 1UL << bitno;
         }
       }
+
+      // Store living vregs to IR_CALL.
+      // Registers which come into the BB at the call are living, but the result is not.
+      if (ir->kind == IR_CALL) {
+        ir->call->living_pregs = living_pregs & ~defined;
+      }
     }
   }
 #undef BITNO
@@ -899,6 +906,7 @@ bool gen_defun(Function *func) {
   fnbe->vaarg_frame_info.offset = 0;  // Calculated in later.
   fnbe->stack_work_size = 0;
   fnbe->stack_work_size_vreg = NULL;
+  fnbe->arena = curarena = calloc_or_die(sizeof(*fnbe->arena));
 
   fnbe->bbcon = new_func_blocks();
   set_curbb(new_bb());
@@ -928,6 +936,7 @@ bool gen_defun(Function *func) {
   curfunc = NULL;
   static_vars = NULL;
   curra = NULL;
+  curarena = NULL;
   return true;
 }
 
@@ -935,14 +944,19 @@ static inline void gen_defun_after(Function *func) {
   FuncBackend *fnbe = func->extra;
   curfunc = func;
   curra = fnbe->ra;
+  curarena = fnbe->arena;
 
+  int phase = enter_report_phase("optimize");
   optimize(fnbe->ra, fnbe->bbcon);
+  leave_report_phase(phase);
 
   prepare_register_allocation(func);
   tweak_irs(fnbe);
   analyze_reg_flow(fnbe->bbcon);
 
+  phase = enter_report_phase("alloc_physical_registers");
   alloc_physical_registers(fnbe->ra, fnbe->bbcon);
+  leave_report_phase(phase);
   map_virtual_to_physical_registers(fnbe->ra);
   detect_living_registers(fnbe->ra, fnbe->bbcon);
 
@@ -950,9 +964,10 @@ static inline void gen_defun_after(Function *func) {
 
   curfunc = NULL;
   curra = NULL;
+  curarena = NULL;
 }
 
-static void gen_decl(Declaration *decl) {
+void gen_decl(Declaration *decl) {
   if (decl == NULL)
     return;
 
@@ -969,6 +984,20 @@ static void gen_decl(Declaration *decl) {
   }
 }
 
+void free_func_backend(Function *func) {
+  FuncBackend *fnbe = func->extra;
+  if (fnbe == NULL)
+    return;
+  free_func_blocks(fnbe->bbcon);
+  free_reg_alloc(fnbe->ra);
+  if (fnbe->funcalls != NULL)
+    free_vector(fnbe->funcalls);
+  arena_release(fnbe->arena);
+  free(fnbe->arena);
+  free(fnbe);
+  func->extra = NULL;
+}
+
 void gen(Vector *decls) {
   if (decls == NULL)
     return;
@@ -8,6 +8,7 @@
 #include "ir.h"  // enum VRegSize
 
 typedef struct BB BB;
+typedef struct Declaration Declaration;
 typedef struct Expr Expr;
 typedef struct Function Function;
 typedef struct RegAlloc RegAlloc;
@@ -19,7 +20,13 @@ typedef struct Vector Vector;
 
 // Public
 
+// Usage of static variables is not settled until the whole source is parsed:
+// assignments to them are kept and they are marked as used, if false.
+extern bool static_usage_settled;
+
 void gen(Vector *decls);
+void gen_decl(Declaration *decl);
+void free_func_backend(Function *func);  // After emitted.
 
 // Private
 
@@ -521,7 +521,7 @@ static inline void gen_funargs(Expr *expr, FuncallWork *work) {
     const Token *token = alloc_dummy_ident();
     Type *type = expr->type;
     ret_varinfo = scope_add(curscope, token, type, 0);
-    FrameInfo *fi = malloc_or_die(sizeof(*fi));
+    FrameInfo *fi = arena_alloc(curarena, sizeof(*fi));
     fi->offset = 0;
     ret_varinfo->local.frameinfo = fi;
   }
@@ -534,7 +534,7 @@ static inline void gen_funargs(Expr *expr, FuncallWork *work) {
   const int arg_count = work->arg_count;
   int total_arg_count = arg_count + (ret_varinfo != NULL ? 1 : 0);
   VReg **arg_vregs = total_arg_count == 0 ? NULL
-                                          : calloc_or_die(total_arg_count * sizeof(*arg_vregs));
+                                          : arena_calloc(curarena, total_arg_count * sizeof(*arg_vregs));
   work->arg_vregs = arg_vregs;
 
   Vector *args = expr->funcall.args;
@@ -569,7 +569,7 @@ static inline VReg *gen_funcall_sub(Expr *expr, FuncallWork *work) {
       global = !(varinfo->storage & VS_STATIC);
   }
 
-  IrCallInfo *callinfo = calloc_or_die(sizeof(*callinfo));
+  IrCallInfo *callinfo = arena_calloc(curarena, sizeof(*callinfo));
   callinfo->stack_args_size = work->offset;
   callinfo->arg_count = arg_count - stack_arg_count;
   callinfo->living_pregs = 0;
@@ -599,7 +599,7 @@ static inline VReg *gen_funcall_sub(Expr *expr, FuncallWork *work) {
                 work->arg_vregs, vaarg_start);
   IR *call = new_ir_call(callinfo, dst, freg);
 
-  FuncallInfo *funcall_info = calloc_or_die(sizeof(*funcall_info));
+  FuncallInfo *funcall_info = arena_calloc(curarena, sizeof(*funcall_info));
   funcall_info->call = call;
   assert(expr->funcall.info == NULL);
   expr->funcall.info = funcall_info;
@@ -712,7 +712,7 @@ static VReg *gen_comma(Expr *expr) {
 static VReg *gen_assign_sub(Expr *lhs, Expr *rhs) {
   VReg *src = gen_expr(rhs);
   if (lhs->kind == EX_VAR) {
-    const VarInfo *varinfo = scope_find(lhs->var.scope, lhs->var.name, NULL);
+    VarInfo *varinfo = scope_find(lhs->var.scope, lhs->var.name, NULL);
     assert(varinfo != NULL);
     if (is_prim_type(lhs->type) && !is_global_scope(lhs->var.scope)) {
       if (is_local_storage(varinfo)) {
@@ -723,8 +723,11 @@ static VReg *gen_assign_sub(Expr *lhs, Expr *rhs) {
     }
 
     if ((varinfo->storage & (VS_STATIC | VS_USED)) == VS_STATIC) {
-      // Can be omitted.
-      return src;
+      if (static_usage_settled || !is_global_scope(lhs->var.scope)) {
+        // Can be omitted.
+        return src;
+      }
+      varinfo->storage |= VS_USED;  // Might be read later.
     }
   }
 
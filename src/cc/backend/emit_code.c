@@ -6,7 +6,9 @@
 #include <stdarg.h>
 #include <stdint.h>  // int64_t
 #include <stdlib.h>  // realloc
+#include <string.h>
 
+#include "assemble.h"
 #include "ast.h"
 #include "be_aux.h"
 #include "cc_misc.h"
@@ -19,6 +21,9 @@
 #include "var.h"
 
 static FILE *emit_fp;
+static ParseInfo *emit_parse_info;  // Non-NULL: Assemble in process, instead of text output.
+static char *emit_line_buf;  // Raw text for the integrated assembler, until its line ends.
+static size_t emit_line_len, emit_line_size;
 
 char *fmt(const char *fm, ...) {
 #define N  8
@@ -91,35 +96,90 @@ char *mangle(char *label) {
 #endif
 }
 
+// Accumulate raw `str` and pass each completed line to the assembler.
+static void assemble_str(const char *str) {
+  for (;;) {
+    const char *nl = strchr(str, '\n');
+    size_t len = nl != NULL ? (size_t)(nl - str) : strlen(str);
+    if (emit_line_len + len >= emit_line_size) {
+      size_t newsize = (emit_line_len + len) * 2 + 16;
+      emit_line_buf = realloc_or_die(emit_line_buf, newsize);
+      emit_line_size = newsize;
+    }
+    memcpy(emit_line_buf + emit_line_len, str, len);
+    emit_line_len += len;
+    if (nl == NULL)
+      break;
+
+    emit_line_buf[emit_line_len] = '\0';
+    assemble_line(emit_parse_info, emit_line_buf);
+    emit_line_len = 0;
+    str = nl + 1;
+  }
+}
+
+// Text output for `-S`.
+static void emit_fmt(const char *fm, ...) {
+  va_list ap;
+  va_start(ap, fm);
+  vfprintf(emit_fp, fm, ap);
+  va_end(ap);
+}
+
+static void emit_op(const char *op, const char **operands, int count) {
+  if (emit_parse_info != NULL) {
+    assemble_op(emit_parse_info, op, operands, count);
+    return;
+  }
+
+  emit_fmt("\t%s", op);
+  for (int i = 0; i < count; ++i)
+    emit_fmt(i == 0 ? " %s" : ", %s", operands[i]);
+  emit_fmt("\n");
+}
+
 void emit_asm_raw(const char *str) {
-  fputs(str, emit_fp);
+  if (emit_parse_info == NULL)
+    fputs(str, emit_fp);
+  else
+    assemble_str(str);
 }
 
 void emit_asm0(const char *op) {
-  fprintf(emit_fp, "\t%s\n", op);
+  emit_op(op, NULL, 0);
 }
 
 void emit_asm1(const char *op, const char *a1) {
-  fprintf(emit_fp, "\t%s %s\n", op, a1);
+  const char *operands[] = {a1};
+  emit_op(op, operands, ARRAY_SIZE(operands));
 }
 
 void emit_asm2(const char *op, const char *a1, const char *a2) {
-  fprintf(emit_fp, "\t%s %s, %s\n", op, a1, a2);
+  const char *operands[] = {a1, a2};
+  emit_op(op, operands, ARRAY_SIZE(operands));
 }
 
 void emit_asm3(const char *op, const char *a1, const char *a2, const char *a3) {
-  fprintf(emit_fp, "\t%s %s, %s, %s\n", op, a1, a2, a3);
+  const char *operands[] = {a1, a2, a3};
+  emit_op(op, operands, ARRAY_SIZE(operands));
 }
 
 void emit_asm4(const char *op, const char *a1, const char *a2, const char *a3, const char *a4) {
-  fprintf(emit_fp, "\t%s %s, %s, %s, %s\n", op, a1, a2, a3, a4);
+  const char *operands[] = {a1, a2, a3, a4};
+  emit_op(op, operands, ARRAY_SIZE(operands));
 }
 
 void emit_label(const char *label) {
-  fprintf(emit_fp, "%s:\n", label);
+  if (emit_parse_info != NULL) {
+    assemble_label(emit_parse_info, label);
+    return;
+  }
+  emit_fmt("%s:\n", label);
 }
 
 void emit_comment(const char *comment, ...) {
+  if (emit_parse_info != NULL)
+    return;
   if (comment == NULL) {
     fprintf(emit_fp, "\n");
     return;
@@ -137,7 +197,7 @@ void emit_align_p2(int align) {
   if (align <= 1)
     return;
   assert(IS_POWER_OF_2(align));
-  fprintf(emit_fp, "\t.p2align %d\n", most_significant_bit(align));
+  emit_asm1(".p2align", num(most_significant_bit(align)));
 }
 
 void emit_comm(const char *label, size_t size, size_t align) {
@@ -151,11 +211,24 @@ void emit_comm(const char *label, size_t size, size_t align) {
     return;
   }
 #endif
-  fprintf(emit_fp, "\t.comm %s, %zu, %zu\n", label, size, align);
+  emit_asm3(".comm", label, num(size), num(align));
 }
 
 void init_emit(FILE *fp) {
   emit_fp = fp;
+  emit_parse_info = NULL;
+}
+
+void init_emit_integrated(const char *filename) {
+  emit_fp = NULL;
+  emit_parse_info = new_parse_info(filename);
+}
+
+int emit_integrated_obj(const char *ofn) {
+  assert(emit_parse_info != NULL);
+  if (emit_line_len > 0)
+    assemble_str("\n");
+  return emit_asm_obj(emit_parse_info, ofn);
 }
 
 bool function_not_returned(FuncBackend *fnbe) {
@@ -228,21 +301,25 @@ static void emit_string(void *ud, Expr *str, size_t size) {
     }
   }
 
-  StringBuffer sb;
-  sb_init(&sb);
-  sb_append(&sb, "\"", NULL);
-  escape_string(str->str.buf, src_size - is_string, &sb);
-  if (size > src_size) {
-    static const char NULCHR[] = "\\0";
-    for (size_t i = 0, n = size - src_size; i < n; ++i)
-      sb_append(&sb, NULCHR, NULL);
-  }
-  sb_append(&sb, "\"", NULL);
-  const char *escaped = sb_to_string(&sb);
-  if (is_string)
-    _STRING(escaped);
-  else
-    _ASCII(escaped);
+  // Split into lines, not to put a large block from `#embed` in one line.
+  enum { LINE_BYTES = 64 };
+  char buf[LINE_BYTES * 4 + 3];
+  const char *p = str->str.buf;
+  size_t len = src_size - is_string;
+  do {
+    size_t n = MIN(len, (size_t)LINE_BYTES);
+    size_t m = escape_chars(p, n, buf + 1);
+    buf[0] = buf[m + 1] = '"';
+    buf[m + 2] = '\0';
+    p += n;
+    len -= n;
+    if (is_string && len == 0)
+      _STRING(buf);
+    else
+      _ASCII(buf);
+  } while (len > 0);
+  if (size > src_size)
+    _ZERO(num(size - src_size));
 }
 
 static bool is_cstring(const VarInfo *varinfo, const Initializer *init) {
@@ -529,20 +606,22 @@ static void emit_defun(Function *func) {
   }
 }
 
+void emit_decl(Declaration *decl) {
+  switch (decl->kind) {
+  case DCL_DEFUN:
+    emit_defun(decl->defun.func);
+    break;
+  case DCL_ASM:
+    emit_asm(decl->asm_.asm_);
+    break;
+  }
+}
+
 void emit_code(Vector *decls) {
   for (int i = 0, len = decls->len; i < len; ++i) {
     Declaration *decl = decls->data[i];
-    if (decl == NULL)
-      continue;
-
-    switch (decl->kind) {
-    case DCL_DEFUN:
-      emit_defun(decl->defun.func);
-      break;
-    case DCL_ASM:
-      emit_asm(decl->asm_.asm_);
-      break;
-    }
+    if (decl != NULL)
+      emit_decl(decl);
   }
 
   emit_decls_ctor_dtor(decls);
@@ -7,6 +7,7 @@
 #include <stdio.h>
 
 typedef struct Vector BBContainer;
+typedef struct Declaration Declaration;
 typedef struct FuncBackend FuncBackend;
 typedef struct IR IR;
 typedef struct Name Name;
@@ -34,6 +35,8 @@ char *flonum(double x);
 char *mangle(char *label);
 
 void init_emit(FILE *fp);
+void init_emit_integrated(const char *filename);  // Assemble in process, instead of text output.
+int emit_integrated_obj(const char *ofn);
 void emit_label(const char *label);
 void emit_asm_raw(const char *op);
 void emit_asm0(const char *op);
@@ -94,3 +97,4 @@ int insert_const_fload(VReg **pvreg, Vector *irs, int i);
 #endif
 
 void emit_code(Vector *decls);
+void emit_decl(Declaration *decl);
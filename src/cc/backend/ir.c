@@ -2,7 +2,6 @@
 #include "ir.h"
 
 #include <assert.h>
-#include <stdlib.h>  // malloc
 
 #include "regalloc.h"
 #include "table.h"
@@ -12,7 +11,7 @@ static const enum VRegSize vtVoidPtr = VRegSize8;
 static const enum VRegSize vtBool = VRegSize4;
 
 Phi *new_phi(VReg *dst, Vector *params) {
-  Phi *phi = malloc_or_die(sizeof(*phi));
+  Phi *phi = arena_alloc(curarena, sizeof(*phi));
   phi->dst = dst;
   phi->params = params;
   return phi;
@@ -43,11 +42,12 @@ void spill_vreg(VReg *vreg) {
 
 //
 RegAlloc *curra;
+Arena *curarena;
 
 // Intermediate Representation
 
 static IR *new_ir(enum IrKind kind) {
-  IR *ir = calloc_or_die(sizeof(*ir));
+  IR *ir = arena_calloc(curarena, sizeof(*ir));
   ir->kind = kind;
   ir->flag = 0;
   ir->dst = ir->opr1 = ir->opr2 = NULL;
@@ -389,7 +389,7 @@ IR *new_ir_store_spilled(VReg *dst, VReg *vreg) {
 BB *curbb;
 
 BB *new_bb(void) {
-  BB *bb = malloc_or_die(sizeof(*bb));
+  BB *bb = arena_alloc(curarena, sizeof(*bb));
   bb->next = NULL;
   bb->from_bbs = new_vector();
   bb->label = alloc_label();
@@ -405,6 +405,31 @@ BBContainer *new_func_blocks(void) {
   return new_vector();
 }
 
+void free_func_blocks(BBContainer *bbcon) {
+  // BBs, IRs and phis themselves are in the arena: release vectors only.
+  for (int i = 0; i < bbcon->len; ++i) {
+    BB *bb = bbcon->data[i];
+    for (int j = 0; j < bb->irs->len; ++j) {
+      IR *ir = bb->irs->data[j];
+      if (ir->kind == IR_ASM && ir->additional_operands != NULL)
+        free_vector(ir->additional_operands);
+    }
+    if (bb->phis != NULL) {
+      for (int j = 0; j < bb->phis->len; ++j) {
+        Phi *phi = bb->phis->data[j];
+        free_vector(phi->params);
+      }
+      free_vector(bb->phis);
+    }
+    free_vector(bb->from_bbs);
+    free_vector(bb->irs);
+    free_vector(bb->in_regs);
+    free_vector(bb->out_regs);
+    free_vector(bb->assigned_regs);
+  }
+  free_vector(bbcon);
+}
+
 //
 
 void detect_from_bbs(BBContainer *bbcon) {
@@ -6,6 +6,7 @@
 #include <stddef.h>  // size_t
 #include <stdint.h>  // int64_t
 
+typedef struct Arena Arena;
 typedef struct BB BB;
 typedef struct Name Name;
 typedef struct RegAlloc RegAlloc;
@@ -228,6 +229,9 @@ IR *new_ir_store_spilled(VReg *dst, VReg *vreg);
 
 extern RegAlloc *curra;
 
+// Backend objects of the current function: released at once after the function is emitted.
+extern Arena *curarena;
+
 // Basci Block:
 //   Chunk of IR codes without branching in the middle (except at the bottom).
 
@@ -251,6 +255,7 @@ BB *new_bb(void);
 typedef struct Vector BBContainer;  // <BB*>
 
 BBContainer *new_func_blocks(void);
+void free_func_blocks(BBContainer *bbcon);
 void detect_from_bbs(BBContainer *bbcon);
 void analyze_reg_flow(BBContainer *bbcon);
 
@@ -276,4 +281,5 @@ typedef struct FuncBackend {
   FrameInfo vaarg_frame_info;  // Used for va_start.
   size_t stack_work_size;
   VReg *stack_work_size_vreg;
+  Arena *arena;
 } FuncBackend;
@@ -3,16 +3,18 @@
 
 #include <assert.h>
 #include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>  // free
+#include <string.h>
 
 #include "ir.h"
 #include "regalloc.h"
+#include "report.h"
 #include "ssa.h"
 #include "table.h"
 #include "util.h"
 
 bool keep_phi;
-bool apply_ssa;
 
 static IR *is_last_jmp(BB *bb) {
   int len;
@@ -714,8 +716,540 @@ static void copy_propagation(RegAlloc *ra, BBContainer *bbcon) {
   } while (again);
 }
 
+// Global value numbering:
+//   An instruction which computes the same value as a dominating one is removed,
+//   and its destination is replaced with the former one.
+//   Loads are reused only while no store or call can intervene.
+
+typedef struct {
+  IR *ir;
+  unsigned int hash;
+  int epoch;  // Memory state at the load.
+  int next;   // Next entry in the same bucket: -1 for none.
+} GvnEntry;
+
+typedef struct {
+  BBContainer *bbcon;
+  Vector **succs;      // [bb] <BB*>
+  Table bb_indices;    // <BB label, index>
+  int *postorder;      // [bb]: -1 for unreachable.
+  int *rpo;            // BB indices in reverse postorder.
+  int rpo_count;
+  int *idom;           // [bb]: Immediate dominator, -1 for none.
+  int *first_child;    // [bb]: Dominator tree.
+  int *next_sibling;   // [bb]
+  int *out_epoch;      // [bb]: Memory state at the end of the BB.
+  int epoch_count;
+  VReg **leaders;      // [virt]: Replacement for the removed destination.
+
+  GvnEntry *entries;   // Stack of available instructions, scoped by the dominator tree.
+  int entry_count;
+  int *buckets;
+  unsigned int bucket_mask;
+} Gvn;
+
+static int gvn_bb_index(Gvn *gvn, BB *bb) {
+  void *index;
+  if (!table_try_get(&gvn->bb_indices, bb->label, &index))
+    assert(false);
+  return (intptr_t)index;
+}
+
+static void collect_successors(BB *bb, Vector *succs) {
+  Vector *irs = bb->irs;
+  if (irs->len > 0) {
+    IR *ir = irs->data[irs->len - 1];  // JMP must be the last IR.
+    switch (ir->kind) {
+    case IR_JMP:
+      vec_push(succs, ir->jmp.bb);
+      if (ir->jmp.cond == COND_ANY)
+        return;
+      break;
+    case IR_TJMP:
+      for (size_t j = 0; j < ir->tjmp.len; ++j)
+        vec_push(succs, ir->tjmp.bbs[j]);
+      return;
+    default: break;
+    }
+  }
+  if (bb->next != NULL)
+    vec_push(succs, bb->next);
+}
+
+static void gvn_number_postorder(Gvn *gvn, int root) {
+  // Iterative DFS: stack of (BB index, next successor index).
+  int count = gvn->bbcon->len;
+  int *stack = malloc_or_die(sizeof(*stack) * count * 2);
+  int *visited = gvn->postorder;  // -2: on the stack.
+  int sp = 0, number = 0;
+  stack[sp++] = root;
+  stack[sp++] = 0;
+  visited[root] = -2;
+  int *order = malloc_or_die(sizeof(*order) * count);
+  while (sp > 0) {
+    int b = stack[sp - 2];
+    int i = stack[sp - 1];
+    Vector *succs = gvn->succs[b];
+    if (i < succs->len) {
+      stack[sp - 1] = i + 1;
+      int s = gvn_bb_index(gvn, succs->data[i]);
+      if (visited[s] == -1) {
+        visited[s] = -2;
+        stack[sp++] = s;
+        stack[sp++] = 0;
+      }
+    } else {
+      sp -= 2;
+      order[number] = b;
+      visited[b] = number++;
+    }
+  }
+  for (int i = 0; i < number; ++i)
+    gvn->rpo[i] = order[number - 1 - i];
+  gvn->rpo_count = number;
+  free(order);
+  free(stack);
+}
+
+static int gvn_intersect(const Gvn *gvn, int a, int b) {
+  const int *po = gvn->postorder;
+  while (a != b) {
+    while (po[a] < po[b])
+      a = gvn->idom[a];
+    while (po[b] < po[a])
+      b = gvn->idom[b];
+  }
+  return a;
+}
+
+// "A Simple, Fast Dominance Algorithm" by Cooper, Harvey and Kennedy.
+static void gvn_calc_dominators(Gvn *gvn) {
+  int *idom = gvn->idom;
+  int root = gvn->rpo[0];
+  idom[root] = root;
+  for (bool changed = true; changed; ) {
+    changed = false;
+    for (int i = 1; i < gvn->rpo_count; ++i) {
+      int b = gvn->rpo[i];
+      Vector *from_bbs = ((BB*)gvn->bbcon->data[b])->from_bbs;
+      int new_idom = -1;
+      for (int j = 0; j < from_bbs->len; ++j) {
+        int p = gvn_bb_index(gvn, from_bbs->data[j]);
+        if (gvn->postorder[p] < 0 || idom[p] < 0)
+          continue;
+        new_idom = new_idom < 0 ? p : gvn_intersect(gvn, p, new_idom);
+      }
+      if (new_idom != idom[b]) {
+        idom[b] = new_idom;
+        changed = true;
+      }
+    }
+  }
+
+  // Build tree, children in reverse postorder.
+  for (int i = gvn->rpo_count; --i >= 1; ) {
+    int b = gvn->rpo[i];
+    int p = idom[b];
+    if (p < 0)
+      continue;
+    gvn->next_sibling[b] = gvn->first_child[p];
+    gvn->first_child[p] = b;
+  }
+}
+
+static inline bool is_gvn_operand(const VReg *vreg) {
+  return vreg == NULL || (vreg->flag & VRF_CONST) ||
+      !(vreg->flag & (VRF_FORCEMEMORY | VRF_VOLATILEREG));
+}
+
+static bool is_gvn_candidate(const IR *ir) {
+  switch (ir->kind) {
+  case IR_BOFS: case IR_IOFS: case IR_LOAD:
+  case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+  case IR_BITAND: case IR_BITOR: case IR_BITXOR: case IR_LSHIFT: case IR_RSHIFT:
+  case IR_COND: case IR_NEG: case IR_BITNOT: case IR_CAST:
+    break;
+  default:
+    return false;
+  }
+  return ir->dst != NULL &&
+      !(ir->dst->flag & (VRF_CONST | VRF_PARAM | VRF_FORCEMEMORY | VRF_VOLATILEREG)) &&
+      is_gvn_operand(ir->opr1) && is_gvn_operand(ir->opr2);
+}
+
+static inline bool is_commutative(const IR *ir) {
+  switch (ir->kind) {
+  case IR_ADD: case IR_MUL: case IR_BITAND: case IR_BITOR: case IR_BITXOR:
+    return true;
+  case IR_COND:
+    return (ir->cond.kind & COND_MASK) == COND_EQ || (ir->cond.kind & COND_MASK) == COND_NE;
+  default:
+    return false;
+  }
+}
+
+static unsigned int gvn_hash_vreg(const VReg *vreg) {
+  if (vreg == NULL)
+    return 0;
+  if (!(vreg->flag & VRF_CONST))
+    return (unsigned int)vreg->virt * 2654435761U;
+  uint64_t bits = vreg->fixnum;
+#ifndef __NO_FLONUM
+  if (vreg->flag & VRF_FLONUM)
+    memcpy(&bits, &vreg->flonum.value, sizeof(bits));
+#endif
+  return (unsigned int)(bits ^ (bits >> 32)) * 2246822519U + vreg->vsize;
+}
+
+static bool gvn_same_vreg(const VReg *a, const VReg *b) {
+  if (a == b)
+    return true;
+  if (a == NULL || b == NULL || !(a->flag & b->flag & VRF_CONST) ||
+      ((a->flag ^ b->flag) & VRF_FLONUM) || a->vsize != b->vsize)
+    return false;
+#ifndef __NO_FLONUM
+  if (a->flag & VRF_FLONUM)
+    return memcmp(&a->flonum.value, &b->flonum.value, sizeof(a->flonum.value)) == 0;
+#endif
+  return a->fixnum == b->fixnum;
+}
+
+static unsigned int gvn_hash_ir(const IR *ir) {
+  unsigned int h1 = gvn_hash_vreg(ir->opr1), h2 = gvn_hash_vreg(ir->opr2);
+  unsigned int h = is_commutative(ir) ? h1 + h2 : h1 * 31 + h2;
+  h = h * 31 + ir->kind;
+  h = h * 31 + ir->flag;
+  h = h * 31 + ir->dst->vsize;
+  switch (ir->kind) {
+  case IR_BOFS:
+    h = h * 31 + (unsigned int)(uintptr_t)ir->bofs.frameinfo + (unsigned int)ir->bofs.offset;
+    break;
+  case IR_IOFS:
+    h = h * 31 + ir->iofs.label->hash + (unsigned int)ir->iofs.offset;
+    break;
+  case IR_COND:
+    h = h * 31 + ir->cond.kind;
+    break;
+  default: break;
+  }
+  return h;
+}
+
+static bool gvn_same_ir(const IR *a, const IR *b) {
+  if (a->kind != b->kind || a->flag != b->flag || a->dst->vsize != b->dst->vsize ||
+      ((a->dst->flag ^ b->dst->flag) & VRF_FLONUM))
+    return false;
+  switch (a->kind) {
+  case IR_BOFS:
+    return a->bofs.frameinfo == b->bofs.frameinfo && a->bofs.offset == b->bofs.offset;
+  case IR_IOFS:
+    return equal_name(a->iofs.label, b->iofs.label) && a->iofs.offset == b->iofs.offset &&
+        a->iofs.global == b->iofs.global;
+  case IR_COND:
+    if (a->cond.kind != b->cond.kind)
+      return false;
+    break;
+  case IR_CAST:
+    if (a->cast.src_unsigned != b->cast.src_unsigned)
+      return false;
+    break;
+  default: break;
+  }
+  if (gvn_same_vreg(a->opr1, b->opr1) && gvn_same_vreg(a->opr2, b->opr2))
+    return true;
+  return is_commutative(a) && gvn_same_vreg(a->opr1, b->opr2) && gvn_same_vreg(a->opr2, b->opr1);
+}
+
+static inline VReg *gvn_leader(Gvn *gvn, VReg *vreg) {
+  if (vreg != NULL && !(vreg->flag & VRF_CONST) && gvn->leaders[vreg->virt] != NULL)
+    return gvn->leaders[vreg->virt];
+  return vreg;
+}
+
+static void gvn_replace_operands(Gvn *gvn, IR *ir) {
+  ir->opr1 = gvn_leader(gvn, ir->opr1);
+  ir->opr2 = gvn_leader(gvn, ir->opr2);
+  Vector *additional = ir->additional_operands;
+  if (additional != NULL) {
+    for (int i = 0; i < additional->len; ++i)
+      additional->data[i] = gvn_leader(gvn, additional->data[i]);
+  }
+  if (ir->kind == IR_CALL) {
+    VReg **args = ir->call->args;
+    for (int i = 0, n = ir->call->total_arg_count; i < n; ++i)
+      args[i] = gvn_leader(gvn, args[i]);
+  }
+}
+
+static void gvn_visit(Gvn *gvn, int b) {
+  BB *bb = gvn->bbcon->data[b];
+  int mark = gvn->entry_count;
+
+  // Loads in the dominator are still valid if it is the only way to reach here.
+  int p = gvn->idom[b];
+  int epoch = p != b && bb->from_bbs->len == 1 && bb->from_bbs->data[0] == gvn->bbcon->data[p]
+      ? gvn->out_epoch[p] : ++gvn->epoch_count;
+
+  Vector *irs = bb->irs;
+  for (int i = 0; i < irs->len; ++i) {
+    IR *ir = irs->data[i];
+    gvn_replace_operands(gvn, ir);
+    if (!is_gvn_candidate(ir)) {
+      switch (ir->kind) {
+      case IR_MOV: case IR_RESULT: case IR_JMP: case IR_TJMP: case IR_PUSHARG: case IR_KEEP:
+        break;
+      default:  // Store, call, asm and so on.
+        epoch = ++gvn->epoch_count;
+        break;
+      }
+      if (ir->dst != NULL && (ir->dst->flag & VRF_FORCEMEMORY))
+        epoch = ++gvn->epoch_count;  // Write to memory.
+      continue;
+    }
+
+    unsigned int hash = gvn_hash_ir(ir);
+    int found = -1;
+    for (int e = gvn->buckets[hash & gvn->bucket_mask]; e >= 0; e = gvn->entries[e].next) {
+      GvnEntry *entry = &gvn->entries[e];
+      if (entry->hash == hash && (ir->kind != IR_LOAD || entry->epoch == epoch) &&
+          gvn_same_ir(entry->ir, ir)) {
+        found = e;
+        break;
+      }
+    }
+    if (found >= 0) {
+      gvn->leaders[ir->dst->virt] = gvn->entries[found].ir->dst;
+      vec_remove_at(irs, i--);
+      continue;
+    }
+
+    GvnEntry *entry = &gvn->entries[gvn->entry_count];
+    entry->ir = ir;
+    entry->hash = hash;
+    entry->epoch = epoch;
+    entry->next = gvn->buckets[hash & gvn->bucket_mask];
+    gvn->buckets[hash & gvn->bucket_mask] = gvn->entry_count++;
+  }
+  gvn->out_epoch[b] = epoch;
+
+  for (int c = gvn->first_child[b]; c >= 0; c = gvn->next_sibling[c])
+    gvn_visit(gvn, c);
+
+  // Leave the scope.
+  while (gvn->entry_count > mark) {
+    GvnEntry *entry = &gvn->entries[--gvn->entry_count];
+    gvn->buckets[entry->hash & gvn->bucket_mask] = entry->next;
+  }
+}
+
+static void global_value_numbering(RegAlloc *ra, BBContainer *bbcon) {
+  int count = bbcon->len;
+  int ir_count = 0;
+  for (int i = 0; i < count; ++i)
+    ir_count += ((BB*)bbcon->data[i])->irs->len;
+  if (ir_count == 0)
+    return;
+
+  Gvn gvn;
+  gvn.bbcon = bbcon;
+  int *ints = malloc_or_die(sizeof(*ints) * count * 6);
+  gvn.postorder = ints;
+  gvn.rpo = ints + count;
+  gvn.idom = ints + count * 2;
+  gvn.first_child = ints + count * 3;
+  gvn.next_sibling = ints + count * 4;
+  gvn.out_epoch = ints + count * 5;
+  gvn.succs = malloc_or_die(sizeof(*gvn.succs) * count);
+  table_init(&gvn.bb_indices);
+  for (int i = 0; i < count; ++i) {
+    BB *bb = bbcon->data[i];
+    table_put(&gvn.bb_indices, bb->label, (void*)(intptr_t)i);
+    gvn.postorder[i] = gvn.idom[i] = gvn.first_child[i] = gvn.next_sibling[i] = -1;
+    gvn.out_epoch[i] = 0;
+    gvn.succs[i] = new_vector();
+    collect_successors(bb, gvn.succs[i]);
+  }
+  gvn.epoch_count = 0;
+
+  gvn_number_postorder(&gvn, 0);
+  gvn_calc_dominators(&gvn);
+
+  int vreg_count = ra->vregs->len;
+  gvn.leaders = calloc_or_die(sizeof(*gvn.leaders) * vreg_count);
+  gvn.entries = malloc_or_die(sizeof(*gvn.entries) * ir_count);
+  gvn.entry_count = 0;
+  unsigned int bucket_count = 16;
+  while (bucket_count < (unsigned int)ir_count * 2)
+    bucket_count <<= 1;
+  gvn.bucket_mask = bucket_count - 1;
+  gvn.buckets = malloc_or_die(sizeof(*gvn.buckets) * bucket_count);
+  for (unsigned int i = 0; i < bucket_count; ++i)
+    gvn.buckets[i] = -1;
+
+  gvn_visit(&gvn, 0);
+
+  // Replace uses which are not visited in the dominator order: phis, unreachable BBs.
+  for (int i = 0; i < count; ++i) {
+    BB *bb = bbcon->data[i];
+    Vector *phis = bb->phis;
+    if (phis != NULL) {
+      for (int j = 0; j < phis->len; ++j) {
+        Vector *params = ((Phi*)phis->data[j])->params;
+        for (int k = 0; k < params->len; ++k)
+          params->data[k] = gvn_leader(&gvn, params->data[k]);
+      }
+    }
+    for (int j = 0; j < bb->irs->len; ++j)
+      gvn_replace_operands(&gvn, bb->irs->data[j]);
+  }
+
+  free(gvn.buckets);
+  free(gvn.entries);
+  free(gvn.leaders);
+  for (int i = 0; i < count; ++i)
+    free_vector(gvn.succs[i]);
+  free(gvn.succs);
+  free(gvn.bb_indices.entries);
+  free(ints);
+}
+
 //
 
+static void peephole_all(RegAlloc *ra, BBContainer *bbcon) {
+  for (int i = 0; i < bbcon->len; ++i) {
+    BB *bb = bbcon->data[i];
+    peephole(ra, bb);
+  }
+}
+
+static void cleanup_bb(RegAlloc *ra, BBContainer *bbcon) {
+  UNUSED(ra);
+  remove_unnecessary_bb(bbcon);
+}
+
+// Pass manager
+
+// Form of IR which a pass works on.
+enum {
+  PF_NON_SSA,   // Phis are resolved before the pass.
+  PF_SSA,       // Skipped unless the IR is in SSA form.
+  PF_ANY,
+  PF_MAKE_SSA,  // Converts the IR into SSA form.
+};
+
+typedef struct {
+  const char *name;
+  void (*run)(RegAlloc *ra, BBContainer *bbcon);
+  int level;  // Enabled at this optimization level or above.
+  int form;
+  int enable;  // Overridden by -fpass=, -fno-pass=: -1 for none.
+
+  // Statistics.
+  int run_count;
+  int changed_count;  // Number of functions whose IR count or BB count is changed.
+  long ir_delta, bb_delta;
+} Pass;
+
+// In pipeline order.
+static Pass kPasses[] = {
+  {"peephole", peephole_all, 0, PF_ANY, -1},
+  {"ssa", make_ssa, 1, PF_MAKE_SSA, -1},
+  {"copy-propagation", copy_propagation, 1, PF_SSA, -1},
+  {"gvn", global_value_numbering, 2, PF_SSA, -1},
+  {"unused-vregs", remove_unused_vregs, 0, PF_ANY, -1},
+  {"cleanup-bb", cleanup_bb, 0, PF_NON_SSA, -1},
+};
+
+static int optimize_level;
+static bool pass_stats;
+
+static Pass *find_pass(const char *name) {
+  for (size_t i = 0; i < ARRAY_SIZE(kPasses); ++i) {
+    if (strcmp(kPasses[i].name, name) == 0)
+      return &kPasses[i];
+  }
+  return NULL;
+}
+
+static bool is_pass_enabled(const Pass *pass) {
+  return pass->enable >= 0 ? pass->enable : optimize_level >= pass->level;
+}
+
+// Phis are counted as instructions.
+static void count_irs(BBContainer *bbcon, long *pir, long *pbb) {
+  long nir = 0, nbb = 0;
+  for (int i = 0; i < bbcon->len; ++i) {
+    BB *bb = bbcon->data[i];
+    nir += bb->irs->len + (bb->phis != NULL ? bb->phis->len : 0);
+    nbb += i == 0 || bb->irs->len > 0;
+  }
+  *pir = nir;
+  *pbb = nbb;
+}
+
+static void run_pass(Pass *pass, RegAlloc *ra, BBContainer *bbcon) {
+  long ir0 = 0, bb0 = 0;
+  if (pass_stats)
+    count_irs(bbcon, &ir0, &bb0);
+
+  int phase = enter_report_phase(pass->name);
+  (*pass->run)(ra, bbcon);
+  leave_report_phase(phase);
+
+  if (pass_stats) {
+    long ir1, bb1;
+    count_irs(bbcon, &ir1, &bb1);
+    ++pass->run_count;
+    pass->changed_count += ir1 != ir0 || bb1 != bb0;
+    pass->ir_delta += ir1 - ir0;
+    pass->bb_delta += bb1 - bb0;
+  }
+}
+
+static void leave_ssa(RegAlloc *ra, BBContainer *bbcon) {
+  int phase = enter_report_phase("resolve-phis");
+  resolve_phis(ra, bbcon);
+  leave_report_phase(phase);
+}
+
+void set_optimize_level(int level) {
+  optimize_level = level;
+}
+
+bool enable_pass(const char *name, bool value) {
+  Pass *pass = find_pass(name);
+  if (pass == NULL)
+    return false;
+  pass->enable = value;
+  return true;
+}
+
+bool parse_pass_option(const char *optarg, bool value) {
+  if (strncmp(optarg, "pass=", 5) == 0) {
+    if (!enable_pass(&optarg[5], value))
+      fprintf(stderr, "Warning: unknown pass: %s\n", &optarg[5]);
+    return true;
+  }
+  if (strcmp(optarg, "pass-stats") == 0) {
+    pass_stats = value;
+    return true;
+  }
+  return false;
+}
+
+void output_pass_stats(FILE *fp) {
+  if (!pass_stats)
+    return;
+  fprintf(fp, "%-20s%8s%10s%12s%12s\n", "Pass", "Runs", "Changed", "IR delta", "BB delta");
+  for (size_t i = 0; i < ARRAY_SIZE(kPasses); ++i) {
+    const Pass *pass = &kPasses[i];
+    if (pass->run_count == 0)
+      continue;
+    fprintf(fp, "%-20s%8d%10d%12ld%12ld\n", pass->name, pass->run_count, pass->changed_count,
+            pass->ir_delta, pass->bb_delta);
+  }
+}
+
 void optimize(RegAlloc *ra, BBContainer *bbcon) {
   // Clean up unused IRs.
   for (int i = 1; i < bbcon->len; ++i) {
@@ -724,23 +1258,35 @@ void optimize(RegAlloc *ra, BBContainer *bbcon) {
       vec_clear(bb->irs);
   }
 
-  // Peephole
-  for (int i = 0; i < bbcon->len; ++i) {
-    BB *bb = bbcon->data[i];
-    peephole(ra, bb);
-  }
-
-  if (apply_ssa) {
-    make_ssa(ra, bbcon);
-    copy_propagation(ra, bbcon);
-    remove_unused_vregs(ra, bbcon);
-    if (!keep_phi) {
-      resolve_phis(ra, bbcon);
-      remove_unnecessary_bb(bbcon);
+  bool in_ssa = false;
+  for (size_t i = 0; i < ARRAY_SIZE(kPasses); ++i) {
+    Pass *pass = &kPasses[i];
+    if (!is_pass_enabled(pass))
+      continue;
+    switch (pass->form) {
+    case PF_NON_SSA:
+      if (in_ssa) {
+        if (keep_phi)
+          continue;
+        leave_ssa(ra, bbcon);
+        in_ssa = false;
+      }
+      break;
+    case PF_SSA:
+      if (!in_ssa)
+        continue;
+      break;
+    case PF_MAKE_SSA:
+      if (in_ssa)
+        continue;
+      in_ssa = true;
+      break;
+    default:
+      break;
     }
-  } else {
-    remove_unused_vregs(ra, bbcon);
-    remove_unnecessary_bb(bbcon);
+    run_pass(pass, ra, bbcon);
   }
+  if (in_ssa && !keep_phi)
+    leave_ssa(ra, bbcon);
   detect_from_bbs(bbcon);
 }
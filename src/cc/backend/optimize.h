@@ -1,6 +1,16 @@
+// Optimization passes on IR
+
 #pragma once
 
+#include <stdbool.h>
+#include <stdio.h>  // FILE
+
 typedef struct Vector BBContainer;
 typedef struct RegAlloc RegAlloc;
 
+void set_optimize_level(int level);  // Select the pipeline: 0, 1, 2...
+bool enable_pass(const char *name, bool value);  // false if unknown.
+bool parse_pass_option(const char *optarg, bool value);  // `pass=<name>` or `pass-stats`.
+void output_pass_stats(FILE *fp);
+
 void optimize(RegAlloc *ra, BBContainer *bbcon);
@@ -13,7 +13,7 @@
 // Register allocator
 
 RegAlloc *new_reg_alloc(const RegAllocSettings *settings) {
-  RegAlloc *ra = calloc_or_die(sizeof(*ra));
+  RegAlloc *ra = arena_calloc(curarena, sizeof(*ra));
   assert(settings->regset[GPREG].phys_max < (int)(sizeof(ra->used_reg_bits) * CHAR_BIT));
   ra->settings = settings;
   ra->vregs = new_vector();
@@ -27,8 +27,21 @@ RegAlloc *new_reg_alloc(const RegAllocSettings *settings) {
   return ra;
 }
 
+void free_reg_alloc(RegAlloc *ra) {
+  // VRegs and `ra` itself are in the arena.
+  free_vector(ra->vregs);
+  free_vector(ra->consts);
+  if (ra->vreg_table != NULL) {
+    for (int i = 0; i < ra->original_vreg_count; ++i)
+      free_vector(ra->vreg_table[i]);
+    free(ra->vreg_table);
+  }
+  free(ra->intervals);
+  free(ra->sorted_intervals);
+}
+
 VReg *reg_alloc_spawn_raw(enum VRegSize vsize, int vflag) {
-  VReg *vreg = calloc_or_die(sizeof(*vreg));
+  VReg *vreg = arena_calloc(curarena, sizeof(*vreg));
   vreg->vsize = vsize;
   vreg->flag = vflag;
   vreg->virt = -1;
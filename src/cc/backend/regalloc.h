@@ -52,6 +52,7 @@ typedef struct RegAlloc {
 } RegAlloc;
 
 RegAlloc *new_reg_alloc(const RegAllocSettings *settings);
+void free_reg_alloc(RegAlloc *ra);
 VReg *reg_alloc_spawn_raw(enum VRegSize vsize, int vflag);
 VReg *reg_alloc_spawn(RegAlloc *ra, enum VRegSize vsize, int vflag);
 VReg *reg_alloc_with_original(RegAlloc *ra, VReg *original);
@@ -16,9 +16,22 @@ static inline int ORIG_VIRT(VReg *vreg) {
   return vreg->original->virt;
 }
 
+static inline bool is_renamable(VReg *vreg) {
+  return !(vreg->flag & (VRF_CONST | VRF_FORCEMEMORY | VRF_VOLATILEREG));
+}
+
 static inline void assign_new_vregs(RegAlloc *ra, Vector **vreg_table, BB *bb, VReg **vregs) {
   for (int iir = 0; iir < bb->irs->len; ++iir) {
     IR *ir = bb->irs->data[iir];
+    if (ir->kind == IR_ASM) {
+      // Output register is at the head of operands, followed by inputs.
+      Vector *operands = ir->additional_operands;
+      for (int i = ir->dst != NULL ? 1 : 0; i < operands->len; ++i) {
+        VReg *vreg = operands->data[i];
+        if (is_renamable(vreg))
+          operands->data[i] = vregs[ORIG_VIRT(vreg)];
+      }
+    }
     if (ir->opr1 != NULL && !(ir->opr1->flag & (VRF_CONST | VRF_FORCEMEMORY | VRF_VOLATILEREG))) {
       ir->opr1 = vregs[ORIG_VIRT(ir->opr1)];
     }
@@ -33,6 +46,8 @@ static inline void assign_new_vregs(RegAlloc *ra, Vector **vreg_table, BB *bb, V
         ir->dst = dst = reg_alloc_with_original(ra, dst);
       vec_push(vt, dst);
       vregs[virt] = dst;
+      if (ir->kind == IR_ASM)
+        ir->additional_operands->data[0] = dst;
     }
   }
 }
@@ -288,84 +303,9 @@ static int make_from_bb_unconditional(BBContainer *bbcon, int ibb, int ifb) {
   return at;
 }
 
-static Vector *extract_cyclic_dependency(int ifb, Vector *phis) {
-  // Check destination register dependency.
-  int n = phis->len;
-  for (int i = 0; i < n; ++i) {
-    Phi *phi = phis->data[i];
-    assert(ifb < phi->params->len);
-    VReg *src = phi->params->data[ifb];
-    // Find that src is one of predecessor destination vreg.
-    int j;
-    for (j = 0; j < i; ++j) {
-      Phi *phi2 = phis->data[j];
-      if (phi2->dst == src)
-        break;
-    }
-    if (j >= i)
-      continue;
-
-    // Move i before j: shift intermediate elements.
-    int d = i - j;
-    memmove(&phis->data[j + 1], &phis->data[j], d * sizeof(*phis->data));
-    phis->data[j] = phi;
-    ++i;
-  }
-
-  // Detect cyclic dependency.
-  Vector *cyclics = NULL;
-  for (int i = 0; i < n; ++i) {
-    Phi *phi = phis->data[i];
-    VReg *src = phi->params->data[ifb];
-    // Find that src is one of predecessor destination vreg.
-    int j;
-    for (j = 0; j < i; ++j) {
-      Phi *phi2 = phis->data[j];
-      if (phi2->dst == src)
-        break;
-    }
-    if (j >= i)
-      continue;
-
-    // Destination is dependent on predecessor: Pick up cyclic dependency to `cyclic`.
-    Vector *cyclic = new_vector();
-    for (;;) {
-      Phi *phi2 = phis->data[j];
-      vec_push(cyclic, phi2);
-      phis->data[j] = NULL;
-      if (j >= i)
-        break;
-
-      VReg *src2 = phi2->params->data[ifb];
-      while (++j < i) {
-        Phi *phi3 = phis->data[j];
-        if (phi3->dst == src2)
-          break;
-      }
-    }
-    assert(cyclic->len >= 2);
-
-    if (cyclics == NULL)
-      cyclics = new_vector();
-    vec_push(cyclics, cyclic);
-
-    // Eliminate them from phis.
-    for (int k = 0; k < n; ++k) {
-      if (phis->data[k] == NULL) {
-        phis->data[k] = phis->data[--n];
-        phis->data[n] = NULL;
-      }
-    }
-    for (; n > 0 && phis->data[n - 1] == NULL; --n)
-      ;
-    phis->len = n;  // Truncate (Recovered in later).
-  }
-  return cyclics;
-}
-
+// Phis for an edge are parallel copies: put a move whose destination is not read by the remaining
+// ones first, and break a cyclic dependency by saving a destination into a temporary.
 static void replace_phis(RegAlloc *ra, BB *bb, int ifb, Vector *phis) {
-  Vector *cyclics = extract_cyclic_dependency(ifb, phis);
-
   // Detect insertion point.
   BB *from = bb->from_bbs->data[ifb];
   int pos = from->irs->len;
@@ -376,43 +316,53 @@ static void replace_phis(RegAlloc *ra, BB *bb, int ifb, Vector *phis) {
       --pos;
   }
 
-  // Put non-cyclic phis.
+  int count = 0;
+  VReg **dsts = malloc_or_die(sizeof(*dsts) * phis->len * 2);
+  VReg **srcs = dsts + phis->len;
   for (int iphi = 0; iphi < phis->len; ++iphi) {
     Phi *phi = phis->data[iphi];
-    VReg *src_vreg = phi->params->data[ifb];
-    IR *mov = new_ir_mov(phi->dst, src_vreg, 0);
-    vec_insert(from->irs, pos++, mov);
+    VReg *src = phi->params->data[ifb];
+    if (src != phi->dst) {
+      dsts[count] = phi->dst;
+      srcs[count] = src;
+      ++count;
+    }
   }
 
-  if (cyclics != NULL) {
-    Vector **vreg_table = ra->vreg_table;
-    for (int i = 0; i < cyclics->len; ++i) {
-      Vector *cyclic = cyclics->data[i];
-      assert(cyclic->len > 0);
-      Phi *first = cyclic->data[0];
-
-      // Allocate temporary vreg.
-      assert(first->dst->original != first->dst);  // phi's destination must not be an original virtual register.
-      VReg *original = first->dst->original;
-      Vector *vt = vreg_table[original->virt];
-      VReg *tmp = reg_alloc_with_original(ra, original);
-      vec_push(vt, tmp);
-
-      for (int j = 0; j < cyclic->len; ++j) {
-        Phi *phi = cyclic->data[j];
-        VReg *src_vreg = phi->params->data[ifb];
-        IR *mov = new_ir_mov(j == 0 ? tmp : phi->dst, src_vreg, 0);
-        vec_insert(from->irs, pos++, mov);
-        vec_push(phis, phi);  // Restore phi.
+  while (count > 0) {
+    int i;
+    for (i = 0; i < count; ++i) {
+      int j;
+      for (j = 0; j < count; ++j) {
+        if (srcs[j] == dsts[i])
+          break;
       }
-
-      IR *mov = new_ir_mov(first->dst, tmp, 0);
+      if (j >= count)
+        break;
+    }
+    if (i < count) {
+      IR *mov = new_ir_mov(dsts[i], srcs[i], 0);
       vec_insert(from->irs, pos++, mov);
+      --count;
+      dsts[i] = dsts[count];
+      srcs[i] = srcs[count];
+      continue;
+    }
 
-      free_vector(cyclic);
+    // All destinations are read by others: cyclic.
+    VReg *dst = dsts[0];
+    assert(dst->original != dst);  // phi's destination must not be an original virtual register.
+    VReg *original = dst->original;
+    VReg *tmp = reg_alloc_with_original(ra, original);
+    vec_push(ra->vreg_table[original->virt], tmp);
+    IR *mov = new_ir_mov(tmp, dst, 0);
+    vec_insert(from->irs, pos++, mov);
+    for (int j = 0; j < count; ++j) {
+      if (srcs[j] == dst)
+        srcs[j] = tmp;
     }
-    free_vector(cyclics);
   }
+  free(dsts);
 }
 
 //
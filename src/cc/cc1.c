@@ -2,15 +2,22 @@
 
 #include <ctype.h>
 #include <assert.h>
+#include <libgen.h>  // basename
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "ast.h"
 #include "codegen.h"
 #include "emit_code.h"
 #include "fe_misc.h"
 #include "lexer.h"
+#include "optimize.h"
 #include "parser.h"
+#include "pch.h"
+#include "preprocessor.h"
+#include "report.h"
+#include "table.h"
 #include "type.h"
 #include "util.h"
 #include "var.h"
@@ -19,10 +26,9 @@
 
 extern void install_builtins(Vector *decls);
 
-static void init_compiler(Vector *decls, FILE *ofp) {
+static void init_compiler(Vector *decls) {
   init_lexer();
   init_global();
-  init_emit(ofp);
 
 #if XCC_TARGET_PROGRAMMING_MODEL == XCC_PROGRAMMING_MODEL_LP64
   // Default
@@ -40,9 +46,124 @@ static void init_compiler(Vector *decls, FILE *ofp) {
   install_builtins(decls);
 }
 
-static void compile1(FILE *ifp, const char *filename, Vector *decls) {
-  set_source_file(ifp, filename);
-  parse(decls);
+// Public functions are generated and output as soon as parsed, and their backend state is
+// released, to bound memory. Static and inline functions are deferred until their usage is
+// known at the end, and constructors and destructors are collected in `emit_code`.
+// Functions which a later call can inline (e.g. `always_inline`), or which have static
+// variables, are deferred too.
+static bool is_streamable(Declaration *decl) {
+  if (decl->kind != DCL_DEFUN)
+    return true;
+  Function *func = decl->defun.func;
+  VarInfo *funcvi = scope_find(global_scope, func->ident->ident, NULL);
+  if (funcvi == NULL || (funcvi->storage & (VS_STATIC | VS_INLINE)) ||
+      satisfy_inline_criteria(funcvi) ||
+      (func->static_vars != NULL && func->static_vars->len > 0))
+    return false;
+  if (func->attributes != NULL &&
+      (table_try_get(func->attributes, alloc_name("constructor", NULL, false), NULL) ||
+       table_try_get(func->attributes, alloc_name("destructor", NULL, false), NULL)))
+    return false;
+  return true;
+}
+
+static void stream_decl(Declaration *decl) {
+  int phase = enter_report_phase("gen");
+  if (decl->kind == DCL_DEFUN) {
+    Function *func = decl->defun.func;
+    // Globals used in the function must be known, not to omit assignments to them.
+    propagate_var_used_from(scope_find(global_scope, func->ident->ident, NULL));
+    static_usage_settled = false;
+    gen_decl(decl);
+    static_usage_settled = true;
+  }
+  enter_report_phase("emit_code");
+  emit_decl(decl);
+  if (decl->kind == DCL_DEFUN)
+    free_func_backend(decl->defun.func);
+  leave_report_phase(phase);
+}
+
+static void compile1(SourceInput *input, const char *filename, Vector *decls) {
+  set_source_input(input, filename);
+  for (;;) {
+    int len = decls->len;
+    if (!parse_toplevel(decls))
+      break;
+    if (decls->len == len + 1 && compile_error_count == 0 && is_streamable(decls->data[len]))
+      stream_decl(vec_pop(decls));
+  }
+  finish_parse(decls);
+}
+
+// Parse a header, and write the preprocessed output and the global scope to `ofn`.
+static int precompile_header(const char *ppbuf, size_t ppsize, const char *filename,
+                             const char *ofn) {
+  enter_report_phase("parse");
+  Vector *toplevel = new_vector();
+  init_compiler(toplevel);
+  begin_pch_scope(toplevel);
+  // Lines are split in place, so lex a copy and keep the text to write.
+  char *text = malloc_or_die(ppsize + 1);
+  memcpy(text, ppbuf, ppsize);
+  SourceInput input;
+  set_source_input_string(&input, text, ppsize);
+  set_source_input(&input, filename);
+  parse(toplevel);
+  if (compile_error_count != 0)
+    return 1;
+
+  DataStorage scope;
+  data_init(&scope);
+  bool has_scope = save_pch_scope(&scope, toplevel);
+
+  char *pchfn = NULL;
+  if (ofn == NULL) {
+    size_t len = strlen(filename) + sizeof(".pch");
+    pchfn = malloc_or_die(len);
+    snprintf(pchfn, len, "%s.pch", filename);
+    ofn = pchfn;
+  }
+  int result = 0;
+  if (!write_pch(ofn, ppbuf, ppsize, has_scope ? &scope : NULL)) {
+    fprintf(stderr, "Cannot write precompiled header: %s\n", ofn);
+    result = 1;
+  }
+  free(pchfn);
+  data_release(&scope);
+  return result;
+}
+
+// Dependency file is named after the output, or the source like `gcc -c`.
+static void output_dependencies(const char *fn, Vector *targets, bool phony, const char *src,
+                                const char *ofn, bool precompile) {
+  char *base = basename(strdup(src));
+  if (fn == NULL)
+    fn = change_ext(ofn != NULL ? ofn : base, "d");
+  if (targets->len == 0) {
+    const char *target = ofn;
+    if (target == NULL) {
+      size_t len = strlen(src) + sizeof(".pch");
+      char *pchfn = malloc_or_die(len);
+      snprintf(pchfn, len, "%s.pch", src);
+      target = precompile ? pchfn : change_ext(base, "o");
+    }
+    vec_push(targets, target);
+  }
+  if (!write_dependencies(fn, targets, phony))
+    error("Cannot write dependency file: %s", fn);
+}
+
+static FILE *open_source(const char **pfilename) {
+  const char *filename = *pfilename;
+  FILE *ifp;
+  if (strcmp(filename, "-") == 0) {
+    ifp = stdin;
+    *pfilename = cc_flags.integrated_cpp ? "*stdin*" : "<stdin>";
+  } else if (!is_file(filename) || (ifp = fopen(filename, "r")) == NULL) {
+    error("Cannot open file: %s\n", filename);
+  }
+  return ifp;
 }
 
 static void usage(FILE *fp) {
@@ -50,7 +171,16 @@ static void usage(FILE *fp) {
       fp,
       "Usage: cc1 [options] file...\n"
       "Options:\n"
-      "  -O<level>           (ignored)\n"
+      "  -o <filename>       Set output filename (Default: stdout)\n"
+      "  -O<level>           Optimization level (0, 1, 2)\n"
+      "  -fpass=<name>       Enable optimization pass, -fno-pass=<name> to disable\n"
+      "  -fpass-stats        Show change statistics of each optimization pass\n"
+      "  -fintegrated-cpp    Preprocess sources (-D, -U, -I, -isystem, -idirafter, -C)\n"
+      "  -x c-header         Precompile a header into <file>.pch, or -o, with -fintegrated-cpp\n"
+      "  -MD, -MMD           Write dependencies with -fintegrated-cpp (-MF, -MT, -MP as cpp)\n"
+      "  -fintegrated-as     Output object file instead of assembly\n"
+      "  -ftime-report       Report time of each phase\n"
+      "  -fmem-report        Report peak memory of each phase\n"
   );
 }
 
@@ -61,6 +191,13 @@ int main(int argc, char *argv[]) {
     OPT_FNO,
     OPT_WNO,
     OPT_SSA,
+    OPT_ISYSTEM,
+    OPT_IDIRAFTER,
+    OPT_MD,
+    OPT_MMD,
+    OPT_MF,
+    OPT_MT,
+    OPT_MP,
   };
 
   static const struct option options[] = {
@@ -68,7 +205,23 @@ int main(int argc, char *argv[]) {
     {"v", no_argument, OPT_VERSION},
     {"-version", no_argument, OPT_VERSION},
 
+    {"o", required_argument},  // Output filename
+
+    // Preprocessor options, used with -fintegrated-cpp.
+    {"I", required_argument},  // Add include path
+    {"isystem", required_argument, OPT_ISYSTEM},  // Add system include path
+    {"idirafter", required_argument, OPT_IDIRAFTER},  // Add include path (after)
+    {"D", required_argument},  // Define macro
+    {"U", required_argument},  // Undefine macro
+    {"C", no_argument},  // Do not discard comments
+    {"MD", no_argument, OPT_MD},  // Output dependency file
+    {"MMD", no_argument, OPT_MMD},  // Output dependency file, except system headers
+    {"MF", required_argument, OPT_MF},  // Dependency filename
+    {"MT", required_argument, OPT_MT},  // Target of dependency
+    {"MP", no_argument, OPT_MP},  // Phony target for each header
+
     {"O", optional_argument},  // Optimization level
+    {"x", required_argument},  // Specify code type
 
     // Sub command
     {"fno-", optional_argument, OPT_FNO},
@@ -81,6 +234,21 @@ int main(int argc, char *argv[]) {
 
     {NULL},
   };
+  // Preprocessor options are applied in order, so initialize it first.
+  char *ppbuf = NULL;
+  size_t ppsize = 0;
+  FILE *ppfp = open_memstream(&ppbuf, &ppsize);
+  if (ppfp == NULL)
+    error("open_memstream failed");
+  init_preprocessor(ppfp);
+
+  const char *ofn = NULL;
+  bool precompile = false;
+  int depend = 0;  // OPT_MD or OPT_MMD
+  const char *dep_fn = NULL;
+  Vector dep_targets;
+  vec_init(&dep_targets);
+  bool dep_phony = false;
   int opt;
   while ((opt = optparse(argc, argv, options)) != -1) {
     switch (opt) {
@@ -92,6 +260,49 @@ int main(int argc, char *argv[]) {
       show_version("cc1", XCC_TARGET_ARCH);
       return 0;
 
+    case 'o':
+      ofn = strcmp(optarg, "-") != 0 ? optarg : NULL;
+      break;
+
+    case 'I':
+      add_inc_path(INC_NORMAL, optarg);
+      break;
+    case OPT_ISYSTEM:
+      add_inc_path(INC_SYSTEM, optarg);
+      break;
+    case OPT_IDIRAFTER:
+      add_inc_path(INC_AFTER, optarg);
+      break;
+    case 'D':
+      define_macro(optarg);
+      break;
+    case 'U':
+      undef_macro(optarg, NULL);
+      break;
+    case 'C':
+      set_preserve_comment(true);
+      break;
+    case OPT_MD:
+    case OPT_MMD:
+      depend = opt;
+      break;
+    case OPT_MF:
+      dep_fn = optarg;
+      break;
+    case OPT_MT:
+      vec_push(&dep_targets, optarg);
+      break;
+    case OPT_MP:
+      dep_phony = true;
+      break;
+
+    case 'x':
+      if (strcmp(optarg, "c-header") == 0)
+        precompile = true;
+      else if (strcmp(optarg, "c") != 0)
+        error("language not recognized: %s", optarg);
+      break;
+
     case 'O':
       if (optarg == NULL) {
         cc_flags.optimize_level = 2;
@@ -119,6 +330,10 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "Warning: missing argument for -f\n");
         break;
       }
+      if (opt == 'f' && parse_report_option(optarg))
+        break;
+      if (parse_pass_option(optarg, opt == 'f'))
+        break;
       if (!parse_fopt(optarg, opt == 'f')) {
         // Silently ignored.
         // fprintf(stderr, "Warning: unknown option for -f: %s\n", optarg);
@@ -153,10 +368,7 @@ int main(int argc, char *argv[]) {
       break;
 
     case OPT_SSA:
-      {
-        extern bool apply_ssa;
-        apply_ssa = true;
-      }
+      enable_pass("ssa", true);
       break;
 
     case '?':
@@ -165,33 +377,103 @@ int main(int argc, char *argv[]) {
     }
   }
 
-  // Compile.
-  Vector *toplevel = new_vector();
-  init_compiler(toplevel, stdout);
+  set_optimize_level(cc_flags.optimize_level);
 
   int iarg = optind;
   if (iarg >= argc)
     error("No input files");
-  for (int i = iarg; i < argc; ++i) {
-    const char *filename = argv[i];
-    FILE *ifp;
-    if (strcmp(filename, "-") == 0) {
-      ifp = stdin;
-      filename = "<stdin>";
-    } else if (!is_file(filename) || (ifp = fopen(filename, "r")) == NULL) {
-      error("Cannot open file: %s\n", filename);
+
+  int phase = enter_report_phase("preprocess");
+  if (precompile) {
+    if (!cc_flags.integrated_cpp || argc - iarg != 1)
+      error("-x c-header requires -fintegrated-cpp and one header");
+    record_pch_dependencies();
+  } else if (cc_flags.integrated_cpp) {
+    accept_pch_scope();
+  }
+  if (depend != 0 && cc_flags.integrated_cpp)
+    record_dependencies(depend == OPT_MD);
+  else
+    depend = 0;
+  if (cc_flags.integrated_cpp) {
+    // Preprocess all sources into memory, without cpp process nor pipe.
+    for (int i = iarg; i < argc; ++i) {
+      const char *filename = argv[i];
+      FILE *ifp = open_source(&filename);
+      preprocess(ifp, filename);
+      if (ifp != stdin)
+        fclose(ifp);
+    }
+  }
+  fclose(ppfp);
+
+  if (precompile) {
+    int result = precompile_header(ppbuf, ppsize, argv[iarg], ofn);
+    if (result == 0 && depend != 0)
+      output_dependencies(dep_fn, &dep_targets, dep_phony, argv[iarg], ofn, true);
+    leave_report_phase(phase);
+    output_report("cc1");
+    return result;
+  }
+
+  FILE *ofp = stdout;
+  if (cc_flags.integrated_as) {
+    init_emit_integrated(argv[iarg]);
+  } else {
+    if (ofn != NULL) {
+      ofp = fopen(ofn, "w");
+      if (ofp == NULL)
+        error("Cannot open output file: %s", ofn);
+    }
+    init_emit(ofp);
+  }
+
+  // Compile.
+  enter_report_phase("parse");
+  Vector *toplevel = new_vector();
+  init_compiler(toplevel);
+
+  SourceInput input;  // Referred from the lexer, and tokens point into the content.
+  if (cc_flags.integrated_cpp) {
+    size_t scope_size;
+    const void *scope = get_pch_scope(&scope_size);
+    if (scope != NULL)
+      load_pch_scope(scope, scope_size);
+
+    // Lex the preprocessed output in place.
+    set_source_input_string(&input, ppbuf, ppsize);
+    compile1(&input, argv[iarg], toplevel);
+  } else {
+    for (int i = iarg; i < argc; ++i) {
+      const char *filename = argv[i];
+      FILE *ifp = open_source(&filename);
+      open_source_input(&input, ifp);
+      if (ifp != stdin)
+        fclose(ifp);
+      compile1(&input, filename, toplevel);
     }
-    compile1(ifp, filename, toplevel);
-    if (ifp != stdin)
-      fclose(ifp);
   }
   if (compile_error_count != 0)
     exit(1);
   if (cc_flags.warn_as_error && compile_warning_count != 0)
     exit(2);
 
+  enter_report_phase("gen");
   gen(toplevel);
+  enter_report_phase("emit_code");
   emit_code(toplevel);
 
-  return 0;
+  int result = 0;
+  if (cc_flags.integrated_as) {
+    enter_report_phase("assemble");
+    result = emit_integrated_obj(ofn);
+  } else if (ofp != stdout) {
+    fclose(ofp);
+  }
+  if (result == 0 && depend != 0)
+    output_dependencies(dep_fn, &dep_targets, dep_phony, argv[iarg], ofn, false);
+  leave_report_phase(phase);
+  output_pass_stats(stderr);
+  output_report("cc1");
+  return result;
 }
@@ -8,13 +8,16 @@
 #include "type.h"
 #include "util.h"
 
+Arena ast_arena;
+
 Token *alloc_token(enum TokenKind kind, Line *line, const char *begin, const char *end) {
   if (end == NULL) {
     assert(begin != NULL);
     end = begin + strlen(begin);
   }
-  Token *token = malloc_or_die(sizeof(*token));
+  Token *token = arena_alloc(&ast_arena, sizeof(*token));
   token->kind = kind;
+  token->hideset = 0;
   token->line = line;
   token->begin = begin;
   token->end = end;
@@ -80,7 +83,7 @@ Expr *strip_cast(Expr *expr) {
 }
 
 Expr *new_expr(enum ExprKind kind, Type *type, const Token *token) {
-  Expr *expr = malloc_or_die(sizeof(*expr));
+  Expr *expr = arena_alloc(&ast_arena, sizeof(*expr));
   expr->kind = kind;
   expr->type = type;
   expr->token = token;
@@ -199,21 +202,21 @@ Expr *new_expr_block(Stmt *block) {
 // ================================================
 
 Initializer *new_initializer(enum InitializerKind kind, const Token *token) {
-  Initializer *init = calloc_or_die(sizeof(*init));
+  Initializer *init = arena_calloc(&ast_arena, sizeof(*init));
   init->kind = kind;
   init->token = token;
   return init;
 }
 
 VarDecl *new_vardecl(VarInfo *varinfo) {
-  VarDecl *decl = malloc_or_die(sizeof(*decl));
+  VarDecl *decl = arena_alloc(&ast_arena, sizeof(*decl));
   decl->varinfo = varinfo;
   decl->init_stmt = NULL;
   return decl;
 }
 
 Stmt *new_stmt(enum StmtKind kind, const Token *token) {
-  Stmt *stmt = malloc_or_die(sizeof(Stmt));
+  Stmt *stmt = arena_alloc(&ast_arena, sizeof(Stmt));
   stmt->kind = kind;
   stmt->token = token;
   stmt->reach = 0;
@@ -319,7 +322,7 @@ Stmt *new_stmt_asm(const Token *token, Vector *templates, Vector *outputs, Vecto
 //
 
 static Declaration *new_decl(enum DeclKind kind) {
-  Declaration *decl = malloc_or_die(sizeof(*decl));
+  Declaration *decl = arena_alloc(&ast_arena, sizeof(*decl));
   decl->kind = kind;
   return decl;
 }
@@ -345,7 +348,7 @@ Function *new_func(Type *type, const Token *ident, const Vector *params, Table *
                    int flag) {
   assert(type->kind == TY_FUNC);
   assert(ident->kind == TK_IDENT);
-  Function *func = calloc_or_die(sizeof(*func));
+  Function *func = arena_calloc(&ast_arena, sizeof(*func));
   func->type = type;
   func->ident = ident;
   func->params = params;
@@ -358,6 +361,8 @@ Function *new_func(Type *type, const Token *ident, const Vector *params, Table *
   func->extra = NULL;
   func->attributes = attributes;
   func->flag = flag;
+  func->inline_cost = -1;
+  func->inline_growth = 0;
 
   return func;
 }
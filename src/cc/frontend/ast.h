@@ -7,6 +7,7 @@
 #include <stdint.h>  // int64_t
 #include <sys/types.h>  // ssize_t
 
+typedef struct Arena Arena;
 typedef struct BB BB;
 typedef struct Initializer Initializer;
 typedef struct MemberInfo MemberInfo;
@@ -17,6 +18,9 @@ typedef struct Type Type;
 typedef struct VarInfo VarInfo;
 typedef struct Vector Vector;
 
+// Frontend objects live until the end of the translation unit.
+extern Arena ast_arena;
+
 // Num
 
 typedef int64_t  Fixnum;
@@ -138,6 +142,7 @@ enum TokenKind {
   TK_GENERIC,
   TK_AUTO_TYPE,
   TK_TYPEOF,
+  TK_EMBED,          // #embed from the preprocessor: refers to the file
 
   // For preprocessor.
   PPTK_CONCAT,       // ##
@@ -160,6 +165,7 @@ enum TokenKind {
 // Token
 typedef struct Token {
   enum TokenKind kind;
+  int hideset;  // Preprocessor: id of the interned hideset, 0 for empty.
   Line *line;
   const char *begin;
   const char *end;
@@ -180,6 +186,10 @@ typedef struct Token {
       int kind;  // 0=float, 1=double, 2=long double
     } flonum;
 #endif
+    struct {
+      const char *path;
+      size_t size;
+    } embed;
   };
 } Token;
 
@@ -330,6 +340,7 @@ enum InitializerKind {
   IK_MULTI,   // {...}
   IK_DOT,     // .x
   IK_BRKT,    // [n]
+  IK_EMBED,   // #embed: bytes of the file in `token`, until flattened
 };
 
 struct Initializer {
@@ -496,9 +507,12 @@ typedef struct Function {
   void *extra;
   Table *attributes;  // <Vector<Token*>>
   int flag;
+  int inline_cost;  // Estimated size of the body for inlining, -1 => not estimated yet.
+  int inline_growth;  // Cost of automatically inlined calls in this function.
 } Function;
 
 #define FUNCF_NORETURN        (1 << 0)
+#define FUNCF_INLINED         (1 << 1)  // Inlined at least once.
 
 Function *new_func(Type *type, const Token *ident, const Vector *params, Table *attributes,
                    int flag);
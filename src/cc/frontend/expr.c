@@ -19,8 +19,7 @@ Expr *string_expr(const Token *token, char *str, ssize_t len, enum StrKind kind)
   }
 #endif
   Type *ctype = get_fixnum_type(fxkind, is_unsigned, 0);  // not const.
-  Type *type = arrayof(ctype, len);
-  type->qualifier = TQ_CONST;
+  Type *type = qualified_type(arrayof(ctype, len), TQ_CONST);
 
   Expr *expr = new_expr(EX_STR, type, token);
   expr->str.buf = str;
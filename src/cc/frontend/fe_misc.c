@@ -28,6 +28,8 @@ int compile_error_count;
 CcFlags cc_flags = {
   .warn_as_error = false,
   .common = false,
+  .integrated_cpp = false,
+  .integrated_as = false,
   .optimize_level = 0,
 };
 
@@ -54,6 +56,8 @@ static bool parse_flag_table(const char *optarg, bool value, const FlagTable *ta
 bool parse_fopt(const char *optarg, bool value) {
   static const FlagTable kFlagTable[] = {
     {"common", offsetof(CcFlags, common)},
+    {"integrated-cpp", offsetof(CcFlags, integrated_cpp)},
+    {"integrated-as", offsetof(CcFlags, integrated_as)},
   };
   return parse_flag_table(optarg, value, kFlagTable, ARRAY_SIZE(kFlagTable));
 }
@@ -82,8 +86,16 @@ void parse_error(enum ParseErrorLevel level, const Token *token, const char *fmt
     fprintf(stderr, "\n");
   }
 
-  if (token != NULL && token->line != NULL && token->begin != NULL)
-    show_error_line(token->line->buf, token->begin, token->end - token->begin);
+  if (token != NULL && token->line != NULL && token->begin != NULL) {
+    if (token->line->buf != NULL) {
+      show_error_line(token->line->buf, token->begin, token->end - token->begin);
+    } else {
+      const char *begin = NULL;
+      char *buf = reload_token_line(token, &begin);
+      show_error_line(buf, begin, token->end - token->begin);
+      free(buf);
+    }
+  }
   va_end(ap);
 
   if (level == PE_WARNING) {
@@ -141,9 +153,8 @@ static VarInfo *find_var_from_scope(Scope *scope, const Token *ident, Type *type
   assert(ident != NULL);
   const Name *name = ident->ident;
   assert(name != NULL);
-  int idx = var_find(scope->vars, name);
-  if (idx >= 0) {
-    VarInfo *varinfo = scope->vars->data[idx];
+  VarInfo *varinfo = scope_find_var(scope, name);
+  if (varinfo != NULL) {
     if (!same_type(type, varinfo->type)) {
       parse_error(PE_NOFATAL, ident, "`%.*s' type conflict", NAMES(name));
     } else if (!(storage & VS_EXTERN)) {
@@ -232,6 +243,7 @@ bool ensure_struct(Type *type, const Token *token, Scope *scope) {
           return false;
         }
         type->struct_.info = sinfo;
+        update_canonical_type(type);
       }
 
       // Recursively.
@@ -414,6 +426,29 @@ void propagate_var_used(void) {
   }
 }
 
+// Mark globals reachable from `varinfo` as used, as `propagate_var_used` does at the end:
+// for a public function whose code is generated before the whole source is parsed.
+void propagate_var_used_from(VarInfo *varinfo) {
+  Table checked;
+  table_init(&checked);
+  Vector unchecked;
+  vec_init(&unchecked);
+  vec_push(&unchecked, varinfo);
+  while (unchecked.len > 0) {
+    VarInfo *vi = vec_pop(&unchecked);
+    if (table_try_get(&checked, vi->ident->ident, NULL))
+      continue;
+    table_put(&checked, vi->ident->ident, NULL);
+    vi->storage |= VS_USED;
+
+    Vector *refs = vi->global.referred_globals;
+    if (refs != NULL)
+      vec_concat(&unchecked, refs);
+  }
+  free(checked.entries);
+  free(unchecked.data);
+}
+
 void check_lval(const Token *tok, Expr *expr, const char *error) {
   switch (expr->kind) {
   case EX_VAR:
@@ -805,6 +840,7 @@ static bool check_func_return(Function *func) {
     if (rettype->kind == TY_VOID) {
       // Force return type to `int' for `main' function.
       type->func.ret = rettype = &tyInt;
+      update_canonical_type(type);
     }
   }
 
@@ -878,18 +914,424 @@ int get_funparam_index(Function *func, const Name *name) {
 
 //
 
+// Inline cost is roughly the number of AST nodes, which the caller grows by inlining.
+#define INLINE_COST_NEVER       (1 << 20)  // Body which must not be duplicated automatically.
+#define AUTO_INLINE_COST        (24)   // Static function which is inlined at every call.
+#define AUTO_INLINE_FIRST_COST  (64)   // Only for the first call: single call site is common.
+#define INLINE_GROWTH_LIMIT     (256)  // Total cost automatically inlined into a function.
+
+static int stmt_inline_cost(const Stmt *stmt);
+
+static int expr_inline_cost(const Expr *expr) {
+  if (expr == NULL)
+    return 0;
+
+  switch (expr->kind) {
+  case EX_FIXNUM: case EX_FLONUM: case EX_STR: case EX_VAR:
+    return 1;
+  case EX_ADD: case EX_SUB: case EX_MUL: case EX_DIV: case EX_MOD:
+  case EX_BITAND: case EX_BITOR: case EX_BITXOR: case EX_LSHIFT: case EX_RSHIFT:
+  case EX_EQ: case EX_NE: case EX_LT: case EX_LE: case EX_GE: case EX_GT:
+  case EX_LOGAND: case EX_LOGIOR: case EX_ASSIGN: case EX_COMMA:
+    return 1 + expr_inline_cost(expr->bop.lhs) + expr_inline_cost(expr->bop.rhs);
+  case EX_POS: case EX_NEG: case EX_BITNOT:
+  case EX_PREINC: case EX_PREDEC: case EX_POSTINC: case EX_POSTDEC:
+  case EX_REF: case EX_DEREF: case EX_CAST:
+    return 1 + expr_inline_cost(expr->unary.sub);
+  case EX_TERNARY:
+    return 1 + expr_inline_cost(expr->ternary.cond) + expr_inline_cost(expr->ternary.tval) +
+        expr_inline_cost(expr->ternary.fval);
+  case EX_MEMBER:
+    return 1 + expr_inline_cost(expr->member.target);
+  case EX_FUNCALL:
+    {
+      const Expr *func = expr->funcall.func;
+      if (func->kind == EX_VAR && is_global_scope(func->var.scope)) {
+        // Stack frame of the caller is used.
+        static const char *kFrameFuncs[] = {"alloca", "__builtin_alloca", "__builtin_setjmp"};
+        for (size_t i = 0; i < ARRAY_SIZE(kFrameFuncs); ++i) {
+          if (equal_name(func->var.name, alloc_name(kFrameFuncs[i], NULL, false)))
+            return INLINE_COST_NEVER;
+        }
+      }
+      int cost = 4 + expr_inline_cost(func);
+      const Vector *args = expr->funcall.args;
+      for (int i = 0; i < args->len; ++i)
+        cost += expr_inline_cost(args->data[i]);
+      return cost;
+    }
+  case EX_INLINED:
+    {
+      int cost = stmt_inline_cost(expr->inlined.embedded);
+      const Vector *args = expr->inlined.args;
+      for (int i = 0; i < args->len; ++i)
+        cost += expr_inline_cost(args->data[i]);
+      return cost;
+    }
+  case EX_COMPLIT:
+    {
+      int cost = 1;
+      const Vector *inits = expr->complit.inits;
+      for (int i = 0; i < inits->len; ++i)
+        cost += stmt_inline_cost(inits->data[i]);
+      return cost;
+    }
+  case EX_BLOCK:
+    return stmt_inline_cost(expr->block);
+  }
+  return 1;
+}
+
+static int stmt_inline_cost(const Stmt *stmt) {
+  if (stmt == NULL)
+    return 0;
+
+  switch (stmt->kind) {
+  case ST_EXPR:
+    return expr_inline_cost(stmt->expr);
+  case ST_BLOCK:
+    {
+      int cost = 0;
+      const Vector *stmts = stmt->block.stmts;
+      for (int i = 0; i < stmts->len; ++i)
+        cost += stmt_inline_cost(stmts->data[i]);
+      return cost;
+    }
+  case ST_IF:
+    return 1 + expr_inline_cost(stmt->if_.cond) + stmt_inline_cost(stmt->if_.tblock) +
+        stmt_inline_cost(stmt->if_.fblock);
+  case ST_SWITCH:
+    return 2 + expr_inline_cost(stmt->switch_.value) + stmt_inline_cost(stmt->switch_.body);
+  case ST_WHILE: case ST_DO_WHILE:
+    return 2 + expr_inline_cost(stmt->while_.cond) + stmt_inline_cost(stmt->while_.body);
+  case ST_FOR:
+    return 2 + expr_inline_cost(stmt->for_.pre) + expr_inline_cost(stmt->for_.cond) +
+        expr_inline_cost(stmt->for_.post) + stmt_inline_cost(stmt->for_.body);
+  case ST_RETURN:
+    return 1 + expr_inline_cost(stmt->return_.val);
+  case ST_CASE:
+    return 1 + stmt_inline_cost(stmt->case_.stmt);
+  case ST_LABEL:
+    return stmt_inline_cost(stmt->label.stmt);
+  case ST_VARDECL:
+#ifndef __NO_VLA
+    {
+      const Type *type = stmt->vardecl->varinfo->type;
+      if (ptr_or_array(type) && type->pa.vla != NULL)
+        return INLINE_COST_NEVER;
+    }
+#endif
+    return stmt_inline_cost(stmt->vardecl->init_stmt);
+  case ST_ASM:
+    return INLINE_COST_NEVER;  // Might define labels.
+  case ST_EMPTY: case ST_BREAK: case ST_CONTINUE: case ST_GOTO:
+    return 1;
+  }
+  return 1;
+}
+
+static int function_inline_cost(Function *func) {
+  if (func->inline_cost < 0) {
+    int cost = stmt_inline_cost(func->body_block);
+    func->inline_cost = cost < INLINE_COST_NEVER ? cost : INLINE_COST_NEVER;
+  }
+  return func->inline_cost;
+}
+
+static bool has_func_attribute(const Function *func, const char *name) {
+  return func->attributes != NULL &&
+      table_try_get(func->attributes, alloc_name(name, NULL, false), NULL);
+}
+
+// Whether calls to the function can be inlined: explicitly `inline`, or small `static` one
+// for -O2. Calls are actually inlined by `should_inline_funcall`.
 bool satisfy_inline_criteria(const VarInfo *varinfo) {
-  // TODO: Check complexity or length of function body statements.
   const Type *type = varinfo->type;
-  if (type->kind == TY_FUNC && (varinfo->storage & VS_INLINE) && !type->func.vaargs) {
-    Function *func = varinfo->global.func;
-    if (func != NULL) {
-      // Self-recursion or mutual recursion are prevented,
-      // because some inline function must not be defined at funcall point.
-      return func->body_block != NULL && func->label_table == NULL && func->gotos == NULL;
+  if (type->kind != TY_FUNC || type->func.vaargs)
+    return false;
+  Function *func = varinfo->global.func;
+  // Self-recursion or mutual recursion are prevented,
+  // because some inline function must not be defined at funcall point.
+  if (func == NULL || func->body_block == NULL || func->label_table != NULL ||
+      func->gotos != NULL || has_func_attribute(func, "noinline"))
+    return false;
+  if ((varinfo->storage & VS_INLINE) || has_func_attribute(func, "always_inline"))
+    return true;
+  return cc_flags.optimize_level >= 2 && (varinfo->storage & VS_STATIC) &&
+      !has_func_attribute(func, "constructor") && !has_func_attribute(func, "destructor") &&
+      function_inline_cost(func) <= AUTO_INLINE_FIRST_COST;
+}
+
+bool should_inline_funcall(VarInfo *varinfo) {
+  if (!satisfy_inline_criteria(varinfo))
+    return false;
+
+  Function *func = varinfo->global.func;
+  if (!(varinfo->storage & VS_INLINE) && !has_func_attribute(func, "always_inline")) {
+    // The first call can take a larger body, which is dropped if no other call follows.
+    int cost = function_inline_cost(func);
+    int limit = (func->flag & FUNCF_INLINED) ? AUTO_INLINE_COST : AUTO_INLINE_FIRST_COST;
+    if (cost > limit || curfunc == NULL || curfunc->inline_growth + cost > INLINE_GROWTH_LIMIT)
+      return false;
+    curfunc->inline_growth += cost;
+  }
+  func->flag |= FUNCF_INLINED;
+  return true;
+}
+
+// Parameters assigned in the function body cannot be replaced with the argument.
+static void collect_assigned_params_stmt(const Stmt *stmt, Vector *params);
+
+static void collect_assigned_param(const Expr *target, Vector *params) {
+  if (target->kind == EX_VAR && !is_global_scope(target->var.scope)) {
+    VarInfo *varinfo = scope_find(target->var.scope, target->var.name, NULL);
+    if (varinfo != NULL && (varinfo->storage & VS_PARAM))
+      vec_push(params, varinfo);
+  }
+}
+
+static void collect_assigned_params_expr(const Expr *expr, Vector *params) {
+  if (expr == NULL)
+    return;
+
+  switch (expr->kind) {
+  case EX_FIXNUM: case EX_FLONUM: case EX_STR: case EX_VAR:
+    break;
+  case EX_ASSIGN:
+    collect_assigned_param(expr->bop.lhs, params);
+    // Fallthrough
+  case EX_ADD: case EX_SUB: case EX_MUL: case EX_DIV: case EX_MOD:
+  case EX_BITAND: case EX_BITOR: case EX_BITXOR: case EX_LSHIFT: case EX_RSHIFT:
+  case EX_EQ: case EX_NE: case EX_LT: case EX_LE: case EX_GE: case EX_GT:
+  case EX_LOGAND: case EX_LOGIOR: case EX_COMMA:
+    collect_assigned_params_expr(expr->bop.lhs, params);
+    collect_assigned_params_expr(expr->bop.rhs, params);
+    break;
+  case EX_PREINC: case EX_PREDEC: case EX_POSTINC: case EX_POSTDEC:
+    collect_assigned_param(expr->unary.sub, params);
+    // Fallthrough
+  case EX_POS: case EX_NEG: case EX_BITNOT:
+  case EX_REF: case EX_DEREF: case EX_CAST:
+    collect_assigned_params_expr(expr->unary.sub, params);
+    break;
+  case EX_TERNARY:
+    collect_assigned_params_expr(expr->ternary.cond, params);
+    collect_assigned_params_expr(expr->ternary.tval, params);
+    collect_assigned_params_expr(expr->ternary.fval, params);
+    break;
+  case EX_MEMBER:
+    collect_assigned_params_expr(expr->member.target, params);
+    break;
+  case EX_FUNCALL:
+    collect_assigned_params_expr(expr->funcall.func, params);
+    for (int i = 0; i < expr->funcall.args->len; ++i)
+      collect_assigned_params_expr(expr->funcall.args->data[i], params);
+    break;
+  case EX_INLINED:
+    // Embedded body is duplicated again, and it cannot touch the parameters.
+    for (int i = 0; i < expr->inlined.args->len; ++i)
+      collect_assigned_params_expr(expr->inlined.args->data[i], params);
+    break;
+  case EX_COMPLIT:
+    for (int i = 0; i < expr->complit.inits->len; ++i)
+      collect_assigned_params_stmt(expr->complit.inits->data[i], params);
+    break;
+  case EX_BLOCK:
+    collect_assigned_params_stmt(expr->block, params);
+    break;
+  }
+}
+
+static void collect_assigned_params_stmt(const Stmt *stmt, Vector *params) {
+  if (stmt == NULL)
+    return;
+
+  switch (stmt->kind) {
+  case ST_EXPR:
+    collect_assigned_params_expr(stmt->expr, params);
+    break;
+  case ST_BLOCK:
+    for (int i = 0; i < stmt->block.stmts->len; ++i)
+      collect_assigned_params_stmt(stmt->block.stmts->data[i], params);
+    break;
+  case ST_IF:
+    collect_assigned_params_expr(stmt->if_.cond, params);
+    collect_assigned_params_stmt(stmt->if_.tblock, params);
+    collect_assigned_params_stmt(stmt->if_.fblock, params);
+    break;
+  case ST_SWITCH:
+    collect_assigned_params_expr(stmt->switch_.value, params);
+    collect_assigned_params_stmt(stmt->switch_.body, params);
+    break;
+  case ST_WHILE: case ST_DO_WHILE:
+    collect_assigned_params_expr(stmt->while_.cond, params);
+    collect_assigned_params_stmt(stmt->while_.body, params);
+    break;
+  case ST_FOR:
+    collect_assigned_params_expr(stmt->for_.pre, params);
+    collect_assigned_params_expr(stmt->for_.cond, params);
+    collect_assigned_params_expr(stmt->for_.post, params);
+    collect_assigned_params_stmt(stmt->for_.body, params);
+    break;
+  case ST_RETURN:
+    collect_assigned_params_expr(stmt->return_.val, params);
+    break;
+  case ST_CASE:
+    collect_assigned_params_stmt(stmt->case_.stmt, params);
+    break;
+  case ST_LABEL:
+    collect_assigned_params_stmt(stmt->label.stmt, params);
+    break;
+  case ST_VARDECL:
+    collect_assigned_params_stmt(stmt->vardecl->init_stmt, params);
+    break;
+  case ST_ASM:
+    if (stmt->asm_.outputs != NULL) {
+      for (int i = 0; i < stmt->asm_.outputs->len; ++i) {
+        AsmArg *arg = stmt->asm_.outputs->data[i];
+        collect_assigned_param(arg->expr, params);
+        collect_assigned_params_expr(arg->expr, params);
+      }
+    }
+    if (stmt->asm_.inputs != NULL) {
+      for (int i = 0; i < stmt->asm_.inputs->len; ++i)
+        collect_assigned_params_expr(((AsmArg*)stmt->asm_.inputs->data[i])->expr, params);
+    }
+    break;
+  case ST_EMPTY: case ST_BREAK: case ST_CONTINUE: case ST_GOTO:
+    break;
+  }
+}
+
+// Argument which has no side effect and whose value never changes: constant or global address.
+static bool is_substitutable_arg(Expr *arg) {
+  switch (arg->kind) {
+  case EX_FIXNUM: case EX_FLONUM:
+    return is_const(arg);
+  case EX_REF:
+    return arg->unary.sub->kind == EX_VAR && is_global_scope(arg->unary.sub->var.scope);
+  default:
+    return false;
+  }
+}
+
+static bool has_case_label(const Stmt *stmt) {
+  if (stmt == NULL)
+    return false;
+
+  switch (stmt->kind) {
+  case ST_CASE:
+    return true;
+  case ST_BLOCK:
+    for (int i = 0; i < stmt->block.stmts->len; ++i) {
+      if (has_case_label(stmt->block.stmts->data[i]))
+        return true;
+    }
+    return false;
+  case ST_IF:
+    return has_case_label(stmt->if_.tblock) || has_case_label(stmt->if_.fblock);
+  case ST_WHILE: case ST_DO_WHILE:
+    return has_case_label(stmt->while_.body);
+  case ST_FOR:
+    return has_case_label(stmt->for_.body);
+  case ST_LABEL:
+    return has_case_label(stmt->label.stmt);
+  default:  // Cases in nested `switch` are dropped together.
+    return false;
+  }
+}
+
+static inline bool is_const_literal(Expr *expr) {
+  return (expr->kind == EX_FIXNUM || expr->kind == EX_FLONUM) && is_const(expr);
+}
+
+// Substituted arguments for the parameters of the function being embedded.
+static Vector *inline_const_args;  // <Expr*>, NULL for the parameter not substituted.
+// Switch statement whose value is constant, and its case to be taken.
+static const Stmt *inline_const_switch;
+static const Stmt *inline_switch_target;
+
+static Expr *fold_inlined_bop(const Expr *expr, Expr *lhs, Expr *rhs) {
+  enum ExprKind kind = expr->kind;
+  const Token *tok = expr->token;
+  switch (kind) {
+  case EX_ADD: case EX_SUB:
+    if (is_const_literal(lhs) && is_const_literal(rhs) &&
+        is_number(lhs->type) && is_number(rhs->type))
+      return make_cast(expr->type, tok, new_expr_addsub(kind, tok, lhs, rhs), false);
+    break;
+  case EX_DIV: case EX_MOD:
+    if (is_zero(rhs))
+      break;  // Leave it to runtime.
+    // Fallthrough
+  case EX_MUL: case EX_BITAND: case EX_BITOR: case EX_BITXOR: case EX_LSHIFT: case EX_RSHIFT:
+    if (is_const_literal(lhs) && is_const_literal(rhs) &&
+        is_number(lhs->type) && is_number(rhs->type))
+      return make_cast(expr->type, tok, new_expr_num_bop(kind, tok, lhs, rhs), false);
+    break;
+  case EX_EQ: case EX_NE: case EX_LT: case EX_LE: case EX_GE: case EX_GT:
+    if (is_const_literal(lhs) && is_const_literal(rhs) &&
+        ((is_number(lhs->type) && is_number(rhs->type)) || kind == EX_EQ || kind == EX_NE))
+      return make_cast(expr->type, tok, new_expr_cmp(kind, tok, lhs, rhs), false);
+    break;
+  case EX_LOGAND: case EX_LOGIOR:
+    if (lhs->kind == EX_FIXNUM)
+      return (kind == EX_LOGAND ? lhs->fixnum == 0 : lhs->fixnum != 0) ? lhs : rhs;
+    break;
+  case EX_COMMA:
+    if (is_const(lhs))
+      return rhs;
+    break;
+  default: break;
+  }
+  return new_expr_bop(kind, expr->type, tok, lhs, rhs);
+}
+
+static Expr *fold_inlined_unary(const Expr *expr, Expr *sub) {
+  Type *type = expr->type;
+  const Token *tok = expr->token;
+  if (is_const_literal(sub)) {
+    switch (expr->kind) {
+    case EX_CAST:
+      if (type->kind != TY_VOID)
+        return make_cast(type, tok, sub, true);
+      break;
+    case EX_POS:
+      return make_cast(type, tok, sub, false);
+    case EX_NEG:
+#ifndef __NO_FLONUM
+      if (sub->kind == EX_FLONUM)
+        return new_expr_flolit(type, tok, -sub->flonum);
+#endif
+      return new_expr_fixlit(type, tok,
+                             wrap_value(-sub->fixnum, type_size(type), type->fixnum.is_unsigned));
+    case EX_BITNOT:
+      return new_expr_fixlit(type, tok,
+                             wrap_value(~sub->fixnum, type_size(type), type->fixnum.is_unsigned));
+    default: break;
+    }
+  }
+  return new_expr_unary(expr->kind, type, tok, sub);
+}
+
+// Substituted argument for each use, because folding can modify a literal in place.
+static Expr *copy_const_arg(const Expr *arg) {
+  switch (arg->kind) {
+  case EX_FIXNUM:
+    return new_expr_fixlit(arg->type, arg->token, arg->fixnum);
+#ifndef __NO_FLONUM
+  case EX_FLONUM:
+    return new_expr_flolit(arg->type, arg->token, arg->flonum);
+#endif
+  default:
+    {
+      assert(arg->kind == EX_REF);
+      const Expr *var = arg->unary.sub;
+      return new_expr_unary(EX_REF, arg->type, arg->token,
+                            new_expr_variable(var->var.name, var->type, var->token,
+                                              var->var.scope));
     }
   }
-  return false;
 }
 
 static Stmt *duplicate_inline_function_stmt(Function *targetfunc, Scope *targetscope, Stmt *stmt);
@@ -931,6 +1373,9 @@ static Expr *duplicate_inline_function_expr(Function *targetfunc, Scope *targets
             break;
         }
         assert(i < top_scope_vars->len);
+        if (inline_const_args != NULL && i < inline_const_args->len &&
+            inline_const_args->data[i] != NULL)
+          return copy_const_arg(inline_const_args->data[i]);
         // Rename.
         assert(i < scope->vars->len);
         name = ((VarInfo*)scope->vars->data[i])->ident->ident;
@@ -945,6 +1390,8 @@ static Expr *duplicate_inline_function_expr(Function *targetfunc, Scope *targets
     {
       Expr *lhs = duplicate_inline_function_expr(targetfunc, targetscope, expr->bop.lhs);
       Expr *rhs = duplicate_inline_function_expr(targetfunc, targetscope, expr->bop.rhs);
+      if (inline_const_args != NULL)
+        return fold_inlined_bop(expr, lhs, rhs);
       return new_expr_bop(expr->kind, expr->type, expr->token, lhs, rhs);
     }
   case EX_POS: case EX_NEG: case EX_BITNOT:
@@ -952,11 +1399,17 @@ static Expr *duplicate_inline_function_expr(Function *targetfunc, Scope *targets
   case EX_REF: case EX_DEREF: case EX_CAST:
     {
       Expr *sub = duplicate_inline_function_expr(targetfunc, targetscope, expr->unary.sub);
+      if (inline_const_args != NULL)
+        return fold_inlined_unary(expr, sub);
       return new_expr_unary(expr->kind, expr->type, expr->token, sub);
     }
   case EX_TERNARY:
     {
       Expr *cond = duplicate_inline_function_expr(targetfunc, targetscope, expr->ternary.cond);
+      if (inline_const_args != NULL && cond->kind == EX_FIXNUM) {
+        Expr *val = cond->fixnum != 0 ? expr->ternary.tval : expr->ternary.fval;
+        return duplicate_inline_function_expr(targetfunc, targetscope, val);
+      }
       Expr *tval = duplicate_inline_function_expr(targetfunc, targetscope, expr->ternary.tval);
       Expr *fval = duplicate_inline_function_expr(targetfunc, targetscope, expr->ternary.fval);
       return new_expr_ternary(expr->token, cond, tval, fval, expr->type);
@@ -992,7 +1445,7 @@ static Expr *duplicate_inline_function_expr(Function *targetfunc, Scope *targets
       assert(varinfo != NULL);
       assert(satisfy_inline_criteria(varinfo));
       return new_expr_inlined(expr->token, varinfo->ident->ident, expr->type, args,
-                              embed_inline_funcall(varinfo));
+                              embed_inline_funcall(varinfo, args));
     }
   case EX_COMPLIT:
     {
@@ -1102,6 +1555,15 @@ static Stmt *duplicate_inline_function_stmt(Function *targetfunc, Scope *targets
   case ST_IF:
     {
       Expr *cond = duplicate_inline_function_expr(targetfunc, targetscope, stmt->if_.cond);
+      if (inline_const_args != NULL && cond->kind == EX_FIXNUM) {
+        // Prune the dead arm, unless it is jumped into by `case`.
+        Stmt *taken = cond->fixnum != 0 ? stmt->if_.tblock : stmt->if_.fblock;
+        Stmt *dead = cond->fixnum != 0 ? stmt->if_.fblock : stmt->if_.tblock;
+        if (!has_case_label(dead)) {
+          Stmt *dup = duplicate_inline_function_stmt(targetfunc, targetscope, taken);
+          return dup != NULL ? dup : new_stmt(ST_EMPTY, stmt->token);
+        }
+      }
       Stmt *tblock = duplicate_inline_function_stmt(targetfunc, targetscope, stmt->if_.tblock);
       Stmt *fblock = duplicate_inline_function_stmt(targetfunc, targetscope, stmt->if_.fblock);
       return new_stmt_if(stmt->token, cond, tblock, fblock);
@@ -1116,12 +1578,41 @@ static Stmt *duplicate_inline_function_stmt(Function *targetfunc, Scope *targets
         vec_push(cases, NULL);
       dup->switch_.cases = cases;
 
+      // Only the case for constant value is kept, others are left as plain statements.
+      const Stmt *bak_const_switch = inline_const_switch;
+      const Stmt *bak_switch_target = inline_switch_target;
+      inline_const_switch = NULL;
+      if (inline_const_args != NULL && value->kind == EX_FIXNUM) {
+        Vector *org_cases = stmt->switch_.cases;
+        const Stmt *target = stmt->switch_.default_;
+        for (int i = 0; i < org_cases->len; ++i) {
+          Stmt *c = org_cases->data[i];
+          if (c->case_.value != NULL && c->case_.value->fixnum == value->fixnum) {
+            target = c;
+            break;
+          }
+        }
+        inline_const_switch = stmt;
+        inline_switch_target = target;
+      }
+
       SAVE_LOOP_SCOPE(save, stmt, NULL); loop_scope.swtch = dup; {
         // cases, default_ will be updated according to the body statements duplication.
         Stmt *body = duplicate_inline_function_stmt(targetfunc, targetscope, stmt->switch_.body);
         dup->switch_.body = body;
       } RESTORE_LOOP_SCOPE(save);
 
+      if (inline_const_switch != NULL) {
+        int n = 0;
+        for (int i = 0; i < cases->len; ++i) {
+          if (cases->data[i] != NULL)
+            cases->data[n++] = cases->data[i];
+        }
+        cases->len = n;
+      }
+      inline_const_switch = bak_const_switch;
+      inline_switch_target = bak_switch_target;
+
       return dup;
     }
   case ST_WHILE:
@@ -1172,6 +1663,9 @@ static Stmt *duplicate_inline_function_stmt(Function *targetfunc, Scope *targets
     }
   case ST_CASE:
     {
+      if (stmt->case_.swtch == inline_const_switch && stmt != inline_switch_target)
+        return duplicate_inline_function_stmt(targetfunc, targetscope, stmt->case_.stmt);
+
       Stmt *swtch = loop_scope.swtch;
       assert(swtch != NULL);
       Stmt *dup = new_stmt_case(stmt->token, swtch, stmt->case_.value);
@@ -1227,8 +1721,37 @@ static Stmt *duplicate_inline_function_stmt(Function *targetfunc, Scope *targets
   return NULL;
 }
 
-Stmt *embed_inline_funcall(VarInfo *varinfo) {
+Stmt *embed_inline_funcall(VarInfo *varinfo, Vector *args) {
   assert(varinfo->type->kind == TY_FUNC);
   Function *targetfunc = varinfo->global.func;
-  return duplicate_inline_function_stmt(targetfunc, NULL, targetfunc->body_block);
+
+  // Substitute constant arguments for the parameters which are never modified,
+  // to fold expressions and prune dead branches in the body for this call site.
+  Vector *const_args = NULL;
+  Vector *assigned_params = NULL;
+  Vector *top_scope_vars = ((Scope*)targetfunc->scopes->data[0])->vars;
+  for (int i = 0; i < args->len && i < top_scope_vars->len; ++i) {
+    VarInfo *param = top_scope_vars->data[i];
+    if (!is_substitutable_arg(args->data[i]) || (param->storage & VS_REF_TAKEN) ||
+        (param->type->qualifier & TQ_VOLATILE))
+      continue;
+    if (assigned_params == NULL) {
+      assigned_params = new_vector();
+      collect_assigned_params_stmt(targetfunc->body_block, assigned_params);
+    }
+    if (vec_contains(assigned_params, param))
+      continue;
+    if (const_args == NULL) {
+      const_args = new_vector();
+      for (int j = 0; j < args->len; ++j)
+        vec_push(const_args, NULL);
+    }
+    const_args->data[i] = args->data[i];
+  }
+
+  Vector *bak_const_args = inline_const_args;
+  inline_const_args = const_args;
+  Stmt *embedded = duplicate_inline_function_stmt(targetfunc, NULL, targetfunc->body_block);
+  inline_const_args = bak_const_args;
+  return embedded;
 }
@@ -36,6 +36,8 @@ typedef struct {
 typedef struct {
   bool warn_as_error;  // Treat warnings as errors
   bool common;
+  bool integrated_cpp;  // Preprocess sources
+  bool integrated_as;  // Output object file instead of assembly
   int optimize_level;
   WarningFlags warn;
 } CcFlags;
@@ -90,6 +92,7 @@ const MemberInfo *search_from_anonymous(const Type *type, const Name *name, cons
 void mark_var_used(Expr *expr);
 void mark_var_used_for_func(Expr *expr);
 void propagate_var_used(void);
+void propagate_var_used_from(VarInfo *varinfo);
 void check_lval(const Token *tok, Expr *expr, const char *error);
 #ifndef __NO_BITFIELD
 void not_bitfield_member(Expr *expr);
@@ -108,4 +111,5 @@ bool check_funcend_return(Stmt *stmt);
 int get_funparam_index(Function *func, const Name *name);  // -1: Not funparam.
 
 bool satisfy_inline_criteria(const VarInfo *varinfo);
-Stmt *embed_inline_funcall(VarInfo *varinfo);
+bool should_inline_funcall(VarInfo *varinfo);
+Stmt *embed_inline_funcall(VarInfo *varinfo, Vector *args);
@@ -3,10 +3,12 @@
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stdlib.h>  // free
 
 #include "ast.h"
 #include "expr.h"
 #include "fe_misc.h"
+#include "lexer.h"
 #include "table.h"
 #include "type.h"
 #include "util.h"
@@ -60,9 +62,7 @@ Type *fix_array_size(Type *type, Initializer *init, const Token *token) {
       }
       arr_len = max_index;
     }
-    Type *cloned = clone_type(type);
-    cloned->pa.length = arr_len;
-    return cloned;
+    return qualified_type(arrayof(type->pa.ptrof, arr_len), type->qualifier);
   } else {
     assert(arr_len > 0);
     assert(!is_str || init->single->kind == EX_STR);
@@ -159,6 +159,7 @@ static Stmt *init_char_array_by_string(Expr *dst, Initializer *src, const Token
   ssize_t dstlen = dst->type->pa.length;
   if (dstlen == -1) {
     dst->type->pa.length = dstlen = len;
+    update_canonical_type(dst->type);
   } else {
     if (dstlen < len - 1)
       parse_error(PE_FATAL, token, "Buffer is shorter than string: %d for \"%s\"", (int)dstlen,
@@ -170,7 +171,8 @@ static Stmt *init_char_array_by_string(Expr *dst, Initializer *src, const Token
   Expr *var = new_expr_variable(varinfo->ident->ident, strtype, NULL, curscope);
   assert(str->type->kind == TY_ARRAY);
   mark_var_used(var);
-  return build_memcpy(dst, var, len * type_size(str->type->pa.ptrof));
+  // Whole the array: the variable is padded, or shorter by the terminator.
+  return build_memcpy(dst, var, type_size(strtype));
 }
 
 typedef struct {
@@ -215,6 +217,68 @@ static Initializer *reserve_init_for_multi(Type *type, const Token *token) {
 
 static Initializer *flatten_initializer_multi(Type *type, Initializer *init);
 
+// `#embed` in `{...}`: For a byte array, pack the file and constant numbers into one block
+// as a string literal without the terminator. Otherwise expand to numbers.
+static Initializer *flatten_embed(Type *type, Initializer *init) {
+  assert(init->kind == IK_MULTI);
+  Vector *multi = init->multi;
+  bool embedded = false;
+  bool packable = type->kind == TY_ARRAY && is_char_type(type->pa.ptrof, STR_CHAR);
+  size_t total = 0;
+  for (int i = 0; i < multi->len; ++i) {
+    const Initializer *elem = multi->data[i];
+    if (elem != NULL && elem->kind == IK_EMBED) {
+      embedded = true;
+      total += elem->token->embed.size;
+    } else {
+      packable = packable && elem != NULL && elem->kind == IK_SINGLE &&
+                 elem->single->kind == EX_FIXNUM;
+      ++total;
+    }
+  }
+  if (!embedded)
+    return init;
+
+  if (packable) {
+    if (type->pa.length >= 0 && (ssize_t)total > type->pa.length)
+      parse_error(PE_NOFATAL, init->token, "Excess elements in array initializer");
+    char *buf = malloc_or_die(total);
+    size_t pos = 0;
+    for (int i = 0; i < multi->len; ++i) {
+      const Initializer *elem = multi->data[i];
+      if (elem->kind == IK_EMBED) {
+        read_embed_data(elem->token, buf + pos);
+        pos += elem->token->embed.size;
+      } else {
+        buf[pos++] = elem->single->fixnum;
+      }
+    }
+    Initializer *packed = new_initializer(IK_SINGLE, init->token);
+    packed->single = string_expr(init->token, buf, total, STR_CHAR);
+    return packed;
+  }
+
+  Vector *expanded = new_vector();
+  for (int i = 0; i < multi->len; ++i) {
+    Initializer *elem = multi->data[i];
+    if (elem == NULL || elem->kind != IK_EMBED) {
+      vec_push(expanded, elem);
+      continue;
+    }
+    const Token *tok = elem->token;
+    unsigned char *data = malloc_or_die(tok->embed.size);
+    read_embed_data(tok, data);
+    for (size_t j = 0; j < tok->embed.size; ++j) {
+      Initializer *num = new_initializer(IK_SINGLE, tok);
+      num->single = new_expr_fixlit(&tyInt, tok, data[j]);
+      vec_push(expanded, num);
+    }
+    free(data);
+  }
+  init->multi = expanded;
+  return init;
+}
+
 static Type *get_multi_child_type(Type *type, int index) {
   switch (type->kind) {
   case TY_ARRAY:
@@ -443,6 +507,9 @@ static void store_to_current_position(InitFlattener *flattener, Initializer *ini
 static Initializer *flatten_initializer_multi(Type *type, Initializer *init) {
   assert(is_multi_type(type->kind));
   assert(init->kind == IK_MULTI);
+  init = flatten_embed(type, init);
+  if (init->kind != IK_MULTI)
+    return init;
   if (type->kind == TY_ARRAY) {
     if (init->multi->len == 1) {
       Initializer *elem_init = init->multi->data[0];
@@ -543,6 +610,7 @@ Initializer *flatten_initializer(Type *type, Initializer *init) {
   } else {
     switch (init->kind) {
     case IK_MULTI:
+      init = flatten_embed(type, init);
       if (init->multi->len == 0) {
         init->kind = IK_SINGLE;
 #ifndef __NO_FLONUM
@@ -919,6 +987,7 @@ Initializer *check_vardecl(Type **ptype, const Token *ident, int storage, Initia
               ) {
       parse_error(PE_WARNING, ident, "Array size undetermined, assume as one");
       type->pa.length = 1;
+      update_canonical_type(type);
     }
 #ifndef __NO_VLA
   } else if (type->kind == TY_PTR && type->pa.vla != NULL) {
@@ -10,6 +10,7 @@
 #include <sys/types.h>  // ssize_t
 
 #include "table.h"
+#include "token_stream.h"
 #include "util.h"
 
 static bool for_preprocess;
@@ -136,8 +137,8 @@ void lex_error(const char *p, const char *fmt, ...) {
   va_end(ap);
   fprintf(stderr, "\n");
 
-  if (lexer.line != NULL)
-    show_error_line(lexer.line->buf, p, 1);
+  if (lexer.linebuf != NULL)
+    show_error_line(lexer.linebuf, p, 1);
 
   exit(1);
 }
@@ -237,23 +238,32 @@ void init_lexer_for_preprocessor(void) {
 }
 
 void set_source_file(FILE *fp, const char *filename) {
-  lexer.fp = fp;
+  static SourceInput input;
+  if (fp != NULL)
+    open_source_input(&input, fp);
+  set_source_input(fp != NULL ? &input : NULL, filename);
+}
+
+static bool open_token_stream(SourceInput *input, const char *filename);
+
+void set_source_input(SourceInput *input, const char *filename) {
+  if (input != NULL && open_token_stream(input, filename))
+    input = NULL;
+  lexer.input = input;
   lexer.filename = filename;
   lexer.line = NULL;
+  lexer.linebuf = NULL;
   lexer.p = "";
   lexer.idx = -1;
   lexer.lineno = 0;
 }
 
 void set_source_string(const char *line, const char *filename, int lineno) {
-  Line *p = malloc_or_die(sizeof(*p));
-  p->filename = filename;
-  p->buf = line;
-  p->lineno = lineno;
-
-  lexer.fp = NULL;
+  open_token_stream(NULL, NULL);
+  lexer.input = NULL;
   lexer.filename = filename;
-  lexer.line = p;
+  lexer.line = NULL;
+  lexer.linebuf = line;
   lexer.p = line;
   lexer.idx = -1;
   lexer.lineno = lineno;
@@ -301,14 +311,25 @@ static int scan_linemarker(const char *line, long *pnum, char **pfn, int *pflag)
   return n;
 }
 
+static Line *current_line(void) {
+  Line *line = lexer.line;
+  if (line == NULL) {
+    line = arena_alloc(&ast_arena, sizeof(*line));
+    line->filename = lexer.filename;
+    line->buf = lexer.linebuf;
+    line->lineno = lexer.lineno;
+    lexer.line = line;
+  }
+  return line;
+}
+
 static bool read_next_line(void) {
-  if (lexer.fp == NULL || feof(lexer.fp))
+  if (lexer.input == NULL || lexer.input->p >= lexer.input->end)
     return lex_eof_continue();
 
-  char *line = NULL;
-  size_t capa = 0;
+  char *line;
   for (;;) {
-    ssize_t len = getline_cont(&line, &capa, lexer.fp, &lexer.lineno);
+    ssize_t len = source_getline_cont(lexer.input, &line, &lexer.lineno);
     if (len == -1) {
       if (lex_eof_continue())
         continue;
@@ -316,7 +337,7 @@ static bool read_next_line(void) {
       return false;
     }
 
-    if (line[0] != '#')
+    if (line[0] != '#' || strncmp(line, "#embed ", 7) == 0)  // `#embed` is read as a token.
       break;
 
     // linemarkers: # linenum filename flags
@@ -331,12 +352,8 @@ static bool read_next_line(void) {
     }
   }
 
-  Line *p = malloc_or_die(sizeof(*p));
-  p->filename = lexer.filename;
-  p->buf = line;
-  p->lineno = lexer.lineno;
-  lexer.line = p;
-  lexer.p = lexer.line->buf;
+  lexer.line = NULL;
+  lexer.linebuf = lexer.p = line;
   return true;
 }
 
@@ -414,7 +431,7 @@ static Token *read_flonum(const char **pp, int base) {
     break;
   default: break;
   }
-  Token *tok = alloc_token(TK_FLOATLIT, lexer.line, start, next);
+  Token *tok = alloc_token(TK_FLOATLIT, current_line(), start, next);
   tok->flonum.value = val;
   tok->flonum.kind = kind;
   *pp = next;
@@ -488,7 +505,7 @@ static Token *read_num(const char **pp) {
     }
     break;
   }
-  Token *tok = alloc_token(TK_INTLIT, lexer.line, start, p);
+  Token *tok = alloc_token(TK_INTLIT, current_line(), start, p);
   tok->fixnum.value = val;
   tok->fixnum.flag = flag | (unsigned_count > 0 ? TKF_UNSIGNED : 0) | (long_count & TKF_LONG_MASK);
   *pp = p;
@@ -502,6 +519,8 @@ const char *read_ident(const char *p_) {
   if (!(ucc > 0 || isalpha(uc) || uc == '_'))
     return NULL;
 
+  if (ucc <= 0)  // Skip ASCII run at once, and continue for UTF-8 if any.
+    p = (const unsigned char*)skip_ident_chars(p_ + 1) - 1;
   for (;;) {
     uc = *++p;
     if (ucc > 0) {
@@ -568,7 +587,7 @@ static Token *read_char(const char **pp) {
     lex_error(p, "Character not closed");
 
   ++p;
-  Token *tok = alloc_token(TK_INTLIT, lexer.line, begin, p);
+  Token *tok = alloc_token(TK_INTLIT, current_line(), begin, p);
   tok->fixnum.value = c;
   tok->fixnum.flag = TKF_CHAR | (is_wide ? (1 | TKF_UNSIGNED) : 0);
   *pp = p;
@@ -619,21 +638,27 @@ static Token *read_string(const char **pp) {
     ++p;
   }
 #endif
-    for (int c; (c = *(unsigned char*)p++) != '"'; ) {
-      if (c == '\0')
-        lex_error(p - 1, "String not closed");
-      if (len + 1 >= capa) {
-        capa += ADD;
+    for (int c; ; ) {
+      // Copy plain characters at once.
+      const char *q = find_char3(p, '"', '\\', '\\');
+      size_t n = q - p;
+      if (len + n + 1 >= capa) {
+        capa = len + n + ADD;
         str = realloc_or_die(str, capa * sizeof(*str));
       }
+      memcpy(str + len, p, n);
+      len += n;
+      p = q;
 
-      if (c == '\\') {
-        c = *(unsigned char*)p;
-        if (c == '\0')
-          lex_error(p, "String not closed");
-        c = backslash(c, is_wide, &p);
-        ++p;
-      }
+      if ((c = *(unsigned char*)p++) == '"')
+        break;
+      if (c == '\0')
+        lex_error(p - 1, "String not closed");
+      c = *(unsigned char*)p;
+      if (c == '\0')
+        lex_error(p, "String not closed");
+      c = backslash(c, is_wide, &p);
+      ++p;
       assert(len < capa);
       str[len++] = c;
     }
@@ -660,7 +685,7 @@ static Token *read_string(const char **pp) {
     kind = STR_WIDE;
   }
 #endif
-  Token *tok = alloc_token(TK_STR, lexer.line, begin, end);
+  Token *tok = alloc_token(TK_STR, current_line(), begin, end);
   tok->str.buf = str;
   tok->str.len = len;
   tok->str.kind = kind;
@@ -668,6 +693,44 @@ static Token *read_string(const char **pp) {
   return tok;
 }
 
+// `#embed "fullpath" limit(size)` put by the preprocessor.
+// `#embed "path" limit(size) hash(hex)` from cpp: `"` and `\` in the path are escaped.
+// The hash is only for the compile cache.
+static Token *read_embed(const char **pp) {
+  const char *begin = *pp;
+  const char *p = skip_whitespaces(begin + 6);
+  if (*p != '"')
+    lex_error(p, "Illegal #embed");
+  char *path = malloc_or_die(strlen(p));
+  size_t len = 0;
+  for (++p; *p != '"'; ++p) {
+    if (*p == '\\' && p[1] != '\0')
+      ++p;
+    if (*p == '\0')
+      lex_error(p, "Illegal #embed");
+    path[len++] = *p;
+  }
+  path[len] = '\0';
+  p = skip_whitespaces(p + 1);
+  if (strncmp(p, "limit(", 6) != 0 || !isdigit(p[6]))
+    lex_error(p, "Illegal #embed");
+  size_t size = strtoull(p + 6, (char**)&p, 10);
+  if (*p++ != ')')
+    lex_error(p - 1, "Illegal #embed");
+  p = skip_whitespaces(p);
+  if (strncmp(p, "hash(", 5) != 0 || !isxdigit(p[5]))
+    lex_error(p, "Illegal #embed");
+  strtoull(p + 5, (char**)&p, 16);
+  if (*p++ != ')')
+    lex_error(p - 1, "Illegal #embed");
+
+  Token *tok = alloc_token(TK_EMBED, current_line(), begin, p);
+  tok->embed.path = path;
+  tok->embed.size = size;
+  *pp = p;
+  return tok;
+}
+
 static Token *get_op_token(const char **pp) {
   const char *p = *pp;
   unsigned char c = *(unsigned char*)p;
@@ -680,7 +743,7 @@ static Token *get_op_token(const char **pp) {
       kind = PPTK_CONCAT;
     }
     *pp = q;
-    return alloc_token(kind, lexer.line, p, q);
+    return alloc_token(kind, current_line(), p, q);
   }
 
   if (c < sizeof(kPunctMap)) {
@@ -688,7 +751,7 @@ static Token *get_op_token(const char **pp) {
     if (kind != 0) {
       const char *q = p + 1;
       *pp = q;
-      return alloc_token(kind, lexer.line, p, q);
+      return alloc_token(kind, current_line(), p, q);
     }
   }
 
@@ -708,29 +771,52 @@ static Token *get_op_token(const char **pp) {
         if (kind != TK_EOF) {
           const char *q = p + len;
           *pp = q;
-          return alloc_token(kind, lexer.line, p, q);
+          return alloc_token(kind, current_line(), p, q);
         }
       }
 
       const char *q = p + 1;
       *pp = q;
-      return alloc_token(single, lexer.line, p, q);
+      return alloc_token(single, current_line(), p, q);
     }
   }
   return NULL;
 }
 
-static Token *get_token(void) {
+static Token *eof_token(void) {
   static Line kEofLine = {.buf = ""};
   static Token kEofToken = {.kind = TK_EOF, .line = &kEofLine};
+  kEofLine.filename = lexer.filename;
+  kEofLine.lineno = lexer.lineno;
+  return &kEofToken;
+}
+
+// Binary token stream, see token_stream.h.
+typedef struct {
+  const unsigned char *p;
+  const unsigned char *end;
+  Vector idents;  // <const Name*>
+  Vector files;  // <const char*>
+  Vector queue;  // <Token*>: Lexed from raw text, in reverse order.
+} TokenStream;
+
+static TokenStream *token_stream;  // Non-NULL while reading a binary token stream.
+
+static Vector embed_tokens;  // <Token*>: Expanded `#embed`, in reverse order.
+
+static Token *get_stream_token(void);
+
+static Token *get_token(void) {
+  if (embed_tokens.len > 0)
+    return vec_pop(&embed_tokens);
+  if (token_stream != NULL)
+    return get_stream_token();
 
   const char *p = lexer.p;
   if (p == NULL || (p = skip_whitespace_or_comment(p)) == NULL) {
     if ((p = lexer.p) != NULL && *p != '\0')
       lexer.p += strlen(p);  // Point to nul-chr.
-    kEofLine.filename = lexer.filename;
-    kEofLine.lineno = lexer.lineno;
-    return &kEofToken;
+    return eof_token();
   }
 
   Token *tok = NULL;
@@ -753,14 +839,16 @@ static Token *get_token(void) {
 #endif
   } else if ((tok = get_op_token(&p)) != NULL) {
     // Ok.
+  } else if (!for_preprocess && strncmp(p, "#embed", 6) == 0) {
+    tok = read_embed(&p);
   } else {
     const char *begin = p;
     const char *ident_end = read_ident(p);
     if (ident_end != NULL) {
       const Name *name = alloc_name(begin, ident_end, false);
       enum TokenKind kind = reserved_word(name);
-      tok = kind != TK_EOF ? alloc_token(kind, lexer.line, begin, ident_end)
-                          : alloc_ident(name, lexer.line, begin, ident_end);
+      tok = kind != TK_EOF ? alloc_token(kind, current_line(), begin, ident_end)
+                          : alloc_ident(name, current_line(), begin, ident_end);
       p = ident_end;
     } else {
       if (!for_preprocess) {
@@ -773,7 +861,7 @@ static Token *get_token(void) {
         for (; isutf8follow(*q); ++q)
           ;
       }
-      tok = alloc_token(PPTK_OTHERCHAR, lexer.line, p, q);
+      tok = alloc_token(PPTK_OTHERCHAR, current_line(), p, q);
       p = q;
     }
   }
@@ -783,6 +871,256 @@ static Token *get_token(void) {
   return tok;
 }
 
+static bool open_token_stream(SourceInput *input, const char *filename) {
+  static TokenStream stream;
+  token_stream = NULL;
+  if (input == NULL || input->end - input->p <= (ptrdiff_t)TOKEN_STREAM_MAGIC_LEN ||
+      memcmp(input->p, TOKEN_STREAM_MAGIC, TOKEN_STREAM_MAGIC_LEN) != 0)
+    return false;
+  if ((unsigned char)input->p[TOKEN_STREAM_MAGIC_LEN] != TOKEN_STREAM_FLONUM_SIZE)
+    error("%s: Incompatible binary token stream", filename);
+
+  stream.p = (unsigned char*)input->p + (TOKEN_STREAM_MAGIC_LEN + 1);
+  stream.end = (unsigned char*)input->end;
+  vec_init(&stream.idents);
+  vec_init(&stream.files);
+  vec_init(&stream.queue);
+  token_stream = &stream;
+  input->p = input->end;
+  return true;
+}
+
+static uint64_t read_stream_uleb(TokenStream *ts) {
+  uint64_t result = 0;
+  for (int shift = 0; ; shift += 7) {
+    if (ts->p >= ts->end)
+      error("Broken binary token stream");
+    unsigned char c = *ts->p++;
+    result |= (uint64_t)(c & 0x7f) << shift;
+    if (!(c & 0x80))
+      return result;
+  }
+}
+
+static const char *read_stream_bytes(TokenStream *ts, size_t *plen) {
+  size_t len = read_stream_uleb(ts);
+  if ((size_t)(ts->end - ts->p) < len)
+    error("Broken binary token stream");
+  const char *p = (const char*)ts->p;
+  ts->p += len;
+  *plen = len;
+  return p;
+}
+
+// Spelling of punctuators and operators, for error messages.
+static const Name *kind_spelling(enum TokenKind kind) {
+  static const Name *spellings[PPTK_CONCAT];
+  if (spellings[TK_ADD] == NULL) {
+    for (int i = 0; i < (int)ARRAY_SIZE(kMultiOperators); ++i)
+      spellings[kMultiOperators[i].kind] = alloc_name(kMultiOperators[i].ident, NULL, false);
+    for (int c = 0; c < (int)sizeof(kOperatorMap); ++c) {
+      char s = c;
+      if (kOperatorMap[c] != 0)
+        spellings[(int)kOperatorMap[c]] = alloc_name(&s, &s + 1, true);
+    }
+    for (int c = 0; c < (int)sizeof(kPunctMap); ++c) {
+      char s = c;
+      if (kPunctMap[c] != 0)
+        spellings[(int)kPunctMap[c]] = alloc_name(&s, &s + 1, true);
+    }
+  }
+  const Name *name = (unsigned)kind < ARRAY_SIZE(spellings) ? spellings[kind] : NULL;
+  return name != NULL ? name : alloc_name("", NULL, false);
+}
+
+// Lex raw text in the stream, which cpp could not represent as a token.
+static void lex_stream_raw(TokenStream *ts, const char *text, size_t len) {
+  char *buf = strndup(text, len);
+  Lexer saved = lexer;
+  token_stream = NULL;
+  lexer.input = NULL;
+  lexer.line = NULL;
+  lexer.linebuf = lexer.p = buf;
+  Vector *tokens = new_vector();
+  for (Token *tok; (tok = get_token())->kind != TK_EOF; )
+    vec_push(tokens, tok);
+  lexer = saved;
+  token_stream = ts;
+
+  for (int i = tokens->len; --i >= 0; )
+    vec_push(&ts->queue, tokens->data[i]);
+  free_vector(tokens);
+}
+
+static Token *get_stream_token(void) {
+  TokenStream *ts = token_stream;
+  while (ts->queue.len <= 0) {
+    if (ts->p >= ts->end)
+      return eof_token();
+
+    int kind = *ts->p++;
+    const char *spelling;
+    size_t len;
+    Token *tok;
+    switch (kind) {
+    case TSR_LINE:
+      lexer.lineno = read_stream_uleb(ts);
+      lexer.line = NULL;
+      continue;
+    case TSR_FILE:
+      {
+        int index = read_stream_uleb(ts);
+        if (index == ts->files.len) {
+          spelling = read_stream_bytes(ts, &len);
+          vec_push(&ts->files, strndup(spelling, len));
+        } else if (index > ts->files.len) {
+          error("Broken binary token stream");
+        }
+        lexer.filename = ts->files.data[index];
+        lexer.line = NULL;
+      }
+      continue;
+    case TSR_RAW:
+      spelling = read_stream_bytes(ts, &len);
+      lex_stream_raw(ts, spelling, len);
+      continue;
+
+    case TK_IDENT:
+      {
+        int index = read_stream_uleb(ts);
+        if (index == ts->idents.len) {
+          spelling = read_stream_bytes(ts, &len);
+          vec_push(&ts->idents, alloc_name(spelling, spelling + len, false));
+        } else if (index > ts->idents.len) {
+          error("Broken binary token stream");
+        }
+        const Name *name = ts->idents.data[index];
+        enum TokenKind reserved = reserved_word(name);
+        const char *end = name->chars + name->bytes;
+        return reserved != TK_EOF ? alloc_token(reserved, current_line(), name->chars, end)
+                                  : alloc_ident(name, current_line(), name->chars, end);
+      }
+    case TK_INTLIT:
+      {
+        UFixnum value = read_stream_uleb(ts);
+        int flag = read_stream_uleb(ts);
+        spelling = read_stream_bytes(ts, &len);
+        tok = alloc_token(TK_INTLIT, current_line(), spelling, spelling + len);
+        tok->fixnum.value = value;
+        tok->fixnum.flag = flag;
+      }
+      return tok;
+#ifndef __NO_FLONUM
+    case TK_FLOATLIT:
+      {
+        Flonum value;
+        if ((size_t)(ts->end - ts->p) < sizeof(value))
+          error("Broken binary token stream");
+        memcpy(&value, ts->p, sizeof(value));
+        ts->p += sizeof(value);
+        int flkind = read_stream_uleb(ts);
+        spelling = read_stream_bytes(ts, &len);
+        tok = alloc_token(TK_FLOATLIT, current_line(), spelling, spelling + len);
+        tok->flonum.value = value;
+        tok->flonum.kind = flkind;
+      }
+      return tok;
+#endif
+    case TK_STR:
+      spelling = read_stream_bytes(ts, &len);
+      if (len <= 0)
+        error("Broken binary token stream");
+      tok = alloc_token(TK_STR, current_line(), spelling, spelling + len - 1);
+      tok->str.buf = (char*)spelling;
+      tok->str.len = len;
+      tok->str.kind = STR_CHAR;
+      return tok;
+    case TK_EMBED:
+      spelling = read_stream_bytes(ts, &len);
+      tok = alloc_token(TK_EMBED, current_line(), "#embed", NULL);
+      tok->embed.path = strndup(spelling, len);
+      tok->embed.size = read_stream_uleb(ts);
+      read_stream_uleb(ts);  // Hash of the bytes.
+      return tok;
+    default:
+      if (kind <= TK_EOF || kind >= PPTK_CONCAT)
+        error("Broken binary token stream");
+      {
+        const Name *name = kind_spelling(kind);
+        return alloc_token(kind, current_line(), name->chars, name->chars + name->bytes);
+      }
+    }
+  }
+  return vec_pop(&ts->queue);
+}
+
+// Tokens from a binary token stream have no text of their line: read it from the source file
+// for diagnostics, and locate the token by its spelling (NULL if not found). Caller frees.
+char *reload_token_line(const Token *token, const char **pbegin) {
+  const Line *line = token->line;
+  FILE *fp = fopen(line->filename, "r");
+  if (fp == NULL)
+    return NULL;
+  char *buf = NULL;
+  size_t capa = 0;
+  ssize_t len = -1;
+  for (int i = 0; i < line->lineno && (len = getline_chomp(&buf, &capa, fp)) >= 0; ++i)
+    ;
+  fclose(fp);
+  if (len < 0) {
+    free(buf);
+    return NULL;
+  }
+
+  *pbegin = NULL;
+  size_t n = token->end - token->begin;
+  for (const char *p = buf; n > 0 && (p = strchr(p, *token->begin)) != NULL; ++p) {
+    if (strncmp(p, token->begin, n) == 0) {
+      *pbegin = p;
+      break;
+    }
+  }
+  return buf;
+}
+
+void read_embed_data(const Token *tok, void *buf) {
+  assert(tok->kind == TK_EMBED);
+  size_t size = tok->embed.size;
+  FILE *fp = fopen(tok->embed.path, "rb");
+  if (fp == NULL)
+    error("Cannot open file: %s", tok->embed.path);
+  if (fread(buf, 1, size, fp) != size)
+    error("%s: Cannot read %zu bytes for #embed", tok->embed.path, size);
+  fclose(fp);
+}
+
+void expand_embed(const Token *tok) {
+  static char spellings[256][4];
+  unsigned char *data = malloc_or_die(tok->embed.size);
+  read_embed_data(tok, data);
+  Token *comma = alloc_token(TK_COMMA, tok->line, ",", NULL);
+
+  // Fetched tokens come after the expanded ones.
+  Vector *queue = &embed_tokens;
+  for (int i = 0; i <= lexer.idx; ++i)
+    vec_push(queue, lexer.fetched[i]);
+  lexer.idx = -1;
+
+  for (size_t i = tok->embed.size; i-- > 0; ) {
+    int c = data[i];
+    char *spelling = spellings[c];
+    if (spelling[0] == '\0')
+      snprintf(spelling, sizeof(spellings[c]), "%d", c);
+    Token *num = alloc_token(TK_INTLIT, tok->line, spelling, NULL);
+    num->fixnum.value = c;
+    num->fixnum.flag = 0;
+    vec_push(queue, num);
+    if (i > 0)
+      vec_push(queue, comma);
+  }
+  free(data);
+}
+
 Token *fetch_token(void) {
   if (lexer.idx < 0) {
     Token *tok = get_token();
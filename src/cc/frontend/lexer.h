@@ -9,11 +9,13 @@
 
 typedef struct Line Line;
 typedef struct Name Name;
+typedef struct SourceInput SourceInput;
 
 typedef struct {
-  FILE *fp;
+  SourceInput *input;
   const char *filename;
-  Line *line;
+  Line *line;  // Allocated on demand by the first token on the line.
+  const char *linebuf;
   const char *p;
   Token *fetched[MAX_LEX_LOOKAHEAD];
   int idx;
@@ -23,6 +25,7 @@ typedef struct {
 void init_lexer(void);
 void init_lexer_for_preprocessor(void);
 void set_source_file(FILE *fp, const char *filename);
+void set_source_input(SourceInput *input, const char *filename);
 void set_source_string(const char *line, const char *filename, int lineno);
 Token *fetch_token(void);
 Token *match(enum TokenKind kind);
@@ -30,8 +33,13 @@ void unget_token(Token *token);
 const char *read_ident(const char *p);
 Token *alloc_dummy_ident(void);
 const char *get_lex_p(void);
+char *reload_token_line(const Token *token, const char **pbegin);
 _Noreturn void lex_error(const char *p, const char *fmt, ...);
 
+// `#embed`: Read the bytes, or expand to comma separated numbers in front of the next token.
+void read_embed_data(const Token *tok, void *buf);
+void expand_embed(const Token *tok);
+
 typedef bool (*LexEofCallback)(void);
 LexEofCallback set_lex_eof_callback(LexEofCallback callback);
 bool lex_eof_continue(void);
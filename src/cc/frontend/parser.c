@@ -120,6 +120,15 @@ Initializer *parse_initializer(void) {
     if (!match(TK_RBRACE)) {
       for (;;) {
         Initializer *init = parse_initializer_multi();
+        const Token *tok;
+        if (init == NULL && (tok = match(TK_EMBED)) != NULL) {
+          // Keep the file as is, unless it is a part of an expression.
+          enum TokenKind next = fetch_token()->kind;
+          if (next == TK_COMMA || next == TK_RBRACE)
+            init = new_initializer(IK_EMBED, tok);
+          else
+            expand_embed(tok);
+        }
         if (init == NULL)
           init = parse_initializer();
         assert(init != NULL);
@@ -188,7 +197,11 @@ static Vector *parse_vardecl_cont(Type *rawType, Type *type, int storage, Token
       Vector *param_vars = parse_funparams(&vaargs);
       Vector *param_types = extract_varinfo_types(param_vars);
       type = new_func_type(type, param_types, vaargs);
-      type->func.param_vars = param_vars;
+      if (param_vars != NULL) {
+        // Parameter names belong to the declaration, so the interned type is not modified.
+        type = clone_type(type);
+        type->func.param_vars = param_vars;
+      }
     } else {
       if (!(tmp_storage & VS_TYPEDEF)) {
         if (!not_void(type, NULL))
@@ -879,8 +892,10 @@ static Declaration *parse_defun(Type *functype, int storage, Token *ident, const
   const Vector *param_vars = functype->func.param_vars;
   if (functype->func.params == NULL) {  // Old-style
     // Treat it as a zero-parameter function.
+    functype = clone_type(functype);
     functype->func.params = new_vector();
     functype->func.vaargs = false;
+    update_canonical_type(functype);
     param_vars = new_vector();
   }
 
@@ -1238,18 +1253,29 @@ static void modify_dtor_func(Vector *decls) {
 }
 #endif
 
-void parse(Vector *decls) {
+bool parse_toplevel(Vector *decls) {
   curscope = global_scope;
 
-  while (!match(TK_EOF)) {
-    Declaration *decl = parse_declaration(decls);
-    if (decl != NULL)
-      vec_push(decls, decl);
-  }
+  if (match(TK_EOF))
+    return false;
+  Declaration *decl = parse_declaration(decls);
+  if (decl != NULL)
+    vec_push(decls, decl);
+  return true;
+}
 
+void finish_parse(Vector *decls) {
   propagate_var_used();
 
 #if XCC_TARGET_PLATFORM == XCC_PLATFORM_APPLE || XCC_TARGET_PLATFORM == XCC_PLATFORM_WASI
   modify_dtor_func(decls);
+#else
+  UNUSED(decls);
 #endif
 }
+
+void parse(Vector *decls) {
+  while (parse_toplevel(decls))
+    ;
+  finish_parse(decls);
+}
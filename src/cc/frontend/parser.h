@@ -15,6 +15,10 @@ typedef struct Vector Vector;
 
 void parse(Vector *decls);  // <Declaration*>
 
+// Parse toplevel one by one, equivalent to `parse`.
+bool parse_toplevel(Vector *decls);  // Returns false at the end of source.
+void finish_parse(Vector *decls);
+
 //
 
 typedef Expr *(*BuiltinExprProc)(const Token*);
@@ -200,10 +200,7 @@ static Expr *parse_generic(void) {
   case TY_FUNC:   type = ptrof(type); break;
   default: break;
   }
-  if (type->qualifier != 0) {
-    type = clone_type(type);
-    type->qualifier = 0;
-  }
+  type = unqualified_type(type);
   for (int i = 0; i < types->len; ++i) {
     Type *t = types->data[i];
     if (same_type(t, type))
@@ -331,6 +328,12 @@ static Expr *literal(Token *tok) {
   }
 }
 
+// `#embed` out of an initializer list: numbers separated by comma.
+static Expr *embed(Token *tok) {
+  expand_embed(tok);
+  return literal(consume(TK_INTLIT, "number expected"));
+}
+
 static Expr *variable(Token *ident) {
   const Name *name = ident->ident;
   BuiltinExprProc *proc = table_get(&builtin_expr_ident_table, name);
@@ -667,10 +670,11 @@ static Expr *funcall(Expr *func, Token *tok) {
   if (func->kind == EX_VAR && is_global_scope(func->var.scope)) {
     VarInfo *varinfo = scope_find(func->var.scope, func->var.name, NULL);
     assert(varinfo != NULL);
-    if (satisfy_inline_criteria(varinfo))
+    if (should_inline_funcall(varinfo))
       return new_expr_inlined(tok, varinfo->ident->ident, rettype, args,
-                              embed_inline_funcall(varinfo));
+                              embed_inline_funcall(varinfo, args));
     // Not inlined.
+    varinfo->storage |= VS_CALLED;
     if (varinfo->storage & VS_INLINE)
       varinfo->storage |= VS_EXTERN;  // To emit inline function.
   }
@@ -717,6 +721,7 @@ static Expr *size_align_of(Token *token) {
     if (type->pa.length == -1) {
       parse_error(PE_NOFATAL, tok, "size unknown");
       type->pa.length = 1;  // Continue parsing.
+      update_canonical_type(type);
     }
     assert(type->pa.length >= 0);
     break;
@@ -792,6 +797,7 @@ static const ParseRule *get_rule(enum TokenKind kind) {
     [TK_INTLIT]        = {literal},
     [TK_STR]           = {literal},
     [TK_FLOATLIT]      = {literal},
+    [TK_EMBED]         = {embed},
 
     [TK_IDENT]         = {variable},
 
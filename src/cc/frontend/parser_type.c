@@ -116,6 +116,7 @@ static StructInfo *parse_struct(bool is_union) {
           // To continue compile.
           type->pa.vla = NULL;
           type->pa.length = 1;
+          update_canonical_type(type);
         }
 #endif
         if (type->pa.length == LEN_UND) {
@@ -542,7 +543,7 @@ static Type *parse_direct_declarator_suffix(Type *type) {
     {
       type = arrayof(subtype, length);
       if (basetype->qualifier & TQ_CONST)
-        type->qualifier |= TQ_CONST;
+        type = qualified_type(type, TQ_CONST);
     }
   } else if (match(TK_LPAR)) {
     bool vaargs;
@@ -555,10 +556,32 @@ static Type *parse_direct_declarator_suffix(Type *type) {
 
     Vector *param_types = extract_varinfo_types(param_vars);
     type = new_func_type(rettype, param_types, vaargs);
-    type->func.param_vars = param_vars;
+    if (param_vars != NULL) {
+      // Parameter names belong to the declaration, so the interned type is not modified.
+      type = clone_type(type);
+      type->func.param_vars = param_vars;
+    }
   }
   return type;
 }
+
+// Types built on `placeholder` are fixed after it is filled.
+static void update_canonical_types_to(Type *type, const Type *placeholder) {
+  if (type == placeholder)
+    return;
+  switch (type->kind) {
+  case TY_PTR: case TY_ARRAY:
+    update_canonical_types_to(type->pa.ptrof, placeholder);
+    break;
+  case TY_FUNC:
+    update_canonical_types_to(type->func.ret, placeholder);
+    break;
+  default:
+    return;
+  }
+  update_canonical_type(type);
+}
+
 Type *parse_direct_declarator(Type *type, Token **pident) {
   Token *ident = NULL;
   if (match(TK_LPAR)) {
@@ -566,12 +589,14 @@ Type *parse_direct_declarator(Type *type, Token **pident) {
     Type *placeholder = calloc_or_die(sizeof(*placeholder));
     assert(placeholder != NULL);
     memcpy(placeholder, type, sizeof(*placeholder));
+    placeholder->canonical = placeholder->unqualified = NULL;  // Contents are replaced below.
 
     type = parse_declarator(placeholder, &ident);
     consume(TK_RPAR, "`)' expected");
 
     Type *inner = parse_direct_declarator_suffix(ret);
     memcpy(placeholder, inner, sizeof(*placeholder));
+    update_canonical_types_to(type, placeholder);
   } else {
     ident = match(TK_IDENT);
     type = parse_direct_declarator_suffix(type);
@@ -0,0 +1,660 @@
+#include "../../config.h"
+#include "pch.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>  // calloc
+#include <string.h>
+
+#include "ast.h"
+#include "table.h"
+#include "type.h"
+#include "util.h"
+#include "var.h"
+
+// Layout, numbers in LEB128, and objects are referred by index + 1 (0 for NULL):
+//
+//   Counts:   types, structs, files {filename}
+//   Structs:  {member count, size, align, is_union, is_flexible, {member}}
+//   Types:    {kind, qualifier, fields of the kind}
+//   Tables:   struct, typedef and enum tables: count, {name, index}
+//   Vars:     count, {ident, type, storage, enum value or prototype}
+//
+// Types and structs are created before their fields are filled, to restore cycles.
+// Strings have the terminator, and names and file names point into the buffer.
+
+#define TABLE_COUNT  (3)
+
+typedef struct {
+  PtrTable map;  // Object to index.
+  Vector objs;
+} ObjList;
+
+static struct {
+  int decls_len;
+  int vars_len;
+  Table *names[TABLE_COUNT];  // Names in the tables before the header.
+} pch_begin;
+
+// Struct, typedef and enum tables.
+static Table **scope_tables(Scope *scope, int index) {
+  Table **tables[TABLE_COUNT] = {&scope->struct_table, &scope->typedef_table, &scope->enum_table};
+  assert(0 <= index && index < TABLE_COUNT);
+  return tables[index];
+}
+
+// Returns true if `obj` is added.
+static bool objlist_add(ObjList *list, const void *obj) {
+  if (ptr_table_try_get(&list->map, obj, NULL))
+    return false;
+  ptr_table_put(&list->map, obj, INT2VOIDP(list->objs.len));
+  vec_push(&list->objs, (void*)obj);
+  return true;
+}
+
+static int objlist_index(const ObjList *list, const void *obj) {
+  void *index;
+  return obj != NULL && ptr_table_try_get(&list->map, obj, &index) ? VOIDP2INT(index) + 1 : 0;
+}
+
+static void objlist_release(ObjList *list) {
+  ptr_table_release(&list->map);
+  free(list->objs.data);
+}
+
+void begin_pch_scope(const Vector *decls) {
+  pch_begin.decls_len = decls->len;
+  pch_begin.vars_len = global_scope->vars->len;
+  for (int i = 0; i < TABLE_COUNT; ++i) {
+    Table *table = *scope_tables(global_scope, i);
+    if (table == NULL)
+      continue;
+    pch_begin.names[i] = alloc_table();
+    const Name *name;
+    for (int it = 0; (it = table_iterate(table, it, &name, NULL)) != -1; )
+      table_put(pch_begin.names[i], name, NULL);
+  }
+}
+
+// Save
+
+typedef struct {
+  DataStorage *data;
+  ObjList types;
+  ObjList structs;
+  ObjList files;
+} PchWriter;
+
+static void write_str(DataStorage *data, const char *str, size_t len) {
+  data_uleb128(data, -1, len + 1);
+  data_append(data, str, len);
+  data_push(data, '\0');
+}
+
+static void write_name(DataStorage *data, const Name *name) {
+  if (name != NULL)
+    write_str(data, name->chars, name->bytes);
+  else
+    data_uleb128(data, -1, 0);
+}
+
+static bool collect_type(PchWriter *w, const Type *type);
+
+static bool collect_vars(PchWriter *w, const Vector *vars) {
+  for (int i = 0; i < vars->len; ++i) {
+    const VarInfo *varinfo = vars->data[i];
+    if (!collect_type(w, varinfo->type))
+      return false;
+    if (varinfo->ident != NULL && varinfo->ident->line != NULL)
+      objlist_add(&w->files, varinfo->ident->line->filename);
+  }
+  return true;
+}
+
+static bool collect_type(PchWriter *w, const Type *type) {
+  if (type == NULL || !objlist_add(&w->types, type))
+    return true;
+
+  switch (type->kind) {
+  case TY_VOID: case TY_FIXNUM: case TY_FLONUM:
+    return true;
+  case TY_PTR: case TY_ARRAY:
+#ifndef __NO_VLA
+    if (type->pa.vla != NULL || type->pa.size_var != NULL)
+      return false;
+#endif
+    return collect_type(w, type->pa.ptrof);
+  case TY_FUNC:
+    if (!collect_type(w, type->func.ret))
+      return false;
+    if (type->func.params != NULL) {
+      for (int i = 0; i < type->func.params->len; ++i) {
+        if (!collect_type(w, type->func.params->data[i]))
+          return false;
+      }
+    }
+    return type->func.param_vars == NULL || collect_vars(w, type->func.param_vars);
+  case TY_STRUCT:
+    {
+      const StructInfo *sinfo = type->struct_.info;
+      if (sinfo == NULL || !objlist_add(&w->structs, sinfo))
+        return true;
+      for (int i = 0; i < sinfo->member_count; ++i) {
+        if (!collect_type(w, sinfo->members[i].type))
+          return false;
+      }
+    }
+    return true;
+  case TY_AUTO:
+    break;
+  }
+  return false;
+}
+
+static void write_token(PchWriter *w, const Token *token) {
+  DataStorage *data = w->data;
+  write_name(data, token != NULL ? token->ident : NULL);
+  if (token == NULL)
+    return;
+  const Line *line = token->line;
+  data_uleb128(data, -1, line != NULL ? objlist_index(&w->files, line->filename) : 0);
+  data_uleb128(data, -1, line != NULL ? line->lineno : 0);
+}
+
+static void write_vars(PchWriter *w, const Vector *vars) {
+  DataStorage *data = w->data;
+  data_uleb128(data, -1, vars != NULL ? vars->len + 1 : 0);
+  if (vars == NULL)
+    return;
+  for (int i = 0; i < vars->len; ++i) {
+    const VarInfo *varinfo = vars->data[i];
+    write_token(w, varinfo->ident);
+    data_uleb128(data, -1, objlist_index(&w->types, varinfo->type));
+    data_uleb128(data, -1, varinfo->storage);
+  }
+}
+
+static void write_struct(PchWriter *w, const StructInfo *sinfo) {
+  DataStorage *data = w->data;
+  data_uleb128(data, -1, sinfo->member_count);
+  data_leb128(data, -1, sinfo->size);
+  data_uleb128(data, -1, sinfo->align);
+  data_uleb128(data, -1, sinfo->is_union);
+  data_uleb128(data, -1, sinfo->is_flexible);
+  for (int i = 0; i < sinfo->member_count; ++i) {
+    const MemberInfo *minfo = &sinfo->members[i];
+    write_name(data, minfo->name);
+    data_uleb128(data, -1, objlist_index(&w->types, minfo->type));
+    data_uleb128(data, -1, minfo->offset);
+#ifndef __NO_BITFIELD
+    data_leb128(data, -1, minfo->bitfield.active);
+    data_leb128(data, -1, minfo->bitfield.width);
+    data_uleb128(data, -1, minfo->bitfield.position);
+    data_uleb128(data, -1, minfo->bitfield.base_kind);
+#endif
+  }
+}
+
+static void write_type(PchWriter *w, const Type *type) {
+  DataStorage *data = w->data;
+  data_uleb128(data, -1, type->kind);
+  data_uleb128(data, -1, type->qualifier);
+  switch (type->kind) {
+  case TY_VOID:
+    break;
+  case TY_FIXNUM:
+    data_uleb128(data, -1, type->fixnum.kind);
+    data_uleb128(data, -1, type->fixnum.is_unsigned);
+    write_name(data, type->fixnum.enum_.ident);
+    break;
+  case TY_FLONUM:
+    data_uleb128(data, -1, type->flonum.kind);
+    break;
+  case TY_PTR: case TY_ARRAY:
+    data_uleb128(data, -1, objlist_index(&w->types, type->pa.ptrof));
+    data_leb128(data, -1, type->pa.length);
+    break;
+  case TY_FUNC:
+    data_uleb128(data, -1, objlist_index(&w->types, type->func.ret));
+    data_uleb128(data, -1, type->func.vaargs);
+    data_uleb128(data, -1, type->func.params != NULL ? type->func.params->len + 1 : 0);
+    if (type->func.params != NULL) {
+      for (int i = 0; i < type->func.params->len; ++i)
+        data_uleb128(data, -1, objlist_index(&w->types, type->func.params->data[i]));
+    }
+    write_vars(w, type->func.param_vars);
+    break;
+  case TY_STRUCT:
+    write_name(data, type->struct_.name);
+    data_uleb128(data, -1, objlist_index(&w->structs, type->struct_.info));
+    break;
+  case TY_AUTO: assert(false); break;
+  }
+}
+
+// Attribute parameters are kept only for identifiers, strings and integers.
+static bool write_attributes(DataStorage *data, Table *attributes) {
+  data_uleb128(data, -1, attributes != NULL ? attributes->count : 0);
+  if (attributes == NULL)
+    return true;
+  const Name *name;
+  void *value;
+  for (int it = 0; (it = table_iterate(attributes, it, &name, &value)) != -1; ) {
+    const Vector *params = value;
+    write_name(data, name);
+    data_uleb128(data, -1, params != NULL ? params->len + 1 : 0);
+    if (params == NULL)
+      continue;
+    for (int i = 0; i < params->len; ++i) {
+      const Token *token = params->data[i];
+      data_uleb128(data, -1, token->kind);
+      switch (token->kind) {
+      case TK_IDENT:
+        write_name(data, token->ident);
+        break;
+      case TK_STR:
+        if (token->str.kind != STR_CHAR)
+          return false;
+        data_string(data, token->str.buf, token->str.len);
+        break;
+      case TK_INTLIT:
+        data_leb128(data, -1, token->fixnum.value);
+        data_uleb128(data, -1, token->fixnum.flag);
+        break;
+      default:
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static bool is_declaration(const VarInfo *varinfo) {
+  if (varinfo->storage & VS_ENUM_MEMBER)
+    return true;
+  if (varinfo->type->kind == TY_FUNC)
+    return varinfo->global.func == NULL;
+  return (varinfo->storage & VS_EXTERN) && varinfo->global.init == NULL;
+}
+
+bool save_pch_scope(DataStorage *data, const Vector *decls) {
+  if (decls->len != pch_begin.decls_len)
+    return false;  // Function definition or `asm`.
+
+  const Vector *vars = global_scope->vars;
+  PchWriter w = {.data = data};
+  bool ok = true;
+  for (int i = pch_begin.vars_len; i < vars->len && ok; ++i) {
+    const VarInfo *varinfo = vars->data[i];
+    ok = is_declaration(varinfo) && collect_type(&w, varinfo->type);
+    if (varinfo->ident->line != NULL)
+      objlist_add(&w.files, varinfo->ident->line->filename);
+  }
+  for (int i = 0; i < TABLE_COUNT && ok; ++i) {
+    Table *table = *scope_tables(global_scope, i);
+    if (table == NULL)
+      continue;
+    const Name *name;
+    void *value;
+    for (int it = 0; (it = table_iterate(table, it, &name, &value)) != -1 && ok; ) {
+      if (i == 0) {
+        // Struct tags refer StructInfo directly.
+        const StructInfo *sinfo = value;
+        if (objlist_add(&w.structs, sinfo)) {
+          for (int j = 0; j < sinfo->member_count && ok; ++j)
+            ok = collect_type(&w, sinfo->members[j].type);
+        }
+      } else {
+        ok = collect_type(&w, value);
+      }
+    }
+  }
+
+  if (ok) {
+    data_uleb128(data, -1, w.types.objs.len);
+    data_uleb128(data, -1, w.structs.objs.len);
+    data_uleb128(data, -1, w.files.objs.len);
+    for (int i = 0; i < w.files.objs.len; ++i) {
+      const char *filename = w.files.objs.data[i];
+      write_str(data, filename, strlen(filename));
+    }
+    for (int i = 0; i < w.structs.objs.len; ++i)
+      write_struct(&w, w.structs.objs.data[i]);
+    for (int i = 0; i < w.types.objs.len; ++i)
+      write_type(&w, w.types.objs.data[i]);
+
+    for (int i = 0; i < TABLE_COUNT; ++i) {
+      Table *table = *scope_tables(global_scope, i);
+      Table *before = pch_begin.names[i];
+      int count = 0;
+      const Name *name;
+      void *value;
+      if (table != NULL) {
+        for (int it = 0; (it = table_iterate(table, it, &name, &value)) != -1; )
+          count += before == NULL || !table_try_get(before, name, NULL);
+      }
+      data_uleb128(data, -1, count);
+      if (count == 0)
+        continue;
+      for (int it = 0; (it = table_iterate(table, it, &name, &value)) != -1; ) {
+        if (before != NULL && table_try_get(before, name, NULL))
+          continue;
+        write_name(data, name);
+        data_uleb128(data, -1, objlist_index(i == 0 ? &w.structs : &w.types, value));
+      }
+    }
+
+    data_uleb128(data, -1, vars->len - pch_begin.vars_len);
+    for (int i = pch_begin.vars_len; i < vars->len && ok; ++i) {
+      const VarInfo *varinfo = vars->data[i];
+      write_token(&w, varinfo->ident);
+      data_uleb128(data, -1, objlist_index(&w.types, varinfo->type));
+      data_uleb128(data, -1, varinfo->storage);
+      if (varinfo->storage & VS_ENUM_MEMBER) {
+        data_leb128(data, -1, varinfo->enum_member.value);
+      } else if (varinfo->type->kind == TY_FUNC) {
+        const Declaration *funcdecl = varinfo->global.funcdecl;
+        const Function *func = funcdecl != NULL ? funcdecl->defun.func : NULL;
+        data_uleb128(data, -1, func != NULL ? func->flag + 1 : 0);
+        if (func != NULL)
+          ok = write_attributes(data, func->attributes);
+      }
+    }
+  }
+
+  objlist_release(&w.types);
+  objlist_release(&w.structs);
+  objlist_release(&w.files);
+  return ok;
+}
+
+// Load
+
+typedef struct {
+  DataReader *reader;
+  Type **types;
+  StructInfo **structs;
+  const char **files;
+  int type_count;
+  int struct_count;
+  int file_count;
+} PchLoader;
+
+static const Name *read_name(DataReader *reader) {
+  size_t len;
+  const char *str = data_read_string(reader, &len);
+  return len > 1 ? alloc_name(str, str + len - 1, false) : NULL;
+}
+
+static Type *read_type_ref(PchLoader *l) {
+  uint64_t index = data_read_uleb128(l->reader);
+  if (index > (uint64_t)l->type_count) {
+    l->reader->error = true;
+    return NULL;
+  }
+  return index > 0 ? l->types[index - 1] : NULL;
+}
+
+static StructInfo *read_struct_ref(PchLoader *l) {
+  uint64_t index = data_read_uleb128(l->reader);
+  if (index > (uint64_t)l->struct_count) {
+    l->reader->error = true;
+    return NULL;
+  }
+  return index > 0 ? l->structs[index - 1] : NULL;
+}
+
+static Token *read_token(PchLoader *l) {
+  DataReader *reader = l->reader;
+  const Name *name = read_name(reader);
+  if (name == NULL)
+    return NULL;
+  uint64_t file = data_read_uleb128(reader);
+  int lineno = data_read_uleb128(reader);
+  Line *line = NULL;
+  if (file > 0 && file <= (uint64_t)l->file_count) {
+    line = arena_calloc(&ast_arena, sizeof(*line));
+    line->filename = l->files[file - 1];
+    line->lineno = lineno;
+  }
+  return alloc_ident(name, line, name->chars, name->chars + name->bytes);
+}
+
+static Vector *read_vars(PchLoader *l) {
+  DataReader *reader = l->reader;
+  int count = (int)data_read_uleb128(reader) - 1;
+  if (count < 0)
+    return NULL;
+  Vector *vars = new_vector();
+  for (int i = 0; i < count && !reader->error; ++i) {
+    const Token *ident = read_token(l);
+    Type *type = read_type_ref(l);
+    int storage = data_read_uleb128(reader);
+    if (ident != NULL && var_find(vars, ident->ident) >= 0)
+      ident = NULL;
+    var_add(vars, ident, type, storage);
+  }
+  return vars;
+}
+
+static void read_struct(PchLoader *l, StructInfo *sinfo) {
+  DataReader *reader = l->reader;
+  int count = data_read_uleb128(reader);
+  sinfo->size = data_read_leb128(reader);
+  sinfo->align = data_read_uleb128(reader);
+  sinfo->is_union = data_read_uleb128(reader) != 0;
+  sinfo->is_flexible = data_read_uleb128(reader) != 0;
+  if (reader->error || count < 0 || count > reader->end - reader->p) {
+    reader->error = true;
+    return;
+  }
+  MemberInfo *members = arena_calloc(&ast_arena, sizeof(*members) * count);
+  for (int i = 0; i < count; ++i) {
+    MemberInfo *minfo = &members[i];
+    minfo->name = read_name(reader);
+    minfo->type = read_type_ref(l);
+    minfo->offset = data_read_uleb128(reader);
+#ifndef __NO_BITFIELD
+    minfo->bitfield.active = data_read_leb128(reader);
+    minfo->bitfield.width = data_read_leb128(reader);
+    minfo->bitfield.position = data_read_uleb128(reader);
+    minfo->bitfield.base_kind = data_read_uleb128(reader);
+#endif
+  }
+  sinfo->members = members;
+  sinfo->member_count = count;
+}
+
+static void read_type(PchLoader *l, Type *type) {
+  DataReader *reader = l->reader;
+  type->kind = data_read_uleb128(reader);
+  type->qualifier = data_read_uleb128(reader);
+  switch (type->kind) {
+  case TY_VOID:
+    break;
+  case TY_FIXNUM:
+    type->fixnum.kind = data_read_uleb128(reader);
+    type->fixnum.is_unsigned = data_read_uleb128(reader) != 0;
+    type->fixnum.enum_.ident = read_name(reader);
+    break;
+  case TY_FLONUM:
+    type->flonum.kind = data_read_uleb128(reader);
+    break;
+  case TY_PTR: case TY_ARRAY:
+    type->pa.ptrof = read_type_ref(l);
+    type->pa.length = data_read_leb128(reader);
+    if (type->pa.ptrof == NULL)
+      reader->error = true;
+    break;
+  case TY_FUNC:
+    {
+      type->func.ret = read_type_ref(l);
+      type->func.vaargs = data_read_uleb128(reader) != 0;
+      if (type->func.ret == NULL)
+        reader->error = true;
+      int count = (int)data_read_uleb128(reader) - 1;
+      if (count >= 0) {
+        Vector *params = new_vector();
+        for (int i = 0; i < count && !reader->error; ++i)
+          vec_push(params, read_type_ref(l));
+        type->func.params = params;
+      }
+      type->func.param_vars = read_vars(l);
+    }
+    break;
+  case TY_STRUCT:
+    type->struct_.name = read_name(reader);
+    type->struct_.info = read_struct_ref(l);
+    break;
+  default:
+    reader->error = true;
+    break;
+  }
+}
+
+// Canonical types refer to the ones of the components, so they are filled first.
+static void fill_canonical_type(Type *type, PtrTable *filled) {
+  void *value;
+  if (type == NULL || ptr_table_try_get(filled, type, &value))
+    return;
+  ptr_table_put(filled, type, type);
+  switch (type->kind) {
+  case TY_PTR: case TY_ARRAY:
+    fill_canonical_type(type->pa.ptrof, filled);
+    break;
+  case TY_FUNC:
+    fill_canonical_type(type->func.ret, filled);
+    if (type->func.params != NULL) {
+      for (int i = 0; i < type->func.params->len; ++i)
+        fill_canonical_type(type->func.params->data[i], filled);
+    }
+    break;
+  default: break;
+  }
+  update_canonical_type(type);
+}
+
+static Table *read_attributes(DataReader *reader) {
+  int count = data_read_uleb128(reader);
+  if (count == 0)
+    return NULL;
+  Table *attributes = alloc_table();
+  for (int i = 0; i < count && !reader->error; ++i) {
+    const Name *name = read_name(reader);
+    int param_count = (int)data_read_uleb128(reader) - 1;
+    Vector *params = NULL;
+    if (param_count >= 0) {
+      params = new_vector();
+      for (int j = 0; j < param_count && !reader->error; ++j) {
+        enum TokenKind kind = data_read_uleb128(reader);
+        Token *token = NULL;
+        switch (kind) {
+        case TK_IDENT:
+          {
+            const Name *ident = read_name(reader);
+            if (ident != NULL)
+              token = alloc_ident(ident, NULL, ident->chars, ident->chars + ident->bytes);
+          }
+          break;
+        case TK_STR:
+          {
+            size_t len;
+            const char *str = data_read_string(reader, &len);
+            token = alloc_token(kind, NULL, str, str + len);
+            token->str.buf = (char*)str;
+            token->str.len = len;
+            token->str.kind = STR_CHAR;
+          }
+          break;
+        case TK_INTLIT:
+          token = alloc_token(kind, NULL, "", NULL);
+          token->fixnum.value = data_read_leb128(reader);
+          token->fixnum.flag = data_read_uleb128(reader);
+          break;
+        default:
+          break;
+        }
+        if (token == NULL) {
+          reader->error = true;
+          break;
+        }
+        vec_push(params, token);
+      }
+    }
+    if (name != NULL)
+      table_put(attributes, name, params);
+  }
+  return attributes;
+}
+
+void load_pch_scope(const void *buf, size_t size) {
+  DataReader reader;
+  data_reader_init(&reader, buf, size);
+  PchLoader l = {.reader = &reader};
+  l.type_count = data_read_uleb128(&reader);
+  l.struct_count = data_read_uleb128(&reader);
+  l.file_count = data_read_uleb128(&reader);
+  if (reader.error || l.type_count < 0 || l.struct_count < 0 || l.file_count < 0 ||
+      l.type_count + l.struct_count + l.file_count > reader.end - reader.p)
+    error("Broken precompiled header");
+
+  l.files = arena_alloc(&ast_arena, sizeof(*l.files) * l.file_count);
+  for (int i = 0; i < l.file_count; ++i) {
+    size_t len;
+    l.files[i] = data_read_string(&reader, &len);
+  }
+  l.structs = arena_alloc(&ast_arena, sizeof(*l.structs) * l.struct_count);
+  for (int i = 0; i < l.struct_count; ++i)
+    l.structs[i] = arena_calloc(&ast_arena, sizeof(StructInfo));
+  l.types = arena_alloc(&ast_arena, sizeof(*l.types) * l.type_count);
+  for (int i = 0; i < l.type_count; ++i)
+    l.types[i] = arena_calloc(&ast_arena, sizeof(Type));
+
+  for (int i = 0; i < l.struct_count && !reader.error; ++i)
+    read_struct(&l, l.structs[i]);
+  for (int i = 0; i < l.type_count && !reader.error; ++i)
+    read_type(&l, l.types[i]);
+  if (!reader.error) {
+    PtrTable filled;
+    ptr_table_init(&filled);
+    for (int i = 0; i < l.type_count; ++i)
+      fill_canonical_type(l.types[i], &filled);
+    ptr_table_release(&filled);
+  }
+
+  for (int i = 0; i < TABLE_COUNT; ++i) {
+    Table **ptable = scope_tables(global_scope, i);
+    for (int n = data_read_uleb128(&reader); n > 0 && !reader.error; --n) {
+      const Name *name = read_name(&reader);
+      void *value = i == 0 ? (void*)read_struct_ref(&l) : (void*)read_type_ref(&l);
+      if (name == NULL || value == NULL)
+        continue;
+      if (*ptable == NULL)
+        *ptable = alloc_table();
+      table_put(*ptable, name, value);
+    }
+  }
+
+  for (int n = data_read_uleb128(&reader); n > 0 && !reader.error; --n) {
+    const Token *ident = read_token(&l);
+    Type *type = read_type_ref(&l);
+    int storage = data_read_uleb128(&reader);
+    if (ident == NULL || type == NULL) {
+      reader.error = true;
+      break;
+    }
+    VarInfo *varinfo = scope_add(global_scope, ident, type, storage);
+    if (storage & VS_ENUM_MEMBER) {
+      varinfo->enum_member.value = data_read_leb128(&reader);
+    } else if (type->kind == TY_FUNC) {
+      int flag = (int)data_read_uleb128(&reader) - 1;
+      if (flag >= 0) {
+        Table *attributes = read_attributes(&reader);
+        Function *func = new_func(type, ident, type->func.param_vars, attributes, flag);
+        varinfo->global.funcdecl = new_decl_defun(func);
+      }
+    }
+  }
+  if (reader.error)
+    error("Broken precompiled header");
+}
@@ -0,0 +1,16 @@
+// Precompiled header: global scope
+//
+// Declarations in a header are saved with the preprocessed output (see preprocessor.h),
+// and restored into the global scope instead of parsing the header again.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>  // size_t
+
+typedef struct DataStorage DataStorage;
+typedef struct Vector Vector;
+
+void begin_pch_scope(const Vector *decls);  // Remember the scope before the header: builtins.
+bool save_pch_scope(DataStorage *data, const Vector *decls);  // false if the header has definitions.
+void load_pch_scope(const void *buf, size_t size);
@@ -0,0 +1,30 @@
+// Binary token stream
+//
+// Preprocessed tokens written by `cpp -fbinary-tokens`, and read by cc1 without lexing.
+// The stream starts with `TOKEN_STREAM_MAGIC` followed by the size of `Flonum`,
+// and continues with records until the end. A record starts with a byte, which is either
+// `enum TokenKind` for a token or `enum TokenStreamRecord`. Numbers are in ULEB128.
+//
+//   TK_IDENT:     Index in the identifier table, followed by length and bytes if it is new.
+//   TK_INTLIT:    Value, flag, length and bytes of the spelling.
+//   TK_FLOATLIT:  Bytes of the value, kind, length and bytes of the spelling.
+//   TK_STR:       Length and bytes of the narrow string, including the terminator.
+//   TK_EMBED:     Length and bytes of the full path, followed by the size and the hash of the bytes.
+//   Others:       No payload.
+
+#pragma once
+
+#define TOKEN_STREAM_MAGIC      "\177XCCTOK"
+#define TOKEN_STREAM_MAGIC_LEN  (sizeof(TOKEN_STREAM_MAGIC) - 1)
+
+#ifndef __NO_FLONUM
+#define TOKEN_STREAM_FLONUM_SIZE  (sizeof(Flonum))
+#else
+#define TOKEN_STREAM_FLONUM_SIZE  (0)
+#endif
+
+enum TokenStreamRecord {
+  TSR_LINE = 0xf0,  // Line number of the following tokens.
+  TSR_FILE,         // Index in the file table, followed by length and bytes if it is new.
+  TSR_RAW,          // Length and bytes of source text, which is lexed as is.
+};
@@ -271,64 +271,320 @@ Type *get_fixnum_type_from_size(size_t size) {
   return NULL;
 }
 
-Type *ptrof(Type *type) {
-  Type *ptr = malloc_or_die(sizeof(*ptr));
-  ptr->kind = TY_PTR;
-  ptr->qualifier = 0;
-  ptr->pa.ptrof = type;
-  ptr->pa.length = 0;
+// Types are hash-consed: the same contents give the same object, unless the type is modified
+// per declaration later (array of unknown length, VLA, incomplete struct, function with
+// parameter names). Every type also refers to its interned canonical ones, so that
+// `same_type` is a pointer comparison.
+typedef struct {
+  Type *type;
+  uint32_t hash;
+} InternedType;
+
+static struct {
+  InternedType *entries;
+  int capacity;
+  int count;
+} interned;
+
+static void set_canonical_types(Type *type, bool is_interned);
+
+static bool is_internable(const Type *type) {
+  switch (type->kind) {
+  case TY_VOID: case TY_FIXNUM: case TY_FLONUM:
+    return true;
+  case TY_PTR:
 #ifndef __NO_VLA
-  ptr->pa.vla = NULL;
-  ptr->pa.size_var = NULL;
+    return type->pa.vla == NULL;
+#else
+    return true;
 #endif
-  return ptr;
+  case TY_ARRAY:
+    return type->pa.length >= 0;
+  case TY_FUNC:
+    return type->func.param_vars == NULL;
+  case TY_STRUCT:
+    return type->struct_.info != NULL;
+  case TY_AUTO:
+    break;
+  }
+  return false;
 }
 
-Type *arrayof(Type *type, ssize_t length) {
-  Type *arr = malloc_or_die(sizeof(*arr));
-  arr->kind = TY_ARRAY;
-  arr->qualifier = 0;
-  arr->pa.ptrof = type;
-  arr->pa.length = length;
+static uint32_t hash_type(const Type *type) {
+  uint64_t h = hash_uint64(((uint64_t)type->kind << 8) | type->qualifier);
+  switch (type->kind) {
+  case TY_VOID:
+    break;
+  case TY_FIXNUM:
+    h = hash_uint64(h ^ (((uint64_t)type->fixnum.kind << 1) | type->fixnum.is_unsigned));
+    h = hash_uint64(h ^ (uintptr_t)type->fixnum.enum_.ident);
+    break;
+  case TY_FLONUM:
+    h = hash_uint64(h ^ type->flonum.kind);
+    break;
+  case TY_ARRAY:
+    h = hash_uint64(h ^ type->pa.length);
+    // Fallthrough
+  case TY_PTR:
+    h = hash_uint64(h ^ (uintptr_t)type->pa.ptrof);
+    break;
+  case TY_FUNC:
+    h = hash_uint64(h ^ (uintptr_t)type->func.ret ^ type->func.vaargs);
+    if (type->func.params != NULL) {
+      const Vector *params = type->func.params;
+      h = hash_uint64(h ^ params->len);
+      for (int i = 0; i < params->len; ++i)
+        h = hash_uint64(h ^ (uintptr_t)params->data[i]);
+    }
+    break;
+  case TY_STRUCT:
+    h = hash_uint64(h ^ (uintptr_t)type->struct_.info);
+    break;
+  case TY_AUTO: assert(false); break;
+  }
+  return h;
+}
+
+static bool equal_type_contents(const Type *type1, const Type *type2) {
+  if (type1->kind != type2->kind || type1->qualifier != type2->qualifier)
+    return false;
+  switch (type1->kind) {
+  case TY_VOID:
+    return true;
+  case TY_FIXNUM:
+    return type1->fixnum.kind == type2->fixnum.kind &&
+        type1->fixnum.is_unsigned == type2->fixnum.is_unsigned &&
+        type1->fixnum.enum_.ident == type2->fixnum.enum_.ident;
+  case TY_FLONUM:
+    return type1->flonum.kind == type2->flonum.kind;
+  case TY_ARRAY:
+    if (type1->pa.length != type2->pa.length)
+      return false;
+    // Fallthrough
+  case TY_PTR:
+    return type1->pa.ptrof == type2->pa.ptrof;
+  case TY_FUNC:
+    {
+      const Vector *params1 = type1->func.params, *params2 = type2->func.params;
+      if (type1->func.ret != type2->func.ret || type1->func.vaargs != type2->func.vaargs)
+        return false;
+      if (params1 == NULL || params2 == NULL)
+        return params1 == params2;
+      if (params1->len != params2->len)
+        return false;
+      for (int i = 0; i < params1->len; ++i) {
+        if (params1->data[i] != params2->data[i])
+          return false;
+      }
+    }
+    return true;
+  case TY_STRUCT:
+    return type1->struct_.info == type2->struct_.info;
+  case TY_AUTO: assert(false); break;
+  }
+  return false;
+}
+
+static void insert_interned(Type *type, uint32_t hash) {
+  if (interned.count * 2 >= interned.capacity) {
+    int old_capacity = interned.capacity;
+    InternedType *old_entries = interned.entries;
+    interned.capacity = old_capacity > 0 ? old_capacity * 2 : 256;
+    interned.entries = calloc_or_die(sizeof(*interned.entries) * interned.capacity);
+    interned.count = 0;
+    for (int i = 0; i < old_capacity; ++i) {
+      if (old_entries[i].type != NULL)
+        insert_interned(old_entries[i].type, old_entries[i].hash);
+    }
+    free(old_entries);
+  }
+
+  int mask = interned.capacity - 1;
+  int i = hash & mask;
+  while (interned.entries[i].type != NULL)
+    i = (i + 1) & mask;
+  interned.entries[i].type = type;
+  interned.entries[i].hash = hash;
+  ++interned.count;
+}
+
+static void init_interned_types(void) {
+  static Type *kStaticTypes[] = {
+    &tyVoid, &tyConstVoid, &tyVoidPtr, &tyBool, &tyFloat, &tyDouble, &tyLDouble,
+  };
+  for (size_t i = 0; i < ARRAY_SIZE(kStaticTypes); ++i)
+    insert_interned(kStaticTypes[i], hash_type(kStaticTypes[i]));
+  Type *fixnums = &kFixnumTypeTable[0][0][0];
+  for (size_t i = 0; i < sizeof(kFixnumTypeTable) / sizeof(*fixnums); ++i)
+    insert_interned(&fixnums[i], hash_type(&fixnums[i]));
+
+  // Same contents as the table, so they are not interned but refer to the canonical ones.
+  static Type *kAliasTypes[] = {&tyChar, &tyInt, &tySize, &tySSize};
+  for (size_t i = 0; i < ARRAY_SIZE(kStaticTypes); ++i)
+    set_canonical_types(kStaticTypes[i], true);
+  for (size_t i = 0; i < sizeof(kFixnumTypeTable) / sizeof(*fixnums); ++i)
+    set_canonical_types(&fixnums[i], true);
+  for (size_t i = 0; i < ARRAY_SIZE(kAliasTypes); ++i)
+    update_canonical_type(kAliasTypes[i]);
+}
+
+// Return the interned type with the same contents as `key`, which must be internable.
+static Type *intern_type(const Type *key) {
+  if (interned.capacity == 0)
+    init_interned_types();
+
+  uint32_t hash = hash_type(key);
+  int mask = interned.capacity - 1;
+  for (int i = hash & mask; interned.entries[i].type != NULL; i = (i + 1) & mask) {
+    InternedType *entry = &interned.entries[i];
+    if (entry->hash == hash && equal_type_contents(entry->type, key))
+      return entry->type;
+  }
+
+  Type *type = arena_alloc(&ast_arena, sizeof(*type));
+  *type = *key;
+  insert_interned(type, hash);
+  set_canonical_types(type, true);
+  return type;
+}
+
+// Canonical type of `type`, NULL if `same_type` on it cannot be a pointer comparison.
+static const Type *canonical_type(const Type *type, bool unqualified, bool is_interned) {
+  Type key = *type;
+  key.qualifier = unqualified ? 0 : type->qualifier & TQ_CONST;
+  Vector *params = NULL;
+  switch (type->kind) {
+  case TY_VOID: case TY_FLONUM:
+    break;
+  case TY_FIXNUM:
+    key.fixnum.enum_.ident = NULL;  // Enums are not distinguished.
+    break;
+  case TY_ARRAY:
+    if (type->pa.length < 0)
+      return NULL;  // Matches any length.
+    // Fallthrough
+  case TY_PTR:
+    key.pa.ptrof = (Type*)(unqualified ? type->pa.ptrof->unqualified : type->pa.ptrof->canonical);
+    if (key.pa.ptrof == NULL)
+      return NULL;
 #ifndef __NO_VLA
-  arr->pa.vla = NULL;
-  arr->pa.size_var = NULL;
+    key.pa.vla = NULL;
+    key.pa.size_var = NULL;
 #endif
-  return arr;
+    break;
+  case TY_FUNC:
+    // Return and parameter types are compared without qualifiers.
+    key.func.ret = (Type*)type->func.ret->unqualified;
+    if (key.func.ret == NULL)
+      return NULL;
+    key.func.param_vars = NULL;
+    if (type->func.params != NULL) {
+      const Vector *org = type->func.params;
+      for (int i = 0; i < org->len; ++i) {
+        const Type *t = org->data[i], *u = t->unqualified;
+        if (u == NULL) {
+          if (params != NULL)
+            free_vector(params);
+          return NULL;
+        }
+        if (params == NULL && u != t) {
+          params = new_vector();
+          for (int j = 0; j < i; ++j)
+            vec_push(params, org->data[j]);
+        }
+        if (params != NULL)
+          vec_push(params, u);
+      }
+      if (params != NULL)
+        key.func.params = params;
+    }
+    break;
+  case TY_STRUCT:
+    if (type->struct_.info == NULL)
+      return NULL;  // Compared by name.
+    break;
+  case TY_AUTO:
+    return NULL;
+  }
+
+  if (is_interned && params == NULL && equal_type_contents(&key, type))
+    return type;  // Already canonical.
+  const Type *canonical = intern_type(&key);
+  if (params != NULL && canonical->func.params != params)
+    free_vector(params);
+  return canonical;
+}
+
+static void set_canonical_types(Type *type, bool is_interned) {
+  type->canonical = type->unqualified = NULL;
+  type->canonical = canonical_type(type, false, is_interned);
+  type->unqualified = canonical_type(type, true, is_interned);
+}
+
+void update_canonical_type(Type *type) {
+  set_canonical_types(type, false);
+}
+
+// Fresh type, which is modified for each declaration.
+static Type *new_type(const Type *key) {
+  Type *type = arena_alloc(&ast_arena, sizeof(*type));
+  *type = *key;
+  update_canonical_type(type);
+  return type;
+}
+
+Type *ptrof(Type *type) {
+  Type key = {.kind = TY_PTR, .pa = {.ptrof = type}};
+  return intern_type(&key);
+}
+
+Type *arrayof(Type *type, ssize_t length) {
+  Type key = {.kind = TY_ARRAY, .pa = {.ptrof = type, .length = length}};
+  return is_internable(&key) ? intern_type(&key) : new_type(&key);
 }
 
 Type *array_to_ptr(Type *type) {
   assert(type->kind == TY_ARRAY);
-  Type *p = ptrof(type->pa.ptrof);
 #ifndef __NO_VLA
-  p->pa.vla = type->pa.vla;
-  p->pa.size_var = type->pa.size_var;
+  if (type->pa.vla != NULL) {
+    // Holds its own size, so not shared.
+    Type *p = clone_type(ptrof(type->pa.ptrof));
+    p->pa.vla = type->pa.vla;
+    p->pa.size_var = type->pa.size_var;
+    return p;
+  }
 #endif
-  return p;
+  return ptrof(type->pa.ptrof);
 }
 
 Type *new_func_type(Type *ret, const Vector *types, bool vaargs) {
-  Type *f = malloc_or_die(sizeof(*f));
-  f->kind = TY_FUNC;
-  f->qualifier = 0;
-  f->func.ret = ret;
-  f->func.vaargs = vaargs;
-  f->func.params = types;
-  f->func.param_vars = NULL;
-  return f;
+  Type key = {.kind = TY_FUNC, .func = {.ret = ret, .params = types, .vaargs = vaargs}};
+  return intern_type(&key);
+}
+
+static Type *requalified_type(Type *type, int qualifier) {
+  Type key = *type;
+  key.qualifier = qualifier;
+  if (is_internable(&key))
+    return intern_type(&key);
+  return new_type(&key);
 }
 
 Type *qualified_type(Type *type, int additional) {
   int modified = type->qualifier | additional;
   if (modified == type->qualifier)
     return type;
-  Type *ctype = clone_type(type);
-  ctype->qualifier = modified;
-  return ctype;
+  return requalified_type(type, modified);
+}
+
+Type *unqualified_type(Type *type) {
+  if (type->qualifier == 0)
+    return type;
+  return requalified_type(type, 0);
 }
 
 Type *clone_type(const Type *type) {
-  Type *cloned = malloc_or_die(sizeof(*cloned));
+  Type *cloned = arena_alloc(&ast_arena, sizeof(*cloned));
   *cloned = *type;
   return cloned;
 }
@@ -341,7 +597,7 @@ Type *get_callee_type(Type *type) {
 
 // Struct
 StructInfo *create_struct_info(MemberInfo *members, int count, bool is_union, bool is_flexible) {
-  StructInfo *sinfo = malloc_or_die(sizeof(*sinfo));
+  StructInfo *sinfo = arena_alloc(&ast_arena, sizeof(*sinfo));
   sinfo->members = members;
   sinfo->member_count = count;
   sinfo->is_union = is_union;
@@ -353,12 +609,9 @@ StructInfo *create_struct_info(MemberInfo *members, int count, bool is_union, bo
 }
 
 Type *create_struct_type(StructInfo *sinfo, const Name *name, int qualifier) {
-  Type *type = malloc_or_die(sizeof(*type));
-  type->kind = TY_STRUCT;
-  type->qualifier = qualifier;
-  type->struct_.name = name;
-  type->struct_.info = sinfo;
-  return type;
+  // Incomplete one is filled when the struct is defined.
+  Type key = {.kind = TY_STRUCT, .qualifier = qualifier, .struct_ = {.name = name, .info = sinfo}};
+  return is_internable(&key) ? intern_type(&key) : new_type(&key);
 }
 
 int find_struct_member(const StructInfo *sinfo, const Name *name) {
@@ -374,13 +627,9 @@ int find_struct_member(const StructInfo *sinfo, const Name *name) {
 // Enum
 
 Type *create_enum_type(const Name *name) {
-  Type *type = malloc_or_die(sizeof(*type));
-  type->kind = TY_FIXNUM;
-  type->qualifier = 0;
-  type->fixnum.kind = FX_ENUM;
-  type->fixnum.is_unsigned = false;
-  type->fixnum.enum_.ident = name;
-  return type;
+  Type key = {.kind = TY_FIXNUM, .fixnum = {.kind = FX_ENUM, .is_unsigned = false,
+                                            .enum_ = {.ident = name}}};
+  return intern_type(&key);
 }
 
 // Compare type for function parameter: Ignore const-ness.
@@ -391,6 +640,12 @@ static inline bool same_type_func_param(const Type *type1, const Type *type2) {
 bool same_type_without_qualifier(const Type *type1, const Type *type2, bool ignore_qualifier) {
   const int QMASK = TQ_CONST;
   for (;;) {
+    if (type1 == type2)
+      return true;
+    const Type *c1 = ignore_qualifier ? type1->unqualified : type1->canonical;
+    const Type *c2 = ignore_qualifier ? type2->unqualified : type2->canonical;
+    if (c1 != NULL && c2 != NULL)
+      return c1 == c2;
     if (type1->kind != type2->kind ||
         (!ignore_qualifier && (type1->qualifier & QMASK) != (type2->qualifier & QMASK)))
       return false;
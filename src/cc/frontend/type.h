@@ -82,6 +82,9 @@ typedef struct StructInfo {
 typedef struct Type {
   enum TypeKind kind;
   int qualifier;
+  // Interned types to compare by pointer, NULL if the type cannot be compared so.
+  const struct Type *canonical;  // Only `const` is kept from qualifiers.
+  const struct Type *unqualified;  // All qualifiers are dropped.
   union {
     struct {
       enum FixnumKind kind;
@@ -153,7 +156,9 @@ Type *arrayof(Type *type, ssize_t length);
 Type *array_to_ptr(Type *type);
 Type *new_func_type(Type *ret, const Vector *types, bool vaargs);
 Type *qualified_type(Type *type, int additional);
+Type *unqualified_type(Type *type);
 Type *clone_type(const Type *type);
+void update_canonical_type(Type *type);  // Call after modifying a type in place.
 Type *get_callee_type(Type *type);
 
 // Struct
@@ -22,12 +22,17 @@ int var_find(const Vector *vars, const Name *name) {
   return -1;
 }
 
-VarInfo *var_add(Vector *vars, const Token *token, Type *type, int storage) {
-  assert(token == NULL || var_find(vars, token->ident) < 0);
-  VarInfo *varinfo = calloc_or_die(sizeof(*varinfo));
+static VarInfo *alloc_varinfo(const Token *token, Type *type, int storage) {
+  VarInfo *varinfo = arena_calloc(&ast_arena, sizeof(*varinfo));
   varinfo->ident = token;
   varinfo->type = type;
   varinfo->storage = storage;
+  return varinfo;
+}
+
+VarInfo *var_add(Vector *vars, const Token *token, Type *type, int storage) {
+  assert(token == NULL || var_find(vars, token->ident) < 0);
+  VarInfo *varinfo = alloc_varinfo(token, type, storage);
   vec_push(vars, varinfo);
   return varinfo;
 }
@@ -35,18 +40,16 @@ VarInfo *var_add(Vector *vars, const Token *token, Type *type, int storage) {
 // Global
 
 Scope *global_scope;
-static Table global_var_table;
 
 void init_global(void) {
   global_scope = new_scope(NULL);
-  global_scope->vars = new_vector();
-  table_init(&global_var_table);
+  global_scope->var_table = alloc_table();
 }
 
 static VarInfo *define_global(const Token *token, Type *type, int storage) {
   assert(token != NULL);
   const Name *name = token->ident;
-  VarInfo *varinfo = table_get(&global_var_table, name);
+  VarInfo *varinfo = table_get(global_scope->var_table, name);
   if (varinfo != NULL) {
     if (!(varinfo->storage & VS_EXTERN)) {
       assert(storage & VS_EXTERN);
@@ -57,18 +60,21 @@ static VarInfo *define_global(const Token *token, Type *type, int storage) {
     varinfo->storage = storage;
     varinfo->global.init = NULL;
   } else {
-    // `static' is different meaning for global and local variable.
-    varinfo = var_add(global_scope->vars, token, type, storage & ~VS_STATIC);
-    varinfo->storage = storage;
-    table_put(&global_var_table, name, varinfo);
+    // Not `var_add`, which checks duplication linearly: `var_table` does it.
+    varinfo = alloc_varinfo(token, type, storage);
+    vec_push(global_scope->vars, varinfo);
+    table_put(global_scope->var_table, name, varinfo);
   }
   return varinfo;
 }
 
 // Scope
 
+// Block scopes are searched linearly until they have more variables than this.
+#define SCOPE_HASH_THRESHOLD  (16)
+
 Scope *new_scope(Scope *parent) {
-  Scope *scope = calloc_or_die(sizeof(*scope));
+  Scope *scope = arena_calloc(&ast_arena, sizeof(*scope));
   scope->parent = parent;
   scope->vars = new_vector();
   return scope;
@@ -79,31 +85,52 @@ bool is_global_scope(Scope *scope) {
   return scope->parent == NULL;
 }
 
+VarInfo *scope_find_var(Scope *scope, const Name *name) {
+  if (scope->var_table != NULL)
+    return table_get(scope->var_table, name);
+  const Vector *vars = scope->vars;
+  if (vars == NULL)
+    return NULL;
+  int idx = var_find(vars, name);
+  return idx >= 0 ? vars->data[idx] : NULL;
+}
+
 VarInfo *scope_find(Scope *scope, const Name *name, Scope **pscope) {
   VarInfo *varinfo = NULL;
   for (; scope != NULL; scope = scope->parent) {
-    if (is_global_scope(scope)) {
-      varinfo = table_get(&global_var_table, name);
+    varinfo = scope_find_var(scope, name);
+    if (varinfo != NULL)
       break;
-    }
-
-    int idx = var_find(scope->vars, name);
-    if (idx >= 0) {
-      varinfo = scope->vars->data[idx];
-      break;
-    }
   }
   if (pscope != NULL)
     *pscope = scope;
   return varinfo;
 }
 
+static void index_scope_vars(Scope *scope) {
+  Table *table = alloc_table();
+  // `vars` might be set directly, e.g. parameters: the first one wins like `var_find`.
+  for (int i = scope->vars->len; --i >= 0; ) {
+    VarInfo *varinfo = scope->vars->data[i];
+    if (varinfo->ident != NULL)
+      table_put(table, varinfo->ident->ident, varinfo);
+  }
+  scope->var_table = table;
+}
+
 VarInfo *scope_add(Scope *scope, const Token *name, Type *type, int storage) {
   assert(name != NULL);
   if (is_global_scope(scope))
     return define_global(name, type, storage);
 
-  VarInfo *varinfo = var_add(scope->vars, name, type, storage);
+  assert(scope_find_var(scope, name->ident) == NULL);
+  VarInfo *varinfo = alloc_varinfo(name, type, storage);
+  vec_push(scope->vars, varinfo);
+  if (scope->var_table != NULL)
+    table_put(scope->var_table, name->ident, varinfo);
+  else if (scope->vars->len > SCOPE_HASH_THRESHOLD)
+    index_scope_vars(scope);
+
   if (storage & VS_STATIC) {
     // Add corresponding static variable.
     assert(static_vars != NULL);
@@ -142,7 +169,7 @@ Type *find_typedef(Scope *scope, const Name *name, Scope **pscope) {
     }
 
     // Shadowed by variable?
-    if (var_find(scope->vars, name) >= 0)
+    if (scope_find_var(scope, name) != NULL)
       break;
   }
   return NULL;
@@ -30,6 +30,7 @@ enum {
   VS_PARAM = 1 << 8,  // Function parameter
   VS_USED = 1 << 9,  // used.
   VS_STRING = 1 << 10,  // string.
+  VS_CALLED = 1 << 11,  // Called without inlining.
 };
 
 typedef struct VarInfo {
@@ -74,7 +75,8 @@ static inline bool is_local_storage(const VarInfo *varinfo)  { return !(varinfo-
 
 typedef struct Scope {
   struct Scope *parent;
-  Vector *vars;  // <VarInfo*>
+  Vector *vars;  // <VarInfo*>, in declaration order.
+  Table *var_table;  // <VarInfo*>, index of `vars`: always for global, and when grown for block.
   Table *struct_table;  // <StructInfo*>
   Table *typedef_table;  // <Type*>
   Table *enum_table;  // <Type*>
@@ -86,6 +88,7 @@ extern Vector *static_vars;  // <VarInfo*>
 Scope *new_scope(Scope *parent);
 bool is_global_scope(Scope *scope);
 VarInfo *scope_find(Scope *scope, const Name *name, Scope **pscope);
+VarInfo *scope_find_var(Scope *scope, const Name *name);  // Only in `scope`, not in parents.
 VarInfo *scope_add(Scope *scope, const Token *name, Type *type, int storage);
 
 StructInfo *find_struct(Scope *scope, const Name *name, Scope **pscope);
@@ -1,9 +1,11 @@
 #include "../config.h"
 
 #include <assert.h>
+#include <libgen.h>  // basename
 #include <string.h>
 
 #include "preprocessor.h"
+#include "report.h"
 #include "util.h"
 
 static void usage(FILE *fp) {
@@ -16,6 +18,15 @@ static void usage(FILE *fp) {
       "  -isystem <path>     Add system include path\n"
       "  -idirafter <path>   Add include path (lower priority)\n"
       "  -C                  Preserve comments\n"
+      "  -x c-header         Precompile a header into <file>.pch\n"
+      "  -MD                 Write dependencies into <file>.d\n"
+      "  -MMD                Same as -MD, except system headers\n"
+      "  -MF <file>          Set dependency filename\n"
+      "  -MT <target>        Set target of dependency (Default: <file>.o)\n"
+      "  -MP                 Add phony target for each header\n"
+      "  -fbinary-tokens     Output binary tokens for cc1\n"
+      "  -ftime-report       Report time of each phase\n"
+      "  -fmem-report        Report peak memory of each phase\n"
   );
 }
 
@@ -28,6 +39,11 @@ int main(int argc, char *argv[]) {
     OPT_VERSION,
     OPT_ISYSTEM,
     OPT_IDIRAFTER,
+    OPT_MD,
+    OPT_MMD,
+    OPT_MF,
+    OPT_MT,
+    OPT_MP,
   };
 
   static const struct option options[] = {
@@ -37,11 +53,25 @@ int main(int argc, char *argv[]) {
     {"D", required_argument},  // Define macro
     {"U", required_argument},  // Undefine macro
     {"C", no_argument},  // Do not discard comments
+    {"x", required_argument},  // Specify code type
+    {"MD", no_argument, OPT_MD},  // Output dependency file
+    {"MMD", no_argument, OPT_MMD},  // Output dependency file, except system headers
+    {"MF", required_argument, OPT_MF},  // Dependency filename
+    {"MT", required_argument, OPT_MT},  // Target of dependency
+    {"MP", no_argument, OPT_MP},  // Phony target for each header
+    {"f", optional_argument},
     {"-help", no_argument, OPT_HELP},
     {"v", no_argument, OPT_VERSION},
     {"-version", no_argument, OPT_VERSION},
     {0},
   };
+  bool precompile = false;
+  bool binary_tokens = false;
+  int depend = 0;  // OPT_MD or OPT_MMD
+  const char *dep_fn = NULL;
+  Vector dep_targets;
+  vec_init(&dep_targets);
+  bool dep_phony = false;
   int opt;
   while ((opt = optparse(argc, argv, options)) != -1) {
     switch (opt) {
@@ -70,14 +100,70 @@ int main(int argc, char *argv[]) {
     case 'C':
       set_preserve_comment(true);
       break;
+    case 'x':
+      if (strcmp(optarg, "c-header") == 0)
+        precompile = true;
+      else if (strcmp(optarg, "c") != 0)
+        error("language not recognized: %s", optarg);
+      break;
+    case OPT_MD:
+    case OPT_MMD:
+      depend = opt;
+      break;
+    case OPT_MF:
+      dep_fn = optarg;
+      break;
+    case OPT_MT:
+      vec_push(&dep_targets, optarg);
+      break;
+    case OPT_MP:
+      dep_phony = true;
+      break;
+    case 'f':
+      if (optarg != NULL && strcmp(optarg, "binary-tokens") == 0)
+        binary_tokens = true;
+      else if (optarg == NULL || !parse_report_option(optarg))
+        fprintf(stderr, "Warning: unknown option: %s\n", argv[optind - 1]);
+      break;
     case '?':
       fprintf(stderr, "Warning: unknown option: %s\n", argv[optind - 1]);
       break;
     }
   }
 
+  if (!precompile)
+    set_binary_tokens(binary_tokens);
+  if (depend != 0)
+    record_dependencies(depend == OPT_MD);
+
+  int phase = enter_report_phase("preprocess");
   int iarg = optind;
-  if (iarg < argc) {
+  char *pchfn = NULL;
+  if (precompile) {
+    // Without cc1, only the preprocessed output is saved.
+    if (argc - iarg != 1 || binary_tokens)
+      error("-x c-header requires one header, without -fbinary-tokens");
+    const char *filename = argv[iarg];
+    FILE *fp;
+    if (!is_file(filename) || (fp = fopen(filename, "r")) == NULL)
+      error("Cannot open file: %s\n", filename);
+    char *buf = NULL;
+    size_t size = 0;
+    FILE *memfp = open_memstream(&buf, &size);
+    if (memfp == NULL)
+      error("open_memstream failed");
+    set_preprocess_output(memfp);
+    record_pch_dependencies();
+    preprocess(fp, filename);
+    fclose(fp);
+    fclose(memfp);
+
+    size_t len = strlen(filename) + sizeof(".pch");
+    pchfn = malloc_or_die(len);
+    snprintf(pchfn, len, "%s.pch", filename);
+    if (!write_pch(pchfn, buf, size, NULL))
+      error("Cannot write precompiled header: %s", pchfn);
+  } else if (iarg < argc) {
     for (int i = iarg; i < argc; ++i) {
       const char *filename = argv[i];
       FILE *fp;
@@ -89,5 +175,18 @@ int main(int argc, char *argv[]) {
   } else {
     preprocess(stdin, "*stdin*");
   }
+
+  if (depend != 0) {
+    // Named after the first source, like `gcc -c`.
+    const char *base = iarg < argc ? basename(strdup(argv[iarg])) : "-";
+    if (dep_fn == NULL)
+      dep_fn = change_ext(base, "d");
+    if (dep_targets.len == 0)
+      vec_push(&dep_targets, precompile ? pchfn : change_ext(base, "o"));
+    if (!write_dependencies(dep_fn, &dep_targets, dep_phony))
+      error("Cannot write dependency file: %s", dep_fn);
+  }
+  leave_report_phase(phase);
+  output_report("cpp");
   return 0;
 }
@@ -38,84 +38,169 @@ Macro *new_macro(Vector *params, const Name *vaargs_ident, Vector *body) {
 
 //
 
-typedef Table HideSet;
-
-static Vector hideset_array;
+// Hidesets are immutable and interned: each distinct set is stored once and referred by its id
+// from `Token::hideset`, where 0 is the empty set. Results of set operations are memoized,
+// because the same combinations occur repeatedly while expanding header-heavy code.
+
+typedef struct {
+  int len;
+  const Name *names[];  // Sorted by address.
+} HideSet;
+
+enum HideSetOp {
+  HS_ADD,
+  HS_UNION,
+  HS_INTERSECTION,
+};
+
+static Vector hidesets;  // <HideSet*>, indexed by id.
+static Table hideset_ids;  // <Name, id>: Key is the bytes of the sorted names.
+
+// Memo of set operations: open addressing on (op, lhs, rhs), where `rhs` is a name for HS_ADD.
+typedef struct {
+  intptr_t rhs;
+  int op;  // -1 for an empty slot.
+  int lhs;
+  int result;
+} HideSetMemo;
+
+static HideSetMemo *hideset_memo;
+static int memo_capacity, memo_count;  // Capacity is a power of 2.
+
+static int intern_hideset(const Name **names, int len) {
+  if (len == 0)
+    return 0;
+  const Name *key = alloc_name((const char*)names, (const char*)&names[len], true);
+  void *id;
+  if (table_try_get(&hideset_ids, key, &id))
+    return VOIDP2INT(id);
+
+  HideSet *hs = malloc_or_die(sizeof(*hs) + sizeof(*names) * len);
+  hs->len = len;
+  memcpy(hs->names, names, sizeof(*names) * len);
+  int new_id = hidesets.len;
+  vec_push(&hidesets, hs);
+  table_put(&hideset_ids, key, INT2VOIDP(new_id));
+  return new_id;
+}
 
-static int search_hideset(const Token *tok) {
-  int n = hideset_array.len >> 1;
-  int lo = -1, hi = n;
-  while (hi - lo > 1) {
+static bool hideset_contains(int id, const Name *name) {
+  const HideSet *hs = hidesets.data[id];
+  int lo = 0, hi = hs->len;
+  while (lo < hi) {
     int m = lo + ((hi - lo) >> 1);
-    const Token *t = hideset_array.data[m << 1];
-    if (t < tok)
-      lo = m;
+    const Name *n = hs->names[m];
+    if (n == name)
+      return true;
+    if (n < name)
+      lo = m + 1;
     else
       hi = m;
   }
-  return hi << 1;
+  return false;
 }
 
-static HideSet *get_hideset(const Token *tok) {
-  int i = search_hideset(tok);
-  assert(i >= 0 && i <= hideset_array.len);
-  if (i < hideset_array.len) {
-    const Token *t = hideset_array.data[i];
-    if (t == tok)
-      return hideset_array.data[i + 1];
+static HideSetMemo *find_memo(HideSetMemo *memo, int capacity, enum HideSetOp op, int lhs,
+                              intptr_t rhs) {
+  uint32_t hash = hash_uint64((uint64_t)rhs ^ hash_uint64(((uint64_t)lhs << 2) | op));
+  for (uint32_t mask = capacity - 1, i = hash & mask; ; i = (i + 1) & mask) {
+    HideSetMemo *p = &memo[i];
+    if (p->op < 0 || (p->op == (int)op && p->lhs == lhs && p->rhs == rhs))
+      return p;
   }
-  return NULL;
 }
 
-static void set_token_hideset(const Token *tok, HideSet *hs) {
-  int i = search_hideset(tok);
-  assert(i >= 0 && i <= hideset_array.len);
-  if (i < hideset_array.len && ((Token*)hideset_array.data[i]) == tok) {
-    hideset_array.data[i + 1] = hs;
-  } else {
-    vec_insert(&hideset_array, i, tok);
-    vec_insert(&hideset_array, i + 1, hs);
+static void put_memo(HideSetMemo *p, enum HideSetOp op, int lhs, intptr_t rhs, int result) {
+  p->op = op;
+  p->lhs = lhs;
+  p->rhs = rhs;
+  p->result = result;
+  if (++memo_count * 2 < memo_capacity)
+    return;
+
+  // Grow, keeping the load factor under 1/2.
+  int new_capacity = memo_capacity * 2;
+  HideSetMemo *new_memo = malloc_or_die(sizeof(*new_memo) * new_capacity);
+  for (int i = 0; i < new_capacity; ++i)
+    new_memo[i].op = -1;
+  for (int i = 0; i < memo_capacity; ++i) {
+    HideSetMemo *q = &hideset_memo[i];
+    if (q->op >= 0)
+      *find_memo(new_memo, new_capacity, q->op, q->lhs, q->rhs) = *q;
   }
+  free(hideset_memo);
+  hideset_memo = new_memo;
+  memo_capacity = new_capacity;
 }
 
-static HideSet *clone_hideset(HideSet *hs) {
-  HideSet *cloned = alloc_table();
-  if (hs != NULL) {
-    const Name *name;
-    void *value;
-    for (int it = 0; (it = table_iterate(hs, it, &name, &value)) != -1; )
-      table_put(cloned, name, value);
+// Merge two sorted sets: keep names in either set for union, or in both for intersection.
+static int merge_hideset(enum HideSetOp op, const Name *const *names1, int len1,
+                         const Name *const *names2, int len2) {
+  const Name **buf = alloca(sizeof(*buf) * (len1 + len2 + 1));
+  int n = 0;
+  int i = 0, j = 0;
+  while (i < len1 && j < len2) {
+    const Name *a = names1[i], *b = names2[j];
+    if (a == b) {
+      buf[n++] = a;
+      ++i, ++j;
+    } else if (a < b) {
+      if (op == HS_UNION)
+        buf[n++] = a;
+      ++i;
+    } else {
+      if (op == HS_UNION)
+        buf[n++] = b;
+      ++j;
+    }
+  }
+  if (op == HS_UNION) {
+    while (i < len1)
+      buf[n++] = names1[i++];
+    while (j < len2)
+      buf[n++] = names2[j++];
   }
-  return cloned;
+  return intern_hideset(buf, n);
 }
 
-static inline void hideset_put(HideSet *hs, const Name *token) {
-  assert(hs != NULL);
-  table_put(hs, token, (void*)token);
-}
+static int hideset_op(enum HideSetOp op, int id1, int id2) {
+  if (id1 == id2)
+    return id1;
+  if (id1 == 0 || id2 == 0)
+    return op == HS_UNION ? id1 + id2 : 0;
 
-static void union_hideset(HideSet *hs, HideSet *hs2) {
-  assert(hs != NULL);
-  if (hs2 != NULL) {
-    const Name *name;
-    void *value;
-    for (int it = 0; (it = table_iterate(hs2, it, &name, &value)) != -1; )
-      table_put(hs, name, value);
+  if (op == HS_UNION && id1 > id2) {  // Commutative: normalize the key.
+    int t = id1;
+    id1 = id2;
+    id2 = t;
   }
+  HideSetMemo *memo = find_memo(hideset_memo, memo_capacity, op, id1, id2);
+  if (memo->op >= 0)
+    return memo->result;
+
+  const HideSet *hs1 = hidesets.data[id1], *hs2 = hidesets.data[id2];
+  int id = merge_hideset(op, hs1->names, hs1->len, hs2->names, hs2->len);
+  put_memo(memo, op, id1, id2, id);
+  return id;
 }
 
-static void intersection_hideset(HideSet *hs, HideSet *hs2) {
-  assert(hs != NULL);
-  if (hs2 == NULL) {
-    table_init(hs);
-  } else {
-    const Name *name;
-    void *value;
-    for (int it = 0; (it = table_iterate(hs, it, &name, &value)) != -1; ) {
-      if (!table_try_get(hs2, name, NULL))
-        table_delete(hs, name);
-    }
-  }
+static inline int union_hideset(int id1, int id2) {
+  return hideset_op(HS_UNION, id1, id2);
+}
+
+static inline int intersection_hideset(int id1, int id2) {
+  return hideset_op(HS_INTERSECTION, id1, id2);
+}
+
+static int hideset_put(int id, const Name *name) {
+  HideSetMemo *memo = find_memo(hideset_memo, memo_capacity, HS_ADD, id, (intptr_t)name);
+  if (memo->op >= 0)
+    return memo->result;
+
+  const HideSet *hs = hidesets.data[id];
+  int new_id = merge_hideset(HS_UNION, hs->names, hs->len, &name, 1);
+  put_memo(memo, HS_ADD, id, (intptr_t)name, new_id);
+  return new_id;
 }
 
 static void glue1(Vector *ls, const Token *tok2) {
@@ -172,22 +257,15 @@ static Token *stringize(const Vector *arg) {
   return tok;
 }
 
-static void hsadd(HideSet *hs, Vector *ts) {
+static void hsadd(int hs, Vector *ts) {
   for (int i = 0; i < ts->len; ++i) {
-    const Token *tok = ts->data[i];
-    if (tok->kind == TK_IDENT || tok->kind == TK_RPAR) {
-      HideSet *h = get_hideset(tok);
-      if (h == NULL) {
-        h = clone_hideset(hs);
-        set_token_hideset(tok, h);
-      } else {
-        union_hideset(h, hs);
-      }
-    }
+    Token *tok = ts->data[i];
+    if (tok->kind == TK_IDENT || tok->kind == TK_RPAR)
+      tok->hideset = union_hideset(tok->hideset, hs);
   }
 }
 
-static Vector *subst(Macro *macro, Table *param_table, Vector *args, HideSet *hs) {
+static Vector *subst(Macro *macro, Table *param_table, Vector *args, int hs) {
   Vector *os = new_vector();
   Vector *body = macro->body;
   if (body == NULL)
@@ -341,7 +419,16 @@ static Table macro_table;  // <Name, Macro*>
 
 void macro_init(void) {
   table_init(&macro_table);
-  vec_init(&hideset_array);
+  vec_init(&hidesets);
+  table_init(&hideset_ids);
+  free(hideset_memo);
+  memo_capacity = 64;
+  memo_count = 0;
+  hideset_memo = malloc_or_die(sizeof(*hideset_memo) * memo_capacity);
+  for (int i = 0; i < memo_capacity; ++i)
+    hideset_memo[i].op = -1;
+  static const HideSet empty = {.len = 0};
+  vec_push(&hidesets, &empty);
 }
 
 void macro_add(const Name *name, Macro *macro) {
@@ -356,27 +443,41 @@ void macro_delete(const Name *name) {
   table_delete(&macro_table, name);
 }
 
+int macro_iterate(int iterator, const Name **pname, Macro **pmacro) {
+  void *value;
+  int it = table_iterate(&macro_table, iterator, pname, &value);
+  if (it != -1)
+    *pmacro = value;
+  return it;
+}
+
+// Expand macros in `tokens` in place.
+// Input is consumed from a stack in reverse order and a replacement is pushed back onto it for
+// rescanning, so expansion takes time proportional to the output size.
 void macro_expand(Vector *tokens) {
-  for (int i = 0; i < tokens->len; ++i) {
-    const Token *tok = tokens->data[i];
-    if (tok->kind != TK_IDENT)
-      continue;
-    Macro *macro = macro_get(tok->ident);
-    if (macro == NULL)
-      continue;
-    HideSet *hs = get_hideset(tok);
-    if (hs != NULL && table_try_get(hs, tok->ident, NULL))
+  Vector pending;
+  vec_init(&pending);
+  for (int i = tokens->len; --i >= 0; )
+    vec_push(&pending, tokens->data[i]);
+  vec_clear(tokens);
+
+  while (pending.len > 0) {
+    Token *tok = vec_pop(&pending);
+    Macro *macro;
+    if (tok->kind != TK_IDENT || (macro = macro_get(tok->ident)) == NULL ||
+        hideset_contains(tok->hideset, tok->ident)) {
+      vec_push(tokens, tok);
       continue;
+    }
 
-    int next = i + 1;
     const Vector *replaced = NULL;
     if (macro->params_len < 0) {  // "()-less macro"
-      hs = clone_hideset(hs);
-      hideset_put(hs, tok->ident);
+      int hs = hideset_put(tok->hideset, tok->ident);
       replaced = subst(macro, NULL, NULL, hs);
     } else {  // "()'d macro"
-      Vector *args = pp_funargs(tokens, &next,
-                                macro->vaargs_ident != NULL ? macro->params_len : INT_MAX);
+      const Token *rpar;
+      Vector *args = pp_funargs(&pending,
+                                macro->vaargs_ident != NULL ? macro->params_len : INT_MAX, &rpar);
       if (args != NULL) {
         // Accept no argument for single parameter macro.
         if (args->len == 0 && macro->vaargs_ident == NULL && macro->params_len == 1)
@@ -388,21 +489,17 @@ void macro_expand(Vector *tokens) {
           pp_parse_error(tok, "Too %s arguments for macro `%.*s'", cmp, NAMES(tok->ident));
         }
 
-        assert(next > 0);
-        HideSet *hs2 = get_hideset(tokens->data[next - 1]);
-        hs = clone_hideset(hs);
-        intersection_hideset(hs, hs2);
-        hideset_put(hs, tok->ident);
+        int hs = hideset_put(intersection_hideset(tok->hideset, rpar->hideset), tok->ident);
         replaced = subst(macro, macro->param_table, args, hs);
       }
     }
 
     if (replaced != NULL) {
-      for (int n = next - i; n > 0; --n)
-        vec_remove_at(tokens, i);
-      for (int j = 0; j < replaced->len; ++j)
-        vec_insert(tokens, i + j, replaced->data[j]);
-      --i;
+      for (int j = replaced->len; --j >= 0; )
+        vec_push(&pending, replaced->data[j]);
+    } else {
+      vec_push(tokens, tok);
     }
   }
+  free(pending.data);
 }
@@ -118,9 +118,8 @@ Token *pp_match(enum TokenKind kind) {
           break;
         }
 
-        char *line = NULL;
-        size_t capa = 0;
-        ssize_t len = getline_cont(&line, &capa, pp_stream->fp, &pp_stream->lineno);
+        char *line;
+        ssize_t len = source_getline_cont(pp_stream->input, &line, &pp_stream->lineno);
         if (len == -1) {
           lex_error(comment_start, "Block comment not closed");
         }
@@ -166,31 +165,34 @@ static Token *match2(enum TokenKind kind) {
   return pp_match(kind);
 }
 
-static Token *match3(enum TokenKind kind, Vector *tokens, int *pindex) {
-  int index = *pindex;
+// Take the next token from `pending` (in reverse order), or from the source if it is empty.
+static Token *match3(enum TokenKind kind, Vector *pending) {
   Token *tok;
-  if (index < tokens->len) {
-    tok = tokens->data[index];
+  if (pending->len > 0) {
+    tok = pending->data[pending->len - 1];
     if ((int)kind == -1 || tok->kind == kind)
-      ++index;
+      --pending->len;
     else
       tok = NULL;
   } else {
     tok = match2(kind);
-    if (tok != NULL && tok->kind != TK_EOF) {
-      vec_push(tokens, tok);
-      ++index;
-    }
+    if (tok != NULL && tok->kind == TK_EOF)
+      tok = NULL;
   }
-  *pindex = index;
   return tok;
 }
 
-Vector *pp_funargs(Vector *tokens, int *pindex, int vaarg) {
+Vector *pp_funargs(Vector *pending, int vaarg, const Token **prpar) {
   Vector *args = NULL;
-  while (match3(PPTK_SPACE, tokens, pindex))
-    ;
-  if (match3(TK_LPAR, tokens, pindex)) {
+  int space_count = 0;  // Spaces taken from `pending`.
+  for (;;) {
+    bool from_pending = pending->len > 0;
+    if (match3(PPTK_SPACE, pending) == NULL)
+      break;
+    if (from_pending)
+      ++space_count;
+  }
+  if (match3(TK_LPAR, pending)) {
     args = new_vector();
     Vector *arg = NULL;
     int paren = 0;
@@ -198,8 +200,8 @@ Vector *pp_funargs(Vector *tokens, int *pindex, int vaarg) {
     const Token *tok_space = NULL;
     for (;;) {
       const char *start = get_lex_p();
-      bool fetched = *pindex >= tokens->len;
-      Token *tok = match3(-1, tokens, pindex);
+      bool fetched = pending->len <= 0;
+      Token *tok = match3(-1, pending);
       if (tok == NULL /*|| tok->kind == TK_EOF*/) {
         pp_parse_error(NULL, "`)' expected");
       }
@@ -207,8 +209,10 @@ Vector *pp_funargs(Vector *tokens, int *pindex, int vaarg) {
       if (tok->kind == TK_LPAR) {
         ++paren;
       } else if (tok->kind == TK_RPAR) {
-        if (paren <= 0)
+        if (paren <= 0) {
+          *prpar = tok;
           break;
+        }
         --paren;
       }
 
@@ -236,6 +240,9 @@ Vector *pp_funargs(Vector *tokens, int *pindex, int vaarg) {
 
     if (args->len == vaarg)
       vec_push(args, new_vector());
+  } else {
+    // Put back the spaces taken from `pending`.
+    pending->len += space_count;
   }
   return args;
 }
@@ -6,19 +6,21 @@
 #include "lexer.h"  // TokenKind, Token
 
 typedef struct Macro Macro;
+typedef struct SourceInput SourceInput;
 typedef struct Vector Vector;
 
 typedef int64_t PpResult;
 
 typedef struct {
   const char *filename;
-  FILE *fp;
+  SourceInput *input;
   int lineno;
 } Stream;
 
 Stream *set_pp_stream(Stream *stream);
 PpResult pp_expr(void);
-Vector *pp_funargs(Vector *tokens, int *pindex, int vaarg);  // <Vector*<Token*>>
+// Parse macro arguments from `pending` tokens in reverse order, followed by the source.
+Vector *pp_funargs(Vector *pending, int vaarg, const Token **prpar);  // <Vector*<Token*>>
 
 Token *pp_match(enum TokenKind kind);
 Token *pp_consume(enum TokenKind kind, const char *error);
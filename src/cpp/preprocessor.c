@@ -1,19 +1,23 @@
 #include "../config.h"
 #include "preprocessor.h"
 
+#include <alloca.h>
 #include <assert.h>
 #include <ctype.h>
+#include <inttypes.h>  // PRIx64
 #include <libgen.h>  // dirname
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "lexer.h"
 #include "macro.h"
 #include "pp_parser.h"
 #include "table.h"
+#include "token_stream.h"
 #include "util.h"
 
 #define CF_ENABLE         (1 << 0)
@@ -22,6 +26,9 @@
 
 static FILE *pp_ofp;
 static bool preserve_comment;
+static bool binary_tokens;  // -fbinary-tokens
+static bool pp_binary;  // Write tokens instead of text to `pp_ofp`.
+static bool pch_allowed;  // Nothing has been output nor defined in the source yet.
 
 // Is `#if` condition satisfied?
 enum Satisfy {
@@ -30,23 +37,37 @@ enum Satisfy {
   ElseAppeared,
 };
 
+// Multiple-include optimization: a file whose content is wrapped in `#ifndef X ... #endif`
+// is not opened again while `X` is defined.
+enum GuardState {
+  GS_START,   // Before the guard: only comments and blank lines appeared.
+  GS_INSIDE,
+  GS_CLOSED,  // After `#endif` of the guard.
+  GS_NONE,    // Not guarded.
+};
+
 typedef struct PreprocessFile {
   Vector *condstack;
   Token *tok_lineno;
   Stream stream;
   bool enable;
   enum Satisfy satisfy;
+  enum GuardState guard_state;
+  const Name *guard;
+  struct IncludeFile *file;
   int out_lineno;
   char linenobuf[sizeof(int) * 3 + 1];  // Buffer for __LINE__
 } PreprocessFile;
 
 static PreprocessFile *curpf;
 
-#define OUTPUT_PPLINE(...)  do { fprintf(pp_ofp, __VA_ARGS__); ++curpf->out_lineno; } while (0)
+#define OUTPUT_PPLINE(...)  do { if (!pp_binary) fprintf(pp_ofp, __VA_ARGS__); ++curpf->out_lineno; } while (0)
 #define OUTPUT_COMMENT(...)  do { if (preserve_comment) OUTPUT_PPLINE(__VA_ARGS__); } while (0)
 
 static char *cat_path_cwd(const char *dir, const char *path) {
-  char *cwd = getcwd(NULL, 0);
+  static char *cwd;
+  if (cwd == NULL)
+    cwd = getcwd(NULL, 0);
   return JOIN_PATHS(cwd, dir, path);
 }
 
@@ -93,6 +114,171 @@ static const char *find_directive(const char *line) {
   return hash ? p : NULL;
 }
 
+// Binary token stream, see token_stream.h.
+
+typedef struct {
+  Table idents;  // <Name, index>
+  Table files;  // <Name, index>
+  const Stream *stream;  // Line being processed: its tokens are put at the beginning, like text.
+  int stream_lineno;
+  const char *filename;  // Last written location.
+  int file_index;
+  int lineno;
+  Vector strings;  // <Token*>: Adjacent string literals, written at once to be concatenated.
+} TokenWriter;
+
+static TokenWriter token_writer;
+
+static void write_uleb(uint64_t x) {
+  do {
+    unsigned char c = x & 0x7f;
+    x >>= 7;
+    fputc(c | (x != 0 ? 0x80 : 0), pp_ofp);
+  } while (x != 0);
+}
+
+static void write_bytes(const void *p, size_t len) {
+  write_uleb(len);
+  fwrite(p, len, 1, pp_ofp);
+}
+
+// Write index in `table`, and the name itself when it is new.
+static void write_table_index(Table *table, const Name *name) {
+  void *index;
+  if (table_try_get(table, name, &index)) {
+    write_uleb(VOIDP2INT(index));
+  } else {
+    int new_index = table->count;
+    table_put(table, name, INT2VOIDP(new_index));
+    write_uleb(new_index);
+    write_bytes(name->chars, name->bytes);
+  }
+}
+
+static void write_location(void) {
+  TokenWriter *tw = &token_writer;
+  const Stream *stream = tw->stream;
+  if (stream->filename != tw->filename) {
+    tw->filename = stream->filename;
+    const Name *name = alloc_name(stream->filename, NULL, true);
+    void *index;
+    int file_index = table_try_get(&tw->files, name, &index) ? VOIDP2INT(index) : tw->files.count;
+    if (file_index != tw->file_index) {
+      fputc(TSR_FILE, pp_ofp);
+      write_table_index(&tw->files, name);
+      tw->file_index = file_index;
+      tw->lineno = -1;
+    }
+  }
+  if (tw->stream_lineno != tw->lineno) {
+    tw->lineno = tw->stream_lineno;
+    fputc(TSR_LINE, pp_ofp);
+    write_uleb(tw->lineno);
+  }
+}
+
+static void write_raw(const Token **tokens, int count) {
+  size_t len = 0;
+  for (int i = 0; i < count; ++i)
+    len += (tokens[i]->end - tokens[i]->begin) + 1;
+  fputc(TSR_RAW, pp_ofp);
+  write_uleb(len);
+  for (int i = 0; i < count; ++i) {
+    fwrite(tokens[i]->begin, tokens[i]->end - tokens[i]->begin, 1, pp_ofp);
+    fputc(' ', pp_ofp);
+  }
+}
+
+static void flush_strings(void) {
+  Vector *strings = &token_writer.strings;
+  if (strings->len <= 0)
+    return;
+
+  // Payload is reliable only for a narrow string from the source: others are lexed by cc1.
+  size_t len = 1;
+  for (int i = 0; i < strings->len; ++i) {
+    const Token *tok = strings->data[i];
+    if (tok->line == NULL || tok->str.kind != STR_CHAR) {
+      len = 0;
+      break;
+    }
+    len += tok->str.len - 1;
+  }
+  if (len > 0) {
+    fputc(TK_STR, pp_ofp);
+    write_uleb(len);
+    for (int i = 0; i < strings->len; ++i) {
+      const Token *tok = strings->data[i];
+      fwrite(tok->str.buf, tok->str.len - 1, 1, pp_ofp);
+    }
+    fputc('\0', pp_ofp);
+  } else {
+    write_raw((const Token**)strings->data, strings->len);
+  }
+  vec_clear(strings);
+}
+
+static void write_token(const Token *tok) {
+  if (tok == NULL || tok->kind == PPTK_SPACE)
+    return;
+  if (tok->kind == TK_STR) {
+    if (token_writer.strings.len == 0)
+      write_location();
+    vec_push(&token_writer.strings, tok);
+    return;
+  }
+  flush_strings();
+  write_location();
+
+  switch (tok->kind) {
+  case TK_IDENT:
+    // Concatenated one by `##` might not be an identifier.
+    if (tok->line == NULL && read_ident(tok->begin) != tok->end)
+      break;
+    fputc(TK_IDENT, pp_ofp);
+    write_table_index(&token_writer.idents, tok->ident);
+    return;
+  case TK_INTLIT:
+    fputc(TK_INTLIT, pp_ofp);
+    write_uleb(tok->fixnum.value);
+    write_uleb(tok->fixnum.flag);
+    write_bytes(tok->begin, tok->end - tok->begin);
+    return;
+#ifndef __NO_FLONUM
+  case TK_FLOATLIT:
+    fputc(TK_FLOATLIT, pp_ofp);
+    fwrite(&tok->flonum.value, sizeof(tok->flonum.value), 1, pp_ofp);
+    write_uleb(tok->flonum.kind);
+    write_bytes(tok->begin, tok->end - tok->begin);
+    return;
+#endif
+  default:
+    if (tok->kind > TK_EOF && tok->kind < PPTK_CONCAT) {
+      fputc(tok->kind, pp_ofp);
+      return;
+    }
+    break;
+  }
+  write_raw(&tok, 1);
+}
+
+static void write_embed(const char *path, size_t size, uint64_t hash) {
+  flush_strings();
+  write_location();
+  fputc(TK_EMBED, pp_ofp);
+  write_bytes(path, strlen(path));
+  write_uleb(size);
+  write_uleb(hash);
+}
+
+void set_binary_tokens(bool enable) {
+  if (enable && !binary_tokens) {
+    fwrite(TOKEN_STREAM_MAGIC, TOKEN_STREAM_MAGIC_LEN, 1, pp_ofp);
+    fputc(TOKEN_STREAM_FLONUM_SIZE, pp_ofp);
+  }
+  binary_tokens = pp_binary = enable;
+}
+
 static bool handle_block_comment(const char **pp, Stream *stream) {
   const char *p = *pp;
   const char *begin = p;
@@ -115,7 +301,7 @@ static bool handle_block_comment(const char **pp, Stream *stream) {
   for (;;) {
     const char *q = block_comment_end(p);
     if (q != NULL) {
-      if (preserve_comment)
+      if (preserve_comment && !pp_binary)
         fwrite(begin, q - begin, 1, pp_ofp);
       *pp = q;
       break;
@@ -123,9 +309,8 @@ static bool handle_block_comment(const char **pp, Stream *stream) {
 
     OUTPUT_COMMENT("%s\n", begin);
 
-    char *line = NULL;
-    size_t capa = 0;
-    ssize_t len = getline_cont(&line, &capa, stream->fp, &stream->lineno);
+    char *line;
+    ssize_t len = source_getline_cont(stream->input, &line, &stream->lineno);
     if (len == -1) {
       lex_error(comment_start, "Block comment not closed");
     }
@@ -136,6 +321,8 @@ static bool handle_block_comment(const char **pp, Stream *stream) {
 
 static void process_line(const char *line, Stream *stream) {
   set_source_string(line, stream->filename, stream->lineno);
+  token_writer.stream = stream;
+  token_writer.stream_lineno = stream->lineno;
 
   const char *begin = get_lex_p();
 
@@ -163,15 +350,25 @@ static void process_line(const char *line, Stream *stream) {
 
     if (match(TK_EOF))
       break;
+    pch_allowed = false;
+
+    if (curpf->guard_state != GS_INSIDE)
+      curpf->guard_state = GS_NONE;
 
     Token *ident = match(TK_IDENT);
     Macro *macro;
     if (ident != NULL) {
       if (equal_name(ident->ident, defined)) {
         // TODO: Raise error if not matched.
-        match(TK_LPAR);
-        match(TK_IDENT);
-        match(TK_RPAR);
+        Token *lpar = match(TK_LPAR);
+        Token *name = match(TK_IDENT);
+        Token *rpar = match(TK_RPAR);
+        if (pp_binary) {
+          write_token(ident);
+          write_token(lpar);
+          write_token(name);
+          write_token(rpar);
+        }
       } else if ((macro = can_expand_ident(ident->ident)) != NULL) {
         const char *p = begin;
         begin = ident->end;  // Update for EOF callback.
@@ -180,6 +377,13 @@ static void process_line(const char *line, Stream *stream) {
         vec_push(tokens, ident);
         macro_expand(tokens);
 
+        if (pp_binary) {
+          for (int i = 0; i < tokens->len; ++i)
+            write_token(tokens->data[i]);
+          begin = get_lex_p();
+          continue;
+        }
+
         if (ident->begin != p)
           fwrite(p, ident->begin - p, 1, pp_ofp);
 
@@ -193,11 +397,15 @@ static void process_line(const char *line, Stream *stream) {
           fputc(' ', pp_ofp);
         }
         begin = get_lex_p();
+      } else if (pp_binary) {
+        write_token(ident);
       }
       continue;
     }
 
-    match(-1);
+    Token *tok = match(-1);
+    if (pp_binary)
+      write_token(tok);
   }
 
   if (begin != NULL)
@@ -212,11 +420,16 @@ static char *preprocess_one_line(const char *line, Stream *stream, size_t *psize
   if (memfp == NULL)
     error("open_memstream failed");
   FILE *bak_fp = pp_ofp;
+  bool bak_binary = pp_binary;
+  bool bak_pch_allowed = pch_allowed;
   int bak_lineno = curpf->out_lineno;
   pp_ofp = memfp;
+  pp_binary = false;
 
   process_line(line, stream);
   pp_ofp = bak_fp;
+  pp_binary = bak_binary;
+  pch_allowed = bak_pch_allowed;
   curpf->out_lineno = bak_lineno;
   fclose(memfp);
 
@@ -232,58 +445,553 @@ static char *preprocess_one_line(const char *line, Stream *stream, size_t *psize
 
 #define INC_ORDERS  (INC_AFTER + 1)
 
-static Vector sys_inc_paths[INC_ORDERS];  // <const char*>
-static Vector pragma_once_files;  // <const char*>
+// File to be included, identified by device and inode.
+typedef struct IncludeFile {
+  const Name *guard;  // Include guard macro, or NULL.
+  bool once;  // `#pragma once`
+  bool system;  // Found in a system include path, or next to a system header.
+  bool listed;  // Already in the dependency file.
+} IncludeFile;
+
+// Resolved path of `#include`.
+typedef struct {
+  char *path;
+  IncludeFile *file;
+} IncludeEntry;
+
+typedef struct {
+  const char *path;
+  char *full;  // Full path for `#include_next`, calculated on demand.
+  Table cache;  // <IncludeEntry*>, key: spelled path, NULL if not found.
+} IncludeDir;
+
+static Vector sys_inc_paths[INC_ORDERS];  // <IncludeDir*>
+static Table local_dirs;  // <Table*>: Resolve cache for the directory of including file.
+static Table include_files;  // <IncludeFile*>, key: "dev:inode".
 
 static const Name *key_file;
 static const Name *key_line;
 
-static bool registered_pragma_once(const char *filename) {
-  for (int i = 0, len = pragma_once_files.len; i < len; ++i) {
-    const char *fn = pragma_once_files.data[i];
-    if (strcmp(fn, filename) == 0)
-      return true;
+static IncludeFile *get_include_file(const struct stat *st) {
+  char buf[sizeof(unsigned long) * 4 + 2];
+  snprintf(buf, sizeof(buf), "%lx:%lx", (unsigned long)st->st_dev, (unsigned long)st->st_ino);
+  const Name *key = alloc_name(buf, NULL, true);
+  IncludeFile *file = table_get(&include_files, key);
+  if (file == NULL) {
+    file = calloc_or_die(sizeof(*file));
+    table_put(&include_files, key, file);
+  }
+  return file;
+}
+
+// Resolve `path` in `dir`, and cache the result including not found.
+static IncludeEntry *resolve_include(Table *cache, const char *dir, const char *path) {
+  const Name *key = alloc_name(path, NULL, true);
+  IncludeEntry *entry;
+  if (table_try_get(cache, key, (void**)&entry))
+    return entry;
+
+  entry = NULL;
+  char *fn = cat_path_cwd(dir, path);
+  struct stat st;
+  if (stat(fn, &st) == 0 && S_ISREG(st.st_mode)) {  // Include symbolic link, too.
+    entry = malloc_or_die(sizeof(*entry));
+    entry->path = fn;
+    entry->file = get_include_file(&st);
+  } else {
+    free(fn);
   }
-  return false;
+  table_put(cache, key, entry);
+  return entry;
 }
 
-static void register_pragma_once(const char *filename) {
-  if (!is_fullpath(filename))
-    filename = fullpath(filename);
-  vec_push(&pragma_once_files, filename);
+// Include is skipped if the file is `#pragma once`, or its guard macro is still defined.
+static bool skip_include(const IncludeFile *file) {
+  return file->once || (file->guard != NULL && macro_get(file->guard) != NULL);
 }
 
 // Search include file from system include paths.
-//   result!=NULL: Found (returns found path into *pfn)
-//   result==NULL, *pfn!=NULL: Found, but blocked because of pragma once.
-//   result==NULL, *pfn==NULL: Not found.
-static FILE *search_sysinc(const char *prevdir, const char *path, char **pfn) {
+static IncludeEntry *search_sysinc(const char *prevdir, const char *path, bool *psystem) {
   for (int ord = 0; ord < INC_ORDERS; ++ord) {
     Vector *v = &sys_inc_paths[ord];
     for (int idx = 0; idx < v->len; ++idx) {
+      IncludeDir *incdir = v->data[idx];
       if (prevdir != NULL) {  // Searching previous directory.
-        if (strcmp(fullpath(v->data[idx]), prevdir) == 0)
+        if (incdir->full == NULL)
+          incdir->full = fullpath(incdir->path);
+        if (strcmp(incdir->full, prevdir) == 0)
           prevdir = NULL;
         continue;
       }
 
-      FILE *fp = NULL;
-      char *fn = cat_path_cwd(v->data[idx], path);
-      if (registered_pragma_once(fn) ||  // If pragma once hit, then fp keeps NULL.
-          (is_file(fn) && (fp = fopen(fn, "r")) != NULL)) {
-        *pfn = fn;
-        return fp;
+      IncludeEntry *entry = resolve_include(&incdir->cache, incdir->path, path);
+      if (entry != NULL) {
+        *psystem = ord != INC_NORMAL;
+        return entry;
       }
     }
   }
-  *pfn = NULL;
   return NULL;
 }
 
-static void handle_include(const char *p, Stream *stream, bool is_next) {
+// Dependency file (-MD): A make rule from the target to the files read, written after all.
+
+typedef struct {
+  const char *path;
+  bool source;  // Given to `preprocess`, not included.
+} Dependency;
+
+static Vector *dependencies;  // <Dependency*>, NULL if not recorded.
+static bool depend_system_headers;
+
+static void add_dependency(const char *path, IncludeFile *file, bool source) {
+  if (dependencies == NULL || file->listed || (file->system && !depend_system_headers))
+    return;
+  file->listed = true;
+  Dependency *dep = malloc_or_die(sizeof(*dep));
+  dep->path = path;
+  dep->source = source;
+  vec_push(dependencies, dep);
+}
+
+// Escape for make: space, `#` and `$`.
+// Included files are resolved to full paths, so put them relative to the current directory.
+static int write_dependency_path(FILE *fp, const char *path, const char *cwd) {
+  size_t cwd_len = strlen(cwd);
+  if (strncmp(path, cwd, cwd_len) == 0 && path[cwd_len] == '/')
+    path += cwd_len + 1;
+  int len = 0;
+  for (const char *p = path; *p != '\0'; ++p) {
+    char c = *p;
+    if (c == ' ' || c == '#')
+      len += fputc('\\', fp) != EOF;
+    else if (c == '$')
+      len += fputc('$', fp) != EOF;
+    len += fputc(c, fp) != EOF;
+  }
+  return len;
+}
+
+void record_dependencies(bool system_headers) {
+  dependencies = new_vector();
+  depend_system_headers = system_headers;
+}
+
+bool write_dependencies(const char *fn, const Vector *targets, bool phony) {
+  assert(dependencies != NULL);
+  FILE *fp = fopen(fn, "w");
+  if (fp == NULL)
+    return false;
+
+  char *cwd = getcwd(NULL, 0);
+  if (cwd == NULL)
+    cwd = strdup("");
+  enum { MAX_COLUMN = 75 };
+  int column = 0;
+  for (int i = 0; i < targets->len; ++i)
+    column += fprintf(fp, i == 0 ? "%s" : " %s", (const char*)targets->data[i]);
+  fputc(':', fp);
+  ++column;
+  for (int i = 0; i < dependencies->len; ++i) {
+    const Dependency *dep = dependencies->data[i];
+    if (column + 1 + (int)strlen(dep->path) > MAX_COLUMN && column > 1) {
+      fputs(" \\\n", fp);
+      column = 0;
+    }
+    fputc(' ', fp);
+    column += 1 + write_dependency_path(fp, dep->path, cwd);
+  }
+  fputc('\n', fp);
+
+  // Phony targets for headers, not to fail after one is removed.
+  if (phony) {
+    for (int i = 0; i < dependencies->len; ++i) {
+      const Dependency *dep = dependencies->data[i];
+      if (!dep->source) {
+        fputc('\n', fp);
+        write_dependency_path(fp, dep->path, cwd);
+        fputs(":\n", fp);
+      }
+    }
+  }
+  free(cwd);
+  return fclose(fp) == 0;
+}
+
+// Precompiled header
+//
+// `cc1 -x c-header` writes the state after a header into `<header>.pch`, and the first
+// `#include` in a source reads it instead of the header, if nothing is output nor defined
+// before. The file is valid while the included files are not modified, and the initial macros,
+// include paths and target are the same.
+//
+//   Header:  Magic, version, key, size of the rest
+//   Files:   Count, {path, modified time, size, include guard, flags (`#pragma once`, system)}
+//   Macros:  Count, {name, params_len + 1, params, vaargs, body length + 1, {token}}
+//   Text:    Preprocessed output
+//   Scope:   Global scope of cc1, empty if the header has definitions
+//
+// Numbers are in LEB128. Strings have the terminator, so they are used in place on the mapped
+// file. A token in a macro body is its spelling, or zero length for a space.
+
+#define PCH_MAGIC      "\177XCCPCH"
+#define PCH_MAGIC_LEN  (sizeof(PCH_MAGIC) - 1)
+#define PCH_VERSION    (2)
+
+typedef struct {
+  char *path;
+  IncludeFile *file;
+  int64_t mtime;
+  int64_t size;
+} PchDependency;
+
+static Vector *pch_deps;  // <PchDependency*>: Files read while precompiling a header.
+static uint64_t pch_key;  // Hash of the initial state.
+static bool pch_scope_accepted;
+static const void *pch_scope;
+static size_t pch_scope_size;
+
+static uint64_t hash_name(uint64_t hash, const Name *name) {
+  if (name != NULL)
+    hash = hash_bytes(hash, name->chars, name->bytes);
+  return hash_bytes(hash, "", 1);  // Separator.
+}
+
+static bool is_location_macro(const Name *name) {
+  return equal_name(name, key_file) || equal_name(name, key_line);
+}
+
+// Parameters in order, without variadic one.
+static void get_macro_params(const Macro *macro, const Name **params) {
+  const Name *name;
+  void *value;
+  for (int it = 0; (it = table_iterate(macro->param_table, it, &name, &value)) != -1; ) {
+    int index = VOIDP2INT(value);
+    if (index < macro->params_len)
+      params[index] = name;
+  }
+}
+
+static uint64_t hash_macro(const Name *name, const Macro *macro) {
+  uint64_t hash = hash_name(HASH_OFFSET_BASIS, name);
+  hash = hash_bytes(hash, &macro->params_len, sizeof(macro->params_len));
+  if (macro->params_len > 0) {
+    const Name **params = alloca(sizeof(*params) * macro->params_len);
+    get_macro_params(macro, params);
+    for (int i = 0; i < macro->params_len; ++i)
+      hash = hash_name(hash, params[i]);
+  }
+  hash = hash_name(hash, macro->vaargs_ident);
+  if (macro->body != NULL) {
+    for (int i = 0; i < macro->body->len; ++i) {
+      const Token *tok = macro->body->data[i];
+      if (tok->kind != PPTK_SPACE)
+        hash = hash_bytes(hash, tok->begin, tok->end - tok->begin);
+      hash = hash_bytes(hash, "", 1);
+    }
+  }
+  return hash;
+}
+
+// Initial state which affects the result of a header.
+static uint64_t calc_pch_key(void) {
+  static const int target[] = {PCH_VERSION, XCC_TARGET_ARCH, TARGET_POINTER_SIZE};
+  uint64_t key = hash_bytes(HASH_OFFSET_BASIS, target, sizeof(target));
+  key = hash_bytes(key, &preserve_comment, sizeof(preserve_comment));
+  for (int ord = 0; ord < INC_ORDERS; ++ord) {
+    Vector *v = &sys_inc_paths[ord];
+    for (int idx = 0; idx < v->len; ++idx) {
+      IncludeDir *incdir = v->data[idx];
+      key = hash_bytes(key, incdir->path, strlen(incdir->path) + 1);
+    }
+    key = hash_bytes(key, "", 1);
+  }
+
+  // Sum up to be independent of the order in the macro table.
+  uint64_t sum = 0;
+  const Name *name;
+  Macro *macro;
+  for (int it = 0; (it = macro_iterate(it, &name, &macro)) != -1; ) {
+    if (!is_location_macro(name))
+      sum += hash_macro(name, macro);
+  }
+  return hash_bytes(key, &sum, sizeof(sum));
+}
+
+static void add_pch_dependency(FILE *fp, const char *filename, IncludeFile *file) {
+  struct stat st;
+  if (file == NULL || fstat(fileno(fp), &st) != 0)
+    return;
+  for (int i = 0; i < pch_deps->len; ++i) {
+    const PchDependency *dep = pch_deps->data[i];
+    if (dep->file == file)
+      return;
+  }
+
+  PchDependency *dep = malloc_or_die(sizeof(*dep));
+  dep->path = fullpath(filename);
+  dep->file = file;
+  dep->mtime = st.st_mtime;
+  dep->size = st.st_size;
+  vec_push(pch_deps, dep);
+}
+
+static void write_pch_string(DataStorage *data, const char *str, size_t len) {
+  data_uleb128(data, -1, len + 1);
+  data_append(data, str, len);
+  data_push(data, '\0');
+}
+
+static void write_pch_name(DataStorage *data, const Name *name) {
+  if (name != NULL)
+    write_pch_string(data, name->chars, name->bytes);
+  else
+    write_pch_string(data, "", 0);
+}
+
+static const Name *read_pch_name(DataReader *reader) {
+  size_t len;
+  const char *str = data_read_string(reader, &len);
+  return len > 1 ? alloc_name(str, str + len - 1, false) : NULL;
+}
+
+static void write_pch_macros(DataStorage *data) {
+  Vector names;
+  Vector macros;
+  vec_init(&names);
+  vec_init(&macros);
+  const Name *name;
+  Macro *macro;
+  for (int it = 0; (it = macro_iterate(it, &name, &macro)) != -1; ) {
+    if (!is_location_macro(name)) {
+      vec_push(&names, name);
+      vec_push(&macros, macro);
+    }
+  }
+
+  data_uleb128(data, -1, names.len);
+  for (int i = 0; i < names.len; ++i) {
+    macro = macros.data[i];
+    write_pch_name(data, names.data[i]);
+    data_uleb128(data, -1, macro->params_len + 1);
+    if (macro->params_len > 0) {
+      const Name **params = alloca(sizeof(*params) * macro->params_len);
+      get_macro_params(macro, params);
+      for (int j = 0; j < macro->params_len; ++j)
+        write_pch_name(data, params[j]);
+    }
+    write_pch_name(data, macro->vaargs_ident);
+
+    Vector *body = macro->body;
+    data_uleb128(data, -1, body != NULL ? body->len + 1 : 0);
+    if (body != NULL) {
+      for (int j = 0; j < body->len; ++j) {
+        const Token *tok = body->data[j];
+        if (tok->kind == PPTK_SPACE)
+          data_uleb128(data, -1, 0);
+        else
+          write_pch_string(data, tok->begin, tok->end - tok->begin);
+      }
+    }
+  }
+  free(names.data);
+  free(macros.data);
+}
+
+// Replace all macros with ones after the header.
+static void read_pch_macros(DataReader *reader, const char *fn) {
+  Vector names;
+  vec_init(&names);
+  const Name *name;
+  Macro *macro;
+  for (int it = 0; (it = macro_iterate(it, &name, &macro)) != -1; ) {
+    if (!is_location_macro(name))
+      vec_push(&names, name);
+  }
+  for (int i = 0; i < names.len; ++i)
+    macro_delete(names.data[i]);
+  free(names.data);
+
+  Token *tok_space = alloc_token(PPTK_SPACE, NULL, " ", NULL);
+  for (int n = data_read_uleb128(reader); n > 0 && !reader->error; --n) {
+    name = read_pch_name(reader);
+    int params_len = (int)data_read_uleb128(reader) - 1;
+    Vector *params = NULL;
+    if (params_len >= 0) {
+      params = new_vector();
+      for (int i = 0; i < params_len; ++i)
+        vec_push(params, read_pch_name(reader));
+    }
+    const Name *vaargs_ident = read_pch_name(reader);
+
+    Vector *body = NULL;
+    int body_len = (int)data_read_uleb128(reader) - 1;
+    if (body_len >= 0) {
+      body = new_vector();
+      for (int i = 0; i < body_len; ++i) {
+        size_t len = data_read_uleb128(reader);
+        const char *spelling = data_read_bytes(reader, len);
+        if (spelling == NULL)
+          break;
+        if (len == 0) {
+          vec_push(body, tok_space);
+        } else {
+          set_source_string(spelling, fn, 0);
+          vec_push(body, match(-1));
+        }
+      }
+    }
+    if (name != NULL)
+      macro_add(name, new_macro(params, vaargs_ident, body));
+  }
+}
+
+// Check the header and that all files are unmodified, and return them.
+// `states` is set to read their recorded states. NULL if the pch is unusable.
+static Vector *check_pch_files(DataReader *reader, DataReader *states) {
+  const char *magic = data_read_bytes(reader, PCH_MAGIC_LEN);
+  if (magic == NULL || memcmp(magic, PCH_MAGIC, PCH_MAGIC_LEN) != 0 ||
+      data_read_uleb128(reader) != PCH_VERSION || data_read_uleb128(reader) != pch_key)
+    return NULL;
+  uint64_t size = data_read_uleb128(reader);
+  if (reader->error || size != (uint64_t)(reader->end - reader->p))
+    return NULL;  // Truncated.
+
+  Vector *files = new_vector();
+  int file_count = data_read_uleb128(reader);
+  *states = *reader;
+  for (int i = 0; i < file_count; ++i) {
+    size_t len;
+    const char *fpath = data_read_string(reader, &len);
+    int64_t mtime = data_read_leb128(reader);
+    uint64_t fsize = data_read_uleb128(reader);
+    data_read_string(reader, &len);
+    data_read_uleb128(reader);
+    struct stat st;
+    if (reader->error || stat(fpath, &st) != 0 || st.st_mtime != mtime ||
+        (uint64_t)st.st_size != fsize) {
+      free_vector(files);
+      return NULL;
+    }
+    vec_push(files, get_include_file(&st));
+  }
+  return files;
+}
+
+static bool load_pch(const char *path) {
+  size_t len = strlen(path) + sizeof(".pch");
+  char *fn = malloc_or_die(len);
+  snprintf(fn, len, "%s.pch", path);
+  FILE *fp = fopen(fn, "rb");
+  if (fp == NULL) {
+    free(fn);
+    return false;
+  }
+  SourceInput input;
+  open_source_input(&input, fp);  // Kept on success, names and tokens point to the content.
+  fclose(fp);
+
+  DataReader reader, states;
+  data_reader_init(&reader, input.p, input.end - input.p);
+  // Check all files are unmodified before applying their state.
+  Vector *files = check_pch_files(&reader, &states);
+  if (files == NULL) {
+    close_source_input(&input);
+    free(fn);
+    return false;
+  }
+  for (int i = 0; i < files->len; ++i) {
+    size_t len;
+    const char *fpath = data_read_string(&states, &len);
+    data_read_leb128(&states);
+    data_read_uleb128(&states);
+    IncludeFile *file = files->data[i];
+    file->guard = read_pch_name(&states);
+    uint64_t flags = data_read_uleb128(&states);
+    file->once = (flags & 1) != 0;
+    file->system |= (flags & 2) != 0;
+    add_dependency(fpath, file, false);
+  }
+  free_vector(files);
+
+  read_pch_macros(&reader, fn);
+
+  size_t text_size, scope_size;
+  const char *text = data_read_string(&reader, &text_size);
+  const void *scope = data_read_string(&reader, &scope_size);
+  if (reader.error)
+    error("Broken precompiled header: %s", fn);
+
+  if (pch_scope_accepted && scope_size > 0) {
+    pch_scope = scope;
+    pch_scope_size = scope_size;
+  } else {
+    fwrite(text, text_size - 1, 1, pp_ofp);
+  }
+  return true;
+}
+
+void record_pch_dependencies(void) {
+  pch_deps = new_vector();
+}
+
+void accept_pch_scope(void) {
+  pch_scope_accepted = true;
+}
+
+const void *get_pch_scope(size_t *psize) {
+  *psize = pch_scope_size;
+  return pch_scope;
+}
+
+bool write_pch(const char *fn, const char *text, size_t size, const DataStorage *scope) {
+  assert(pch_deps != NULL);
+  DataStorage data;
+  data_init(&data);
+  data_uleb128(&data, -1, pch_deps->len);
+  for (int i = 0; i < pch_deps->len; ++i) {
+    const PchDependency *dep = pch_deps->data[i];
+    write_pch_string(&data, dep->path, strlen(dep->path));
+    data_leb128(&data, -1, dep->mtime);
+    data_uleb128(&data, -1, dep->size);
+    write_pch_name(&data, dep->file->guard);
+    data_uleb128(&data, -1, (dep->file->once ? 1 : 0) | (dep->file->system ? 2 : 0));
+  }
+  write_pch_macros(&data);
+  write_pch_string(&data, text, size);
+  if (scope != NULL)
+    data_string(&data, scope->buf, scope->len);
+  else
+    data_uleb128(&data, -1, 0);
+
+  DataStorage header;
+  data_init(&header);
+  data_append(&header, PCH_MAGIC, PCH_MAGIC_LEN);
+  data_uleb128(&header, -1, PCH_VERSION);
+  data_uleb128(&header, -1, pch_key);
+  data_uleb128(&header, -1, data.len);
+
+  FILE *fp = fopen(fn, "wb");
+  bool result = fp != NULL;
+  if (result) {
+    result = fwrite(header.buf, header.len, 1, fp) == 1 && fwrite(data.buf, data.len, 1, fp) == 1;
+    result &= fclose(fp) == 0;
+    if (!result)
+      remove(fn);
+  }
+  data_release(&header);
+  data_release(&data);
+  return result;
+}
+
+static void preprocess_file(FILE *fp, const char *filename, IncludeFile *file);
+
+// Parse `"path"` or `<path>`, which might be given by macros.
+static char *parse_header_name(const char *p, Stream *stream, const char *directive, bool *psys,
+                               const char **pnext) {
   const char *orgp = p = skip_whitespaces(p);
 
-  if (*p != '<')
+  if (*p != '<' && *p != '"')
     p = preprocess_one_line(p, stream, NULL);
   char close;
   bool sys = false;
@@ -325,7 +1033,7 @@ static void handle_include(const char *p, Stream *stream, bool is_next) {
     sys = true;
     break;
   default:
-    error("illegal include: %s", orgp);
+    error("illegal %s: %s", directive, orgp);
   }
 
   const char *q;
@@ -334,9 +1042,45 @@ static void handle_include(const char *p, Stream *stream, bool is_next) {
       error("not closed");
   }
 
+  *psys = sys;
+  *pnext = q + 1;
+  return strndup(p, q - p);
+}
+
+// Search a file for `#include` or `#embed`: next to the current file, then system paths.
+static IncludeEntry *find_include(const char *path, Stream *stream, bool sys, bool is_next) {
+  IncludeEntry *entry = NULL;
+  bool system = false;
+  char *dir = strdup(dirname(strdup(stream->filename)));
+  // Search from current directory.
+  if (!is_next && !sys) {
+    const Name *key = alloc_name(dir, NULL, false);
+    Table *cache = table_get(&local_dirs, key);
+    if (cache == NULL) {
+      cache = alloc_table();
+      table_put(&local_dirs, key, cache);
+    }
+    entry = resolve_include(cache, dir, path);
+    system = curpf->file != NULL && curpf->file->system;
+  }
+  if (entry == NULL) {
+    entry = search_sysinc(is_next ? dir : NULL, path, &system);
+    if (entry == NULL)
+      return NULL;
+  }
+  if (system)
+    entry->file->system = true;
+  add_dependency(entry->path, entry->file, false);
+  return entry;
+}
+
+static void handle_include(const char *p, Stream *stream, bool is_next) {
+  bool sys;
+  const char *after;
+  char *path = parse_header_name(p, stream, "include", &sys, &after);
+
   // Ensure line end after include.
   {
-    const char *after = q + 1;
     set_source_string(after, stream->filename, stream->lineno);
     bool err = false;
     for (;;) {
@@ -349,41 +1093,34 @@ static void handle_include(const char *p, Stream *stream, bool is_next) {
     }
   }
 
-  char *path = strndup(p, q - p);
-  char *fn = NULL;
-  FILE *fp = NULL;
-  char *dir = strdup(dirname(strdup(stream->filename)));
-  // Search from current directory.
-  if (!is_next && !sys) {
-    fn = cat_path_cwd(dir, path);
-    if (registered_pragma_once(fn))
-      return;
-    if (is_file(fn))
-      fp = fopen(fn, "r");
-  }
-  if (fp == NULL) {
-    fp = search_sysinc(is_next ? dir : NULL, path, &fn);
-    if (fp == NULL) {
-      if (fn == NULL)  // Raise error except pragma once.
-        error("Cannot open file: %s", path);
-      return;
-    }
+  IncludeEntry *entry = find_include(path, stream, sys, is_next);
+  if (entry == NULL)
+    error("Cannot open file: %s", path);
+  if (skip_include(entry->file))
+    return;
+
+  bool try_pch = pch_allowed;
+  pch_allowed = false;  // Only for the first include.
+  if (!try_pch || !load_pch(entry->path)) {
+    FILE *fp = fopen(entry->path, "r");
+    if (fp == NULL)
+      error("Cannot open file: %s", path);
+    preprocess_file(fp, entry->path, entry->file);
+    fclose(fp);
   }
 
-  preprocess(fp, fn);
-  fclose(fp);
-
   // Put linemarker to restore line and filename.
-  fprintf(pp_ofp, "# %d \"%s\" 2\n", stream->lineno + 1, stream->filename);
+  if (!pp_binary)
+    fprintf(pp_ofp, "# %d \"%s\" 2\n", stream->lineno + 1, stream->filename);
 }
 
-static void handle_pragma(const char **pp, const char *filename) {
+static void handle_pragma(const char **pp, IncludeFile *file) {
   const char *p = *pp;
   const char *begin = p;
   const char *end = read_ident(p);
   if ((end - begin) == 4 && strncmp(begin, "once", 4) == 0) {
-    if (!registered_pragma_once(filename))
-      register_pragma_once(filename);
+    if (file != NULL)
+      file->once = true;
     *pp = end;
   } else {
     fprintf(stderr, "Warning: unhandled #pragma: %s\n", p);
@@ -392,23 +1129,23 @@ static void handle_pragma(const char **pp, const char *filename) {
 }
 
 static void handle_line_directive(const char **pp, Stream *stream) {
+  pch_allowed = false;
   size_t size;
   char *expanded = preprocess_one_line(*pp, stream, &size);
 
   PpResult num;
   {
-    FILE *memfp = fmemopen(expanded, size, "r");
-    assert(memfp != NULL);
+    SourceInput input;
+    set_source_input_string(&input, expanded, size);
 
     Stream tmp_stream;
-    tmp_stream.fp = memfp;
+    tmp_stream.input = &input;
     tmp_stream.filename = stream->filename;
     tmp_stream.lineno = stream->lineno;
     Stream *bak_stream = set_pp_stream(&tmp_stream);
-    set_source_file(memfp, stream->filename);
+    set_source_input(&input, stream->filename);
     num = pp_expr();
     set_pp_stream(bak_stream);
-    fclose(memfp);
   }
   stream->lineno = num;
 
@@ -451,10 +1188,8 @@ static Vector *parse_macro_body(const char *p, Stream *stream) {
 
         ssize_t len = -1;
         char *line = NULL;
-        if (stream != NULL) {
-          size_t capa = 0;
-          len = getline_cont(&line, &capa, stream->fp, &stream->lineno);
-        }
+        if (stream != NULL)
+          len = source_getline_cont(stream->input, &line, &stream->lineno);
         if (len == -1) {
           lex_error(comment_start, "Block comment not closed");
         }
@@ -491,6 +1226,7 @@ static Vector *parse_macro_body(const char *p, Stream *stream) {
 }
 
 static void handle_define(const char *p, Stream *stream) {
+  pch_allowed = false;
   const char *begin = p;
   const char *end = read_ident(p);
   if (end == NULL)
@@ -538,6 +1274,7 @@ static void handle_undef(const char **pp) {
   const char *end = read_ident(p);
   if (end == NULL)
     error("ident expected");
+  pch_allowed = false;
   undef_macro(begin, end);
 
   *pp = end;
@@ -546,6 +1283,7 @@ static void handle_undef(const char **pp) {
 static const char *find_double_quote_end(const char *p) {
   const char *start = p;
   for (;;) {
+    p = find_char3(p, '"', '\\', '\\');
     switch (*p++) {
     case '\0':
       lex_error(start, "Quote not closed");
@@ -567,9 +1305,8 @@ static const char *find_block_comment_end(const char *comment_start, Stream *str
     if (e != NULL)
       return e;
 
-    char *line = NULL;
-    size_t capa = 0;
-    ssize_t len = getline_cont(&line, &capa, stream->fp, &stream->lineno);
+    char *line;
+    ssize_t len = source_getline_cont(stream->input, &line, &stream->lineno);
     if (len == -1) {
       lex_error(comment_start, "Block comment not closed");
     }
@@ -580,6 +1317,7 @@ static const char *find_block_comment_end(const char *comment_start, Stream *str
 
 static void process_disabled_line(const char *p, Stream *stream) {
   for (;;) {
+    p = find_char3(p, '"', '\'', '/');
     switch (*p++) {
     case '\0':
       return;
@@ -617,6 +1355,35 @@ static void process_disabled_line(const char *p, Stream *stream) {
   }
 }
 
+// Returns `X` for `#ifndef X`, `#if !defined(X)` or `#if !defined X`.
+static const Name *guard_macro_name(const char *directive) {
+  const char *p;
+  if ((p = keyword(directive, "ifndef")) != NULL) {
+    const char *end = read_ident(p);
+    return end != NULL ? alloc_name(p, end, true) : NULL;
+  }
+
+  if ((p = keyword(directive, "if")) == NULL || *p != '!' ||
+      (p = keyword(skip_whitespaces(p + 1), "defined")) == NULL)
+    return NULL;
+  bool paren = *p == '(';
+  if (paren)
+    p = skip_whitespaces(p + 1);
+  const char *begin = p;
+  const char *end = read_ident(p);
+  if (end == NULL)
+    return NULL;
+  p = skip_whitespaces(end);
+  if (paren) {
+    if (*p != ')')
+      return NULL;
+    p = skip_whitespaces(p + 1);
+  }
+  if (*p != '\0' && !(p[0] == '/' && p[1] == '/'))
+    return NULL;
+  return alloc_name(begin, end, true);
+}
+
 static bool handle_ifdef(const char **pp) {
   const char *p = *pp;
   const char *begin = p;
@@ -628,22 +1395,22 @@ static bool handle_ifdef(const char **pp) {
   return macro_get(name) != NULL;
 }
 
-static bool handle_if(const char **pp, Stream *stream, bool enable) {
+static PpResult eval_pp_expr(const char **pp, Stream *stream, bool enable) {
   size_t size;
   char *expanded = preprocess_one_line(*pp, stream, &size);
 
   // Parse expression.
   PpResult result;
   {
-    FILE *memfp = fmemopen(expanded, size, "r");
-    assert(memfp != NULL);
+    SourceInput input;
+    set_source_input_string(&input, expanded, size);
 
     Stream tmp_stream;
-    tmp_stream.fp = memfp;
+    tmp_stream.input = &input;
     tmp_stream.filename = stream->filename;
     tmp_stream.lineno = stream->lineno;
     Stream *bak_stream = set_pp_stream(&tmp_stream);
-    set_source_file(memfp, stream->filename);
+    set_source_input(&input, stream->filename);
     result = pp_expr();
 
     const char *p = get_lex_p();
@@ -651,10 +1418,156 @@ static bool handle_if(const char **pp, Stream *stream, bool enable) {
       error("illegal expression");
 
     set_pp_stream(bak_stream);
-    fclose(memfp);
     *pp = get_lex_p();
   }
-  return result != 0;
+  return result;
+}
+
+static bool handle_if(const char **pp, Stream *stream, bool enable) {
+  return eval_pp_expr(pp, stream, enable) != 0;
+}
+
+// `#embed` parameter: `name(balanced tokens)`, also accepted as `__name__`.
+static const char *parse_embed_param(const char *p, const char **pname, size_t *plen,
+                                     char **pbody) {
+  const char *end = read_ident(p);
+  if (end == NULL)
+    error("#embed: parameter expected: %s", p);
+  if (end - p > 4 && strncmp(p, "__", 2) == 0 && strncmp(end - 2, "__", 2) == 0) {
+    *pname = p + 2;
+    *plen = end - p - 4;
+  } else {
+    *pname = p;
+    *plen = end - p;
+  }
+
+  p = skip_whitespaces(end);
+  if (*p != '(')
+    error("#embed: `(' expected: %s", p);
+  const char *start = p + 1;
+  for (int depth = 0;; ++p) {
+    switch (*p) {
+    case '\0':
+      error("#embed: `)' expected: %s", start);
+    case '(':
+      ++depth;
+      break;
+    case ')':
+      if (--depth == 0) {
+        *pbody = strndup(start, p - start);
+        return skip_whitespaces(p + 1);
+      }
+      break;
+    case '"':
+      p = find_double_quote_end(p + 1) - 1;
+      break;
+    case '\'':
+      for (++p; *p != '\''; ++p) {
+        if (*p == '\0')
+          error("#embed: quote not closed: %s", start);
+        if (*p == '\\' && p[1] != '\0')
+          ++p;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+// Prefix, suffix or if_empty: put as is.
+static void output_embed_tokens(const char *text, Stream *stream) {
+  if (!pp_binary) {
+    fprintf(pp_ofp, "%s\n", text);
+    return;
+  }
+  set_source_string(text, stream->filename, stream->lineno);
+  for (Token *tok; (tok = match(-1))->kind != TK_EOF; )
+    write_token(tok);
+}
+
+// Hash of the first `size` bytes: the output changes with the contents, not only the path,
+// for the compile cache keyed by the output.
+static uint64_t hash_embed_data(FILE *fp, size_t size) {
+  uint64_t hash = HASH_OFFSET_BASIS;
+  char buf[4096];
+  for (size_t n; size > 0 && (n = fread(buf, 1, MIN(size, sizeof(buf)), fp)) > 0; size -= n)
+    hash = hash_bytes(hash, buf, n);
+  return hash;
+}
+
+// `#embed` is replaced with a line `#embed "fullpath" limit(size) hash(hex)` (or a binary
+// token) for cc1, which reads the file by itself instead of a long list of numbers.
+static void handle_embed(const char *p, Stream *stream) {
+  pch_allowed = false;
+  bool sys;
+  char *path = parse_header_name(p, stream, "embed", &sys, &p);
+
+  size_t limit = (size_t)-1;
+  char *prefix = NULL, *suffix = NULL, *if_empty = NULL;
+  for (p = skip_whitespaces(p); *p != '\0'; ) {
+    if (p[0] == '/' && p[1] == '/')
+      break;
+    const char *name;
+    size_t len;
+    char *body;
+    p = parse_embed_param(p, &name, &len, &body);
+    if (len == 5 && strncmp(name, "limit", len) == 0) {
+      const char *q = body;
+      PpResult value = eval_pp_expr(&q, stream, true);
+      if (value < 0)
+        error("#embed: negative limit");
+      limit = value;
+    } else if (len == 6 && strncmp(name, "prefix", len) == 0) {
+      prefix = body;
+    } else if (len == 6 && strncmp(name, "suffix", len) == 0) {
+      suffix = body;
+    } else if (len == 8 && strncmp(name, "if_empty", len) == 0) {
+      if_empty = body;
+    } else {
+      error("#embed: unsupported parameter: %.*s", (int)len, name);
+    }
+  }
+
+  IncludeEntry *entry = find_include(path, stream, sys, false);
+  if (entry == NULL)
+    error("Cannot open file: %s", path);
+  FILE *fp = fopen(entry->path, "rb");
+  struct stat st;
+  if (fp == NULL || fstat(fileno(fp), &st) != 0)
+    error("Cannot open file: %s", path);
+  if (pch_deps != NULL)
+    add_pch_dependency(fp, entry->path, entry->file);
+  size_t size = (size_t)st.st_size < limit ? (size_t)st.st_size : limit;
+  uint64_t hash = size > 0 ? hash_embed_data(fp, size) : 0;
+  fclose(fp);
+
+  token_writer.stream = stream;
+  token_writer.stream_lineno = stream->lineno;
+  if (size == 0) {
+    if (if_empty != NULL)
+      output_embed_tokens(if_empty, stream);
+  } else {
+    if (prefix != NULL)
+      output_embed_tokens(prefix, stream);
+    if (pp_binary) {
+      write_embed(entry->path, size, hash);
+    } else {
+      fputs("#embed \"", pp_ofp);
+      for (const char *q = entry->path; *q != '\0'; ++q) {
+        if (*q == '"' || *q == '\\')
+          fputc('\\', pp_ofp);
+        fputc(*q, pp_ofp);
+      }
+      fprintf(pp_ofp, "\" limit(%zu) hash(%016" PRIx64 ")\n", size, hash);
+    }
+    if (suffix != NULL)
+      output_embed_tokens(suffix, stream);
+  }
+
+  // Put linemarker to restore line.
+  if (!pp_binary)
+    fprintf(pp_ofp, "# %d \"%s\"\n", stream->lineno + 1, stream->filename);
 }
 
 static intptr_t cond_value(bool enable, enum Satisfy satisfy) {
@@ -673,9 +1586,24 @@ void init_preprocessor(FILE *ofp) {
   key_file = alloc_name("__FILE__", NULL, false);
   key_line = alloc_name("__LINE__", NULL, false);
 
-  // Keep sys_inc_paths.
+  // Keep sys_inc_paths, but forget resolved files.
+  for (int ord = 0; ord < INC_ORDERS; ++ord) {
+    Vector *v = &sys_inc_paths[ord];
+    for (int idx = 0; idx < v->len; ++idx) {
+      IncludeDir *incdir = v->data[idx];
+      table_init(&incdir->cache);
+    }
+  }
+  table_init(&local_dirs);
+  table_init(&include_files);
 
-  vec_init(&pragma_once_files);
+  TokenWriter *tw = &token_writer;
+  table_init(&tw->idents);
+  table_init(&tw->files);
+  tw->filename = NULL;
+  tw->file_index = -1;
+  tw->lineno = -1;
+  vec_init(&tw->strings);
 
   macro_init();
   init_lexer_for_preprocessor();
@@ -685,13 +1613,35 @@ void set_preserve_comment(bool enable) {
   preserve_comment = enable;
 }
 
+void set_preprocess_output(FILE *ofp) {
+  pp_ofp = ofp;
+}
+
 static const char *process_directive(PreprocessFile *ppf, const char *line) {
   // Find '#'
   const char *directive = find_directive(line);
   if (directive == NULL)
     return line;
 
+  // Any directive outside of the guard, except the guard itself, disables the optimization.
+  if (ppf->condstack->len == 0 && ppf->guard_state != GS_NONE) {
+    const Name *guard;
+    if (ppf->guard_state == GS_START && (guard = guard_macro_name(directive)) != NULL) {
+      ppf->guard = guard;
+      ppf->guard_state = GS_INSIDE;
+    } else {
+      ppf->guard_state = GS_NONE;
+    }
+  }
+
   if (isdigit(*directive)) {
+    if (pp_binary) {
+      // Binary tokens carry their location: apply linemarkers like `#line`.
+      const char *next = directive;
+      handle_line_directive(&next, &ppf->stream);
+      ppf->out_lineno = --ppf->stream.lineno;
+      return NULL;
+    }
     // Assume linemarkers: output as is.
     OUTPUT_PPLINE("%s\n", line);
     return NULL;
@@ -717,6 +1667,8 @@ static const char *process_directive(PreprocessFile *ppf, const char *line) {
     int last = ppf->condstack->len - 1;
     if (last < 0)
       error("`#else' used without `#if'");
+    if (last == 0 && ppf->guard_state == GS_INSIDE)
+      ppf->guard_state = GS_NONE;
     intptr_t flag = VOIDP2INT(ppf->condstack->data[last]);
     if (ppf->satisfy == ElseAppeared)
       error("Illegal #else");
@@ -726,6 +1678,8 @@ static const char *process_directive(PreprocessFile *ppf, const char *line) {
     int last = ppf->condstack->len - 1;
     if (last < 0)
       error("`#elif' used without `#if'");
+    if (last == 0 && ppf->guard_state == GS_INSIDE)
+      ppf->guard_state = GS_NONE;
     intptr_t flag = VOIDP2INT(ppf->condstack->data[last]);
     if (ppf->satisfy == ElseAppeared)
       error("Illegal #elif");
@@ -745,6 +1699,8 @@ static const char *process_directive(PreprocessFile *ppf, const char *line) {
     int flag = VOIDP2INT(vec_pop(ppf->condstack));
     ppf->enable = (flag & CF_ENABLE) != 0;
     ppf->satisfy = (flag & CF_SATISFY_MASK) >> CF_SATISFY_SHIFT;
+    if (ppf->condstack->len == 0 && ppf->guard_state == GS_INSIDE)
+      ppf->guard_state = GS_CLOSED;
   } else if (ppf->enable) {
     if ((next = keyword(directive, "include")) != NULL) {
       handle_include(next, &ppf->stream, false);
@@ -753,20 +1709,25 @@ static const char *process_directive(PreprocessFile *ppf, const char *line) {
     } else if ((next = keyword(directive, "include_next")) != NULL) {
       handle_include(next, &ppf->stream, true);
       next = NULL;
+    } else if ((next = keyword(directive, "embed")) != NULL) {
+      handle_embed(next, &ppf->stream);
+      ppf->out_lineno = ppf->stream.lineno;
+      next = NULL;
     } else if ((next = keyword(directive, "define")) != NULL) {
       handle_define(next, &ppf->stream);
       next = NULL;  // `#define' consumes the line all.
     } else if ((next = keyword(directive, "undef")) != NULL) {
       handle_undef(&next);
     } else if ((next = keyword(directive, "pragma")) != NULL) {
-      handle_pragma(&next, ppf->stream.filename);
+      handle_pragma(&next, ppf->file);
     } else if ((next = keyword(directive, "error")) != NULL) {
       fprintf(stderr, "%s(%d): error\n", ppf->stream.filename, ppf->stream.lineno);
       error("%s", line);
     } else if ((next = keyword(directive, "line")) != NULL) {
       handle_line_directive(&next, &ppf->stream);
       int flag = 1;
-      fprintf(pp_ofp, "# %d \"%s\" %d\n", ppf->stream.lineno, ppf->stream.filename, flag);
+      if (!pp_binary)
+        fprintf(pp_ofp, "# %d \"%s\" %d\n", ppf->stream.lineno, ppf->stream.filename, flag);
       define_file_macro(ppf->stream.filename);
       ppf->out_lineno = --ppf->stream.lineno;
       next = NULL;
@@ -783,7 +1744,9 @@ static void adjust_output_lineno(PreprocessFile *ppf) {
   assert(ppf->out_lineno <= ppf->stream.lineno);
   int d = ppf->stream.lineno - ppf->out_lineno;
   if (d > 0) {
-    if (d >= 5) {
+    if (pp_binary) {
+      // Binary tokens carry their location.
+    } else if (d >= 5) {
       fprintf(pp_ofp, "# %d \"%s\"\n", ppf->stream.lineno, ppf->stream.filename);
     } else {
       for (int i = 0; i < d; ++i)
@@ -796,9 +1759,8 @@ static void adjust_output_lineno(PreprocessFile *ppf) {
 const char *get_processed_next_line(void) {
   PreprocessFile *ppf = curpf;
   for (;;) {
-    char *line = NULL;
-    size_t capa = 0;
-    ssize_t len = getline_cont(&line, &capa, ppf->stream.fp, &ppf->stream.lineno);
+    char *line;
+    ssize_t len = source_getline_cont(ppf->stream.input, &line, &ppf->stream.lineno);
     if (len == -1)
       return NULL;
 
@@ -816,21 +1778,29 @@ const char *get_processed_next_line(void) {
   }
 }
 
-void preprocess(FILE *fp, const char *filename) {
+static void preprocess_file(FILE *fp, const char *filename, IncludeFile *file) {
   Macro *old_file_macro = macro_get(key_file);
   Macro *old_line_macro = macro_get(key_line);
 
+  SourceInput input;
+  open_source_input(&input, fp);
+
   PreprocessFile pf;
   pf.condstack = new_vector();
-  pf.stream = (Stream){.filename = filename, .fp = fp, .lineno = 0};
+  pf.stream = (Stream){.filename = filename, .input = &input, .lineno = 0};
   pf.enable = true;
   pf.out_lineno = 0;
   pf.satisfy = NotSatisfied;
+  pf.guard_state = GS_START;
+  pf.guard = NULL;
+  pf.file = file;
 
   Stream *old_stream = set_pp_stream(&pf.stream);
   PreprocessFile *oldpf = curpf;
   curpf = &pf;
 
+  if (pch_deps != NULL)
+    add_pch_dependency(fp, filename, file);
   define_file_macro(pf.stream.filename);
 
   // __LINE__ : Dirty hack.
@@ -839,7 +1809,8 @@ void preprocess(FILE *fp, const char *filename) {
   vec_push(lineno_tokens, pf.tok_lineno);
   macro_add(key_line, new_macro(NULL, NULL, lineno_tokens));
 
-  fprintf(pp_ofp, "# 1 \"%s\" 1\n", filename);
+  if (!pp_binary)
+    fprintf(pp_ofp, "# 1 \"%s\" 1\n", filename);
 
   for (const char *line; (line = get_processed_next_line()) != NULL;) {
     process_line(line, &pf.stream);
@@ -848,6 +1819,8 @@ void preprocess(FILE *fp, const char *filename) {
 
   if (pf.condstack->len > 0)
     error("#if not closed");
+  if (file != NULL)
+    file->guard = pf.guard_state == GS_CLOSED ? pf.guard : NULL;
 
   curpf = oldpf;
   set_pp_stream(old_stream);
@@ -856,6 +1829,22 @@ void preprocess(FILE *fp, const char *filename) {
   macro_add(key_line, old_line_macro);
 }
 
+void preprocess(FILE *fp, const char *filename) {
+  IncludeFile *file = NULL;
+  struct stat st;
+  if (fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode))
+    file = get_include_file(&st);
+  pch_key = calc_pch_key();
+  pch_allowed = pch_deps == NULL && !pp_binary;
+  if (file != NULL)
+    add_dependency(filename, file, true);
+  preprocess_file(fp, filename, file);
+  pch_allowed = false;
+  pch_scope_accepted = false;  // Only for the first source.
+  if (pp_binary)
+    flush_strings();
+}
+
 void define_macro(const char *arg) {
   char *p = strchr(arg, '=');
   Macro *macro = new_macro(NULL, NULL, parse_macro_body(p != NULL ? p + 1 : "1", NULL));
@@ -869,5 +1858,9 @@ void undef_macro(const char *begin, const char *end) {
 
 void add_inc_path(enum IncludeOrder order, const char *path) {
   assert(order < INC_ORDERS);
-  vec_push(&sys_inc_paths[order], strdup(path));
+  IncludeDir *incdir = malloc_or_die(sizeof(*incdir));
+  incdir->path = strdup(path);
+  incdir->full = NULL;
+  table_init(&incdir->cache);
+  vec_push(&sys_inc_paths[order], incdir);
 }
@@ -3,6 +3,9 @@
 #include <stdbool.h>
 #include <stdio.h>  // FILE*
 
+typedef struct DataStorage DataStorage;
+typedef struct Vector Vector;
+
 enum IncludeOrder {
   INC_NORMAL,
   INC_SYSTEM,
@@ -11,8 +14,22 @@ enum IncludeOrder {
 
 void init_preprocessor(FILE *ofp);
 void set_preserve_comment(bool enable);
+void set_preprocess_output(FILE *ofp);
+void set_binary_tokens(bool enable);  // Output compact binary tokens for cc1, see token_stream.h.
 void preprocess(FILE *fp, const char *filename);
 
+// Precompiled header: `record_pch_dependencies` is called before `preprocess` of a header,
+// and `write_pch` after that with the output. `scope` is written by cc1, or NULL.
+void record_pch_dependencies(void);
+bool write_pch(const char *fn, const char *text, size_t size, const DataStorage *scope);
+void accept_pch_scope(void);  // cc1 loads the global scope instead of parsing the text.
+const void *get_pch_scope(size_t *psize);  // NULL if not loaded.
+
+// Dependency file: `record_dependencies` is called before `preprocess`, and
+// `write_dependencies` writes a make rule from `targets` to the files read.
+void record_dependencies(bool system_headers);
+bool write_dependencies(const char *fn, const Vector *targets, bool phony);
+
 void define_macro(const char *arg);  // "FOO" or "BAR=QUX"
 void undef_macro(const char *begin, const char *end);
 void add_inc_path(enum IncludeOrder order, const char *path);
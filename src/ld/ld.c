@@ -14,6 +14,7 @@
 #include "archive.h"
 #include "elfobj.h"
 #include "elfutil.h"
+#include "report.h"
 #include "table.h"
 #include "util.h"
 
@@ -884,6 +885,8 @@ static void usage(FILE *fp) {
       "  -l <name>           Add library\n"
       "  -L <path>           Add library path\n"
       "  -e <funcname>       Set entry function (Default: _start)\n"
+      "  -ftime-report       Report time of each phase\n"
+      "  -fmem-report        Report peak memory of each phase\n"
   );
 }
 
@@ -908,6 +911,7 @@ static Vector *parse_options(int argc, char *argv[], Options *opts) {
     {"l", required_argument},  // Library
     {"L", required_argument},  // Add library path
     {"Map", required_argument, OPT_OUTMAP},  // Output map file
+    {"f", optional_argument},
     {"-help", no_argument, OPT_HELP},
     {"v", no_argument, OPT_VERSION},
     {"-version", no_argument, OPT_VERSION},
@@ -960,6 +964,10 @@ static Vector *parse_options(int argc, char *argv[], Options *opts) {
     case OPT_OUTMAP:
       opts->outmapfn = optarg;
       break;
+    case 'f':
+      if (optarg == NULL || !parse_report_option(optarg))
+        fprintf(stderr, "Warning: unknown option: %s\n", argv[optind - 1]);
+      break;
     case OPT_NO_PIE:
       // Silently ignored.
       break;
@@ -1127,6 +1135,7 @@ static void collect_section_data(Vector *section_lists[SECTION_COUNT],
 }
 
 static int do_link(Vector *sources, const Options *opts) {
+  enter_report_phase("load");
   LinkEditor *ld = malloc_or_die(sizeof(*ld));
   ld_init(ld, sources->len);
   for (int i = 0; i < sources->len; ++i) {
@@ -1134,6 +1143,8 @@ static int do_link(Vector *sources, const Options *opts) {
     ld_load(ld, i, src);
   }
 
+  enter_report_phase("link");
+
   const Name *entry_name = alloc_name(opts->entry, NULL, false);
   Table unresolved;
   table_init(&unresolved);
@@ -1170,6 +1181,7 @@ static int do_link(Vector *sources, const Options *opts) {
   uint64_t entry_address = ld_symbol_address(ld, entry_name);
   assert(entry_address != (uint64_t)-1);
 
+  enter_report_phase("output");
   bool result = output_exe(opts->ofn, entry_address, section_groups);
 
   if (opts->outmapfn != NULL && result)
@@ -1191,5 +1203,7 @@ int main(int argc, char *argv[]) {
   if (opts.ofn == NULL)
     opts.ofn = "a.out";
 
-  return do_link(sources, &opts);
+  int result = do_link(sources, &opts);
+  output_report("ld");
+  return result;
 }
@@ -0,0 +1,208 @@
+#include "../config.h"
+#include "report.h"
+
+#include <inttypes.h>  // PRId64
+#include <stdint.h>
+#include <stdlib.h>  // strtoll
+#include <string.h>
+#include <time.h>  // clock_gettime
+
+#include "util.h"
+
+// Self-hosted libc lacks getrusage: only wall time is available.
+#if !defined(__XCC)
+#define USE_RUSAGE
+#include <sys/resource.h>  // getrusage
+#endif
+
+#define MAX_PHASES  (64)
+
+typedef struct {
+  const char *tool;  // NULL for this process.
+  const char *name;
+  int64_t wall;  // usec
+  int64_t user;  // usec
+  long maxrss;  // KiB, peak until the end of the phase.
+} Phase;
+
+int report_flags;
+static const char *report_fn;  // Append records instead of printing table, if non-NULL.
+
+static Phase phases[MAX_PHASES];
+static int phase_count;
+static int cur_phase = -1;
+static int64_t last_wall, last_user;
+
+static void get_usage(int64_t *pwall, int64_t *puser, long *pmaxrss) {
+  struct timespec ts;
+#if defined(USE_RUSAGE)
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  *puser = ru.ru_utime.tv_sec * (int64_t)1000000 + ru.ru_utime.tv_usec;
+#if defined(__APPLE__)
+  *pmaxrss = ru.ru_maxrss / 1024;  // In bytes.
+#else
+  *pmaxrss = ru.ru_maxrss;
+#endif
+#else
+  clock_gettime(CLOCK_REALTIME, &ts);
+  *puser = 0;
+  *pmaxrss = 0;
+#endif
+  *pwall = ts.tv_sec * (int64_t)1000000 + ts.tv_nsec / 1000;
+}
+
+static bool same_tool(const char *a, const char *b) {
+  return a == b || (a != NULL && b != NULL && strcmp(a, b) == 0);
+}
+
+static int find_phase(const char *tool, const char *name, bool copy) {
+  for (int i = 0; i < phase_count; ++i) {
+    Phase *p = &phases[i];
+    if (strcmp(p->name, name) == 0 && same_tool(p->tool, tool))
+      return i;
+  }
+  if (phase_count >= MAX_PHASES)
+    error("Too many report phases");
+
+  Phase *p = &phases[phase_count];
+  p->tool = copy && tool != NULL ? strdup(tool) : tool;
+  p->name = copy ? strdup(name) : name;
+  p->wall = p->user = 0;
+  p->maxrss = 0;
+  return phase_count++;
+}
+
+// Charge usage since the last switch to the current phase, and switch to `next`.
+static void switch_phase(int next) {
+  int64_t wall, user;
+  long maxrss;
+  get_usage(&wall, &user, &maxrss);
+  if (cur_phase >= 0) {
+    Phase *p = &phases[cur_phase];
+    p->wall += wall - last_wall;
+    p->user += user - last_user;
+    p->maxrss = MAX(p->maxrss, maxrss);
+  }
+  last_wall = wall;
+  last_user = user;
+  cur_phase = next;
+}
+
+bool parse_report_option(const char *optarg) {
+  static const struct {
+    const char *name;
+    int flag;
+  } kReportOptions[] = {
+    {"time-report", REPORT_TIME},
+    {"mem-report", REPORT_MEM},
+  };
+  for (size_t i = 0; i < ARRAY_SIZE(kReportOptions); ++i) {
+    size_t len = strlen(kReportOptions[i].name);
+    if (strncmp(optarg, kReportOptions[i].name, len) == 0 &&
+        (optarg[len] == '\0' || optarg[len] == '=')) {
+      report_flags |= kReportOptions[i].flag;
+      if (optarg[len] == '=')
+        report_fn = &optarg[len + 1];
+      return true;
+    }
+  }
+  return false;
+}
+
+int enter_report_phase(const char *name) {
+  if (report_flags == 0)
+    return -1;
+  int prev = cur_phase;
+  switch_phase(find_phase(NULL, name, false));
+  return prev;
+}
+
+void leave_report_phase(int prev) {
+  if (report_flags == 0)
+    return;
+  switch_phase(prev);
+}
+
+// Record: tool \t phase \t wall \t user \t maxrss
+bool merge_report_file(const char *fn) {
+  FILE *fp = fopen(fn, "r");
+  if (fp == NULL)
+    return false;
+
+  char *line = NULL;
+  size_t capa = 0;
+  while (getline_chomp(&line, &capa, fp) != -1) {
+    char *name = strchr(line, '\t');
+    char *p = name != NULL ? strchr(name + 1, '\t') : NULL;
+    if (p == NULL)
+      continue;
+    *name++ = '\0';
+    *p++ = '\0';
+    int64_t wall = strtoll(p, &p, 10);
+    int64_t user = strtoll(p, &p, 10);
+    long maxrss = strtol(p, &p, 10);
+
+    Phase *phase = &phases[find_phase(line, name, true)];
+    phase->wall += wall;
+    phase->user += user;
+    phase->maxrss = MAX(phase->maxrss, maxrss);
+  }
+  free(line);
+  fclose(fp);
+  return true;
+}
+
+void output_report(const char *tool) {
+  if (report_flags == 0)
+    return;
+  switch_phase(cur_phase);
+
+  if (report_fn != NULL) {
+    FILE *fp = fopen(report_fn, "a");
+    if (fp == NULL) {
+      perror(report_fn);
+      return;
+    }
+    for (int i = 0; i < phase_count; ++i) {
+      Phase *p = &phases[i];
+      fprintf(fp, "%s\t%s\t%" PRId64 "\t%" PRId64 "\t%ld\n", p->tool != NULL ? p->tool : tool,
+              p->name, p->wall, p->user, p->maxrss);
+    }
+    fclose(fp);
+    return;
+  }
+
+  FILE *fp = stderr;
+  fprintf(fp, "%-32s", "Phase");
+  if (report_flags & REPORT_TIME)
+    fprintf(fp, "%12s%12s", "Wall(ms)", "User(ms)");
+  if (report_flags & REPORT_MEM)
+    fprintf(fp, "%16s", "Peak RSS(KiB)");
+  fprintf(fp, "\n");
+
+  Phase total = {.name = "Total", .wall = 0, .user = 0, .maxrss = 0};
+  for (int i = 0; i <= phase_count; ++i) {
+    Phase *p = &total;
+    if (i < phase_count) {
+      p = &phases[i];
+      total.wall += p->wall;
+      total.user += p->user;
+      total.maxrss = MAX(total.maxrss, p->maxrss);
+    }
+
+    char label[64];
+    if (p == &total)
+      snprintf(label, sizeof(label), "%s", p->name);
+    else
+      snprintf(label, sizeof(label), "%s: %s", p->tool != NULL ? p->tool : tool, p->name);
+    fprintf(fp, "%-32s", label);
+    if (report_flags & REPORT_TIME)
+      fprintf(fp, "%8" PRId64 ".%03d%8" PRId64 ".%03d", p->wall / 1000, (int)(p->wall % 1000),
+              p->user / 1000, (int)(p->user % 1000));
+    if (report_flags & REPORT_MEM)
+      fprintf(fp, "%16ld", p->maxrss);
+    fprintf(fp, "\n");
+  }
+}
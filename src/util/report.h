@@ -0,0 +1,22 @@
+// Time and memory report (-ftime-report, -fmem-report)
+//
+// Each tool accumulates wall/user time and peak RSS per phase, and prints a table,
+// or appends records to the file given by `-ftime-report=<file>` for xcc to aggregate.
+
+#pragma once
+
+#include <stdbool.h>
+
+#define REPORT_TIME  (1 << 0)
+#define REPORT_MEM   (1 << 1)
+
+extern int report_flags;
+
+bool parse_report_option(const char *optarg);  // `time-report[=<file>]` or `mem-report[=<file>]`.
+
+// Phases can be nested: time spent in an inner phase is not counted in the outer one.
+int enter_report_phase(const char *name);  // Returns the current phase, passed to `leave_report_phase`.
+void leave_report_phase(int prev);
+
+bool merge_report_file(const char *fn);
+void output_report(const char *tool);
@@ -5,6 +5,18 @@
 
 // Hash
 
+uint64_t hash_bytes(uint64_t hash, const void *data, size_t size) {
+  const unsigned char *p = data;
+  for (size_t i = 0; i < size; ++i)
+    hash = (hash ^ p[i]) * HASH_PRIME;
+  return hash;
+}
+
+uint32_t hash_uint64(uint64_t x) {
+  x = (x ^ (x >> 31)) * 0x7fb5d329728ea185ULL;
+  return x ^ (x >> 27);
+}
+
 static uint32_t hash_string(const char *key, int length) {
   const unsigned char *u = (const unsigned char*)key;
   // FNV1a
@@ -206,3 +218,68 @@ int table_iterate(Table *table, int iterator, const Name **pkey, void **pvalue)
   }
   return -1;
 }
+
+// Pointer Table
+
+static int find_ptr_index(const PtrTable *table, const void *key) {
+  int mask = table->capacity - 1;
+  int i;
+  for (i = hash_uint64((uintptr_t)key) & mask; table->keys[i] != NULL && table->keys[i] != key;
+       i = (i + 1) & mask)
+    ;
+  return i;
+}
+
+void ptr_table_init(PtrTable *table) {
+  table->keys = NULL;
+  table->values = NULL;
+  table->capacity = table->count = 0;
+}
+
+bool ptr_table_try_get(const PtrTable *table, const void *key, void **output) {
+  if (table->count == 0)
+    return false;
+  int i = find_ptr_index(table, key);
+  if (table->keys[i] == NULL)
+    return false;
+  if (output != NULL)
+    *output = table->values[i];
+  return true;
+}
+
+void ptr_table_put(PtrTable *table, const void *key, void *value) {
+  const int MIN_CAPACITY = 64;
+  if ((table->count + 1) * 2 > table->capacity) {
+    PtrTable old = *table;
+    table->capacity = old.capacity > 0 ? old.capacity * 2 : MIN_CAPACITY;
+    table->keys = calloc(table->capacity, sizeof(*table->keys));
+    table->values = malloc(sizeof(*table->values) * table->capacity);
+    if (table->keys == NULL || table->values == NULL) {
+      free(table->keys);
+      free(table->values);
+      *table = old;
+      if (table->count >= table->capacity - 1)
+        return;  // Keep an empty slot to terminate probing.
+    } else {
+      table->count = 0;
+      for (int i = 0; i < old.capacity; ++i) {
+        if (old.keys[i] != NULL)
+          ptr_table_put(table, old.keys[i], old.values[i]);
+      }
+      ptr_table_release(&old);
+    }
+  }
+
+  int i = find_ptr_index(table, key);
+  if (table->keys[i] == NULL) {
+    table->keys[i] = key;
+    ++table->count;
+  }
+  table->values[i] = value;
+}
+
+void ptr_table_release(PtrTable *table) {
+  free(table->keys);
+  free(table->values);
+  ptr_table_init(table);
+}
@@ -3,8 +3,18 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>  // size_t
 #include <stdint.h>  // uint32_t
 
+// Hash
+
+// FNV-1a
+#define HASH_OFFSET_BASIS  (0xcbf29ce484222325ULL)
+#define HASH_PRIME         (0x100000001b3ULL)
+
+uint64_t hash_bytes(uint64_t hash, const void *data, size_t size);
+uint32_t hash_uint64(uint64_t x);  // Mix bits, for integer or pointer keys.
+
 // Name
 
 typedef struct Name {
@@ -40,3 +50,17 @@ bool table_try_get(Table *table, const Name *key, void **output);
 bool table_put(Table *table, const Name *key, void *value);
 bool table_delete(Table *table, const Name *key);
 int table_iterate(Table *table, int iterator, const Name **name, void **value);  // -1 => end
+
+// Pointer Table: open addressing keyed by non-NULL pointers.
+
+typedef struct PtrTable {
+  const void **keys;
+  void **values;
+  int capacity;  // Power of 2.
+  int count;
+} PtrTable;
+
+void ptr_table_init(PtrTable *table);
+bool ptr_table_try_get(const PtrTable *table, const void *key, void **output);
+void ptr_table_put(PtrTable *table, const void *key, void *value);
+void ptr_table_release(PtrTable *table);
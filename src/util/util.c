@@ -8,10 +8,39 @@
 #include <stdlib.h>  // malloc
 #include <string.h>  // strcmp
 #include <sys/stat.h>
+#include <unistd.h>  // sysconf
 
 #include "../version.h"
 #include "table.h"
 
+// Self-hosted libc lacks mmap: the input is always read into a buffer.
+#if !defined(__XCC)
+#define USE_MMAP
+#include <sys/mman.h>
+#endif
+
+// Blocks are read past the terminator, which AddressSanitizer reports: scan byte by byte.
+#if defined(__SANITIZE_ADDRESS__)
+#define SCAN_BYTES
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define SCAN_BYTES
+#endif
+#endif
+
+// Scanning runs 16 bytes at a time with SSE2 or NEON, otherwise 8 bytes with SWAR.
+#if defined(SCAN_BYTES)
+// Byte by byte.
+#elif defined(__SSE2__)
+#define SCAN_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define SCAN_NEON
+#include <arm_neon.h>
+#elif !(defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define SCAN_SWAR
+#endif
+
 int isalnum_(int c) {
   return isalnum(c) || c == '_';
 }
@@ -126,38 +155,93 @@ ssize_t getline_chomp(char **lineptr, size_t *n, FILE *stream) {
   return len;
 }
 
-static ssize_t getline_cat(char **lineptr, size_t *n, FILE *stream, size_t curlen) {
-  char *nextline = NULL;
-  size_t capa = 0;
-  ssize_t len = getline_chomp(&nextline, &capa, stream);
-  if (len == -1)
-    return -1;
-  if (len > 0) {
-    char *oldline = *lineptr;
-    char *reallocated = realloc(oldline, curlen + len + 1);
-    if (reallocated == NULL)
-      return -1;
+// SourceInput
 
-    memcpy(reallocated + curlen, nextline, len + 1);
-    *lineptr = reallocated;
-    *n = curlen + len;  // '\0' is not included.
-    free(nextline);
+void open_source_input(SourceInput *input, FILE *fp) {
+#if defined(USE_MMAP)
+  // Lines are terminated in place, so the last one needs a byte after the content:
+  // it is zero-filled in the last page unless the size is a multiple of the page size.
+  struct stat st;
+  long page_size = sysconf(_SC_PAGESIZE);
+  if (fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && page_size > 0 &&
+      st.st_size % page_size != 0 && ftell(fp) == 0) {
+    void *p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(fp), 0);
+    if (p != MAP_FAILED) {
+      input->p = input->buf = p;
+      input->end = input->p + st.st_size;
+      input->mapped_size = st.st_size;
+      return;
+    }
   }
-  return curlen + len;
+#endif
+
+  size_t capa = 4096, size = 0;
+  char *buf = malloc_or_die(capa);
+  for (;;) {
+    if (capa - size <= 1) {
+      capa <<= 1;
+      buf = realloc_or_die(buf, capa);
+    }
+    size_t n = fread(buf + size, 1, capa - size - 1, fp);
+    if (n == 0)
+      break;
+    size += n;
+  }
+  set_source_input_string(input, buf, size);
 }
 
-ssize_t getline_cont(char **lineptr, size_t *capa, FILE *stream, int *plineno) {
+void set_source_input_string(SourceInput *input, char *str, size_t size) {
+  str[size] = '\0';
+  input->p = input->buf = str;
+  input->end = str + size;
+  input->mapped_size = 0;
+}
+
+void close_source_input(SourceInput *input) {
+#if defined(USE_MMAP)
+  if (input->mapped_size > 0) {
+    munmap(input->buf, input->mapped_size);
+    input->buf = NULL;
+    return;
+  }
+#endif
+  free(input->buf);
+  input->buf = NULL;
+}
+
+ssize_t source_getline(SourceInput *input, char **pline) {
+  char *line = input->p;
+  if (line == NULL || line >= input->end)
+    return -1;
+
+  char *q = memchr(line, '\n', input->end - line);
+  if (q == NULL)
+    q = input->end;
+  input->p = q < input->end ? q + 1 : q;
+  // Chomp CR(\r), LF(\n), CR+LF
+  if (q > line && q[-1] == '\r')
+    --q;
+  *q = '\0';
+  *pline = line;
+  return q - line;
+}
+
+ssize_t source_getline_cont(SourceInput *input, char **pline, int *plineno) {
   int lineno = *plineno;
-  ssize_t len = getline_chomp(lineptr, capa, stream);
+  char *line;
+  ssize_t len = source_getline(input, &line);
   if (len != -1) {
-    // Continue line.
-    while (++lineno, len > 0 && (*lineptr)[len - 1] == '\\') {
-      (*lineptr)[--len] = '\0';
-      ssize_t nextlen = getline_cat(lineptr, capa, stream, len);
+    // Continue line: following line is moved over the backslash, which always fits.
+    while (++lineno, len > 0 && line[len - 1] == '\\') {
+      line[--len] = '\0';
+      char *next;
+      ssize_t nextlen = source_getline(input, &next);
       if (nextlen == -1)
         break;
-      len = nextlen;
+      memmove(&line[len], next, nextlen + 1);
+      len += nextlen;
     }
+    *pline = line;
   }
   *plineno = lineno;
   return len;
@@ -317,7 +401,11 @@ void error(const char *fmt, ...) {
 }
 
 void show_error_line(const char *line, const char *p, int len) {
+  if (line == NULL)
+    return;
   fprintf(stderr, "%s\n", line);
+  if (p == NULL)
+    return;
   size_t pos = p - line;
   if (pos <= strlen(line)) {
     for (size_t i = 0; i < pos; ++i)
@@ -341,12 +429,189 @@ bool is_im32(int64_t x) {
   return x <= (((int64_t)1 << 31) - 1) && x >= -((int64_t)1 << 31);
 }
 
+// Scanning
+//
+// Each function returns the first byte to stop at in a NUL-terminated string. A block is loaded
+// from an aligned address, so it never crosses a page beyond the terminator, and the bytes before
+// the start in the first block are masked out. A stop mask has `SCAN_BITS` bits for each byte.
+
+#if defined(SCAN_SSE2) || defined(SCAN_NEON) || defined(SCAN_SWAR)
+#if defined(SCAN_SSE2)
+#define SCAN_BLOCK  (16)
+#define SCAN_BITS   (1)
+
+static inline __m128i in_range(__m128i v, char lo, char hi) {
+  __m128i t = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+  return _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(hi - lo)), t);
+}
+
+static inline uint64_t stop_mask(__m128i match) {
+  return ~_mm_movemask_epi8(match) & 0xffff;
+}
+
+static inline uint64_t stop_space(const char *p) {
+  __m128i v = _mm_load_si128((const __m128i*)p);
+  return stop_mask(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), in_range(v, '\t', '\r')));
+}
+
+static inline uint64_t stop_ident(const char *p) {
+  __m128i v = _mm_load_si128((const __m128i*)p);
+  __m128i alpha = in_range(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+  __m128i match = _mm_or_si128(_mm_or_si128(alpha, in_range(v, '0', '9')),
+                               _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+  return stop_mask(match);
+}
+
+static inline uint64_t stop_chars(const char *p, char c1, char c2, char c3) {
+  __m128i v = _mm_load_si128((const __m128i*)p);
+  __m128i match = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(c1)), _mm_cmpeq_epi8(v, _mm_set1_epi8(c2))),
+      _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(c3)), _mm_cmpeq_epi8(v, _mm_setzero_si128())));
+  return _mm_movemask_epi8(match);
+}
+
+#elif defined(SCAN_NEON)
+#define SCAN_BLOCK  (16)
+#define SCAN_BITS   (4)
+
+static inline uint8x16_t in_range(uint8x16_t v, uint8_t lo, uint8_t hi) {
+  return vcleq_u8(vsubq_u8(v, vdupq_n_u8(lo)), vdupq_n_u8(hi - lo));
+}
+
+// No movemask: narrow each byte to 4 bits.
+static inline uint64_t to_mask(uint8x16_t match) {
+  return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(match), 4)), 0);
+}
+
+static inline uint64_t stop_space(const char *p) {
+  uint8x16_t v = vld1q_u8((const uint8_t*)p);
+  return ~to_mask(vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')), in_range(v, '\t', '\r')));
+}
+
+static inline uint64_t stop_ident(const char *p) {
+  uint8x16_t v = vld1q_u8((const uint8_t*)p);
+  uint8x16_t alpha = in_range(vorrq_u8(v, vdupq_n_u8(0x20)), 'a', 'z');
+  uint8x16_t match = vorrq_u8(vorrq_u8(alpha, in_range(v, '0', '9')),
+                              vceqq_u8(v, vdupq_n_u8('_')));
+  return ~to_mask(match);
+}
+
+static inline uint64_t stop_chars(const char *p, char c1, char c2, char c3) {
+  uint8x16_t v = vld1q_u8((const uint8_t*)p);
+  uint8x16_t match = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8(c1)), vceqq_u8(v, vdupq_n_u8(c2))),
+                              vorrq_u8(vceqq_u8(v, vdupq_n_u8(c3)), vceqq_u8(v, vdupq_n_u8(0))));
+  return to_mask(match);
+}
+
+#else  // SCAN_SWAR
+#define SCAN_BLOCK  (8)
+#define SCAN_BITS   (8)
+#define SWAR_ONES   (0x0101010101010101ULL)
+#define SWAR_LOWS   (0x7f7f7f7f7f7f7f7fULL)
+#define SWAR_HIGHS  (0x8080808080808080ULL)
+
+// Results have the high bit of each matched byte, without carry from the lower byte.
+static inline uint64_t swar_zero(uint64_t w) {
+  return ~(((w & SWAR_LOWS) + SWAR_LOWS) | w) & SWAR_HIGHS;
+}
+
+static inline uint64_t swar_eq(uint64_t w, char c) {
+  return swar_zero(w ^ (SWAR_ONES * (unsigned char)c));
+}
+
+static inline uint64_t in_range(uint64_t w, char lo, char hi) {  // 0 < lo <= hi < 0x80
+  uint64_t x = w & SWAR_LOWS;
+  uint64_t ge_lo = x + SWAR_ONES * (0x80 - lo);
+  uint64_t gt_hi = x + SWAR_ONES * (0x7f - hi);
+  return ge_lo & ~gt_hi & ~w & SWAR_HIGHS;
+}
+
+static inline uint64_t load_word(const char *p) {
+  uint64_t w;
+  memcpy(&w, p, sizeof(w));
+  return w;
+}
+
+static inline uint64_t stop_space(const char *p) {
+  uint64_t w = load_word(p);
+  return ~(swar_eq(w, ' ') | in_range(w, '\t', '\r')) & SWAR_HIGHS;
+}
+
+static inline uint64_t stop_ident(const char *p) {
+  uint64_t w = load_word(p);
+  uint64_t match = in_range(w | SWAR_ONES * 0x20, 'a', 'z') | in_range(w, '0', '9') |
+                   swar_eq(w, '_');
+  return ~match & SWAR_HIGHS;
+}
+
+static inline uint64_t stop_chars(const char *p, char c1, char c2, char c3) {
+  uint64_t w = load_word(p);
+  return swar_eq(w, c1) | swar_eq(w, c2) | swar_eq(w, c3) | swar_zero(w);
+}
+#endif
+
+static inline int lowest_bit(uint64_t mask) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(mask);
+#else
+  int n = 0;
+  for (; (mask & 0xff) == 0; mask >>= 8)
+    n += 8;
+  for (; (mask & 1) == 0; mask >>= 1)
+    ++n;
+  return n;
+#endif
+}
+
+// Function body to return the first stop from `p`: `STOP` is the stop mask of the block at `q`.
+#define SCAN_BLOCKS(p, q, STOP) \
+  uintptr_t offset = (uintptr_t)(p) & (SCAN_BLOCK - 1); \
+  const char *q = (p) - offset; \
+  uint64_t mask = (STOP) & (~(uint64_t)0 << (offset * SCAN_BITS)); \
+  while (mask == 0) { \
+    q += SCAN_BLOCK; \
+    mask = (STOP); \
+  } \
+  return q + lowest_bit(mask) / SCAN_BITS
+
+const char *skip_whitespaces(const char *s) {
+  // Most runs are empty or one space.
+  if (!isspace(*s))
+    return s;
+  if (!isspace(*++s))
+    return s;
+  SCAN_BLOCKS(s + 1, q, stop_space(q));
+}
+
+const char *skip_ident_chars(const char *p) {
+  SCAN_BLOCKS(p, q, stop_ident(q));
+}
+
+const char *find_char3(const char *p, char c1, char c2, char c3) {
+  SCAN_BLOCKS(p, q, stop_chars(q, c1, c2, c3));
+}
+
+#else  // Byte by byte.
+
 const char *skip_whitespaces(const char *s) {
   while (isspace(*s))
     ++s;
   return s;
 }
 
+const char *skip_ident_chars(const char *p) {
+  while ((unsigned char)*p < 0x80 && isalnum_(*p))
+    ++p;
+  return p;
+}
+
+const char *find_char3(const char *p, char c1, char c2, char c3) {
+  for (char c; (c = *p) != '\0' && c != c1 && c != c2 && c != c3; ++p)
+    ;
+  return p;
+}
+#endif
+
 const char *block_comment_start(const char *p) {
   const char *q = skip_whitespaces(p);
   return (*q == '/' && q[1] == '*') ? q : NULL;
@@ -354,8 +619,8 @@ const char *block_comment_start(const char *p) {
 
 const char *block_comment_end(const char *p) {
   for (;;) {
-    p = strchr(p, '*');
-    if (p == NULL)
+    p = find_char3(p, '*', '*', '*');
+    if (*p == '\0')
       return NULL;
     if (*(++p) == '/')
       return p + 1;
@@ -559,6 +824,65 @@ void data_string(DataStorage *data, const void *str, size_t len) {
   data_append(data, (const unsigned char*)str, len);
 }
 
+// DataReader
+
+void data_reader_init(DataReader *reader, const void *buf, size_t size) {
+  reader->p = buf;
+  reader->end = reader->p + size;
+  reader->error = false;
+}
+
+uint64_t data_read_uleb128(DataReader *reader) {
+  uint64_t result = 0;
+  for (int shift = 0; ; shift += 7) {
+    if (reader->p >= reader->end) {
+      reader->error = true;
+      return 0;
+    }
+    unsigned char c = *reader->p++;
+    if (shift < 64)
+      result |= (uint64_t)(c & 0x7f) << shift;
+    if (!(c & 0x80))
+      return result;
+  }
+}
+
+int64_t data_read_leb128(DataReader *reader) {
+  uint64_t result = 0;
+  for (int shift = 0; ; shift += 7) {
+    if (reader->p >= reader->end) {
+      reader->error = true;
+      return 0;
+    }
+    unsigned char c = *reader->p++;
+    if (shift < 64)
+      result |= (uint64_t)(c & 0x7f) << shift;
+    if (!(c & 0x80)) {
+      if ((c & 0x40) && shift + 7 < 64)
+        result |= ~(uint64_t)0 << (shift + 7);  // Sign extend.
+      return result;
+    }
+  }
+}
+
+const void *data_read_bytes(DataReader *reader, size_t size) {
+  if ((size_t)(reader->end - reader->p) < size) {
+    reader->error = true;
+    reader->p = reader->end;
+    return NULL;
+  }
+  const void *p = reader->p;
+  reader->p += size;
+  return p;
+}
+
+const void *data_read_string(DataReader *reader, size_t *plen) {
+  size_t len = data_read_uleb128(reader);
+  const void *p = data_read_bytes(reader, len);
+  *plen = p != NULL ? len : 0;
+  return p;
+}
+
 void data_varint32(DataStorage *data, ssize_t pos, int64_t val) {
   unsigned char buf[5], *p = buf;
   for (int i = 0; i < 4; ++i) {
@@ -595,6 +919,62 @@ void data_close_chunk(DataStorage *data, ssize_t num) {
   data_uleb128(data, pos, num);
 }
 
+// Arena
+
+#define ARENA_CHUNK_SIZE  (64 * 1024)
+#define ARENA_ALIGN       (16)  // Same as malloc, for long double.
+
+struct ArenaChunk {
+  ArenaChunk *next;
+};
+
+void arena_init(Arena *arena) {
+  arena->chunks = NULL;
+  arena->ptr = arena->end = NULL;
+}
+
+void arena_release(Arena *arena) {
+  for (ArenaChunk *chunk = arena->chunks, *next; chunk != NULL; chunk = next) {
+    next = chunk->next;
+    free(chunk);
+  }
+  arena_init(arena);
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+  const size_t header = ALIGN(sizeof(ArenaChunk), ARENA_ALIGN);
+  size = ALIGN(size, ARENA_ALIGN);
+  if (arena->ptr == NULL || size > (size_t)(arena->end - arena->ptr)) {
+    if (size > ARENA_CHUNK_SIZE / 4) {
+      // Large object occupies its own chunk, and the current chunk is kept for following ones.
+      ArenaChunk *chunk = malloc_or_die(header + size);
+      if (arena->chunks != NULL) {
+        chunk->next = arena->chunks->next;
+        arena->chunks->next = chunk;
+      } else {
+        chunk->next = NULL;
+        arena->chunks = chunk;
+      }
+      return (char*)chunk + header;
+    }
+
+    ArenaChunk *chunk = malloc_or_die(ARENA_CHUNK_SIZE);
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    arena->ptr = (char*)chunk + header;
+    arena->end = (char*)chunk + ARENA_CHUNK_SIZE;
+  }
+  void *p = arena->ptr;
+  arena->ptr += size;
+  return p;
+}
+
+void *arena_calloc(Arena *arena, size_t size) {
+  void *p = arena_alloc(arena, size);
+  memset(p, 0, size);
+  return p;
+}
+
 // StringBuffer
 
 typedef struct {
@@ -652,53 +1032,46 @@ char *sb_join(StringBuffer *sb, const char *separator) {
   return str;
 }
 
-static const char *escape_hex(int c) {
-  char *s = malloc_or_die(5);
-  snprintf(s, 5, "\\x%02x", c & 0xff);
-  return s;
-}
-
-static const char *escape(int c) {
-  switch (c) {
-  case '\0': return "\\0";
-  case '\n': return "\\n";
-  case '\r': return "\\r";
-  case '\t': return "\\t";
-  case '"': return "\\\"";
-  case '\\': return "\\\\";
-  default:
-    if (c < 0x20 || c >= 0x7f)
-      return escape_hex(c);
-    return NULL;
+// `\x` takes all following hex digits, and `\0` following octal ones in assemblers,
+// so escape such digits, too.
+size_t escape_chars(const char *str, size_t size, char *dst) {
+  static const char kHexDigits[] = "0123456789abcdef";
+  char *q = dst;
+  int last = 0;  // Last escape: 'x' or '0'.
+  for (const char *p = str, *end = str + size; p < end; ++p) {
+    int c = *(unsigned char*)p;
+    char e;
+    switch (c) {
+    case '\0': e = '0'; break;
+    case '\n': e = 'n'; break;
+    case '\r': e = 'r'; break;
+    case '\t': e = 't'; break;
+    case '"': case '\\': e = c; break;
+    default:
+      if (c < 0x20 || c >= 0x7f || (last == 'x' && isxdigit(c)) ||
+          (last == '0' && c >= '0' && c <= '7')) {
+        *q++ = '\\';
+        *q++ = 'x';
+        *q++ = kHexDigits[c >> 4];
+        *q++ = kHexDigits[c & 15];
+        last = 'x';
+      } else {
+        *q++ = c;
+        last = 0;
+      }
+      continue;
+    }
+    *q++ = '\\';
+    *q++ = e;
+    last = e == '0' ? '0' : 0;
   }
+  return q - dst;
 }
 
 void escape_string(const char *str, size_t size, StringBuffer *sb) {
-  const char *s, *p;
-  const char *end = str + size;
-  bool hex = false;
-  for (s = p = str; p < end; ++p) {
-    const char *e;
-    if (hex && isxdigit(*p)) {
-      e = escape_hex(*p);
-    } else {
-      e = escape(*p);
-      if (e == NULL) {
-        hex = false;
-        continue;
-      }
-    }
-
-    if (p > s)
-      sb_append(sb, s, p);
-    sb_append(sb, e, NULL);
-    s = p + 1;
-    hex = e[1] == 'x';
-  }
-  if (p > s) {
-    assert(!hex);
-    sb_append(sb, s, p);
-  }
+  char *buf = malloc_or_die(size * 4 + 1);
+  size_t len = escape_chars(str, size, buf);
+  sb_append(sb, buf, buf + len);
 }
 
 // Optparse
@@ -34,7 +34,6 @@ void *calloc_or_die(size_t size);  // No `count` argument.
 void *realloc_or_die(void *ptr, size_t size);
 const Name *alloc_label(void);
 ssize_t getline_chomp(char **lineptr, size_t *n, FILE *stream);
-ssize_t getline_cont(char **lineptr, size_t *n, FILE *stream, int *plineno);
 bool is_fullpath(const char *filename);
 char *join_paths(const char *paths[]);
 #define JOIN_PATHS(...)  join_paths((const char*[]){__VA_ARGS__, NULL})
@@ -53,6 +52,8 @@ bool is_im8(int64_t x);
 bool is_im16(int64_t x);
 bool is_im32(int64_t x);
 const char *skip_whitespaces(const char *s);
+const char *skip_ident_chars(const char *p);  // [0-9A-Za-z_]*, stops at non-ASCII.
+const char *find_char3(const char *p, char c1, char c2, char c3);  // Or '\0'.
 const char *block_comment_start(const char *p);
 const char *block_comment_end(const char *p);
 int64_t wrap_value(int64_t value, int size, bool is_unsigned);
@@ -101,6 +102,53 @@ void data_close_chunk(DataStorage *data, ssize_t num);
 void data_varint32(DataStorage *data, ssize_t pos, int64_t val);
 void data_varuint32(DataStorage *data, ssize_t pos, uint64_t val);
 
+// DataReader: reads in place what DataStorage wrote.
+
+typedef struct DataReader {
+  const unsigned char *p;
+  const unsigned char *end;
+  bool error;  // Set when reading beyond the end, and zero is read after that.
+} DataReader;
+
+void data_reader_init(DataReader *reader, const void *buf, size_t size);
+uint64_t data_read_uleb128(DataReader *reader);
+int64_t data_read_leb128(DataReader *reader);
+const void *data_read_bytes(DataReader *reader, size_t size);
+const void *data_read_string(DataReader *reader, size_t *plen);  // Written by `data_string`.
+
+// Arena: bump-pointer allocator, whose objects are released at once.
+
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct Arena {
+  ArenaChunk *chunks;
+  char *ptr;
+  char *end;
+} Arena;
+
+void arena_init(Arena *arena);  // Zero-cleared arena is also valid.
+void arena_release(Arena *arena);
+void *arena_alloc(Arena *arena, size_t size);
+void *arena_calloc(Arena *arena, size_t size);
+
+// SourceInput: whole content of an input, split into lines in place.
+//
+// A regular file is mapped into memory privately, and others (pipes) are read into one buffer.
+// Returned lines are terminated in place and stay valid, so tokens can point into them.
+
+typedef struct SourceInput {
+  char *p;  // Start of the next line.
+  char *end;
+  char *buf;
+  size_t mapped_size;  // Non-zero if `buf` is mapped.
+} SourceInput;
+
+void open_source_input(SourceInput *input, FILE *fp);
+void close_source_input(SourceInput *input);  // Release the content from `open_source_input`.
+void set_source_input_string(SourceInput *input, char *str, size_t size);  // `str[size]` is written.
+ssize_t source_getline(SourceInput *input, char **pline);  // Chomp CR/LF.
+ssize_t source_getline_cont(SourceInput *input, char **pline, int *plineno);  // Join `\` lines.
+
 // StringBuffer
 
 typedef struct StringBuffer {
@@ -116,6 +164,7 @@ static inline void sb_prepend(StringBuffer *sb, const char *start, const char *e
 char *sb_join(StringBuffer *sb, const char *separator);
 static inline char *sb_to_string(StringBuffer *sb)  { return sb_join(sb, NULL); }
 
+size_t escape_chars(const char *str, size_t size, char *dst);  // `dst` needs `size * 4`.
 void escape_string(const char *str, size_t size, StringBuffer *sb);
 
 // Optparse
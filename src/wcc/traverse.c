@@ -490,6 +490,8 @@ static void traverse_initializer(Initializer *init) {
   case IK_BRKT:
     traverse_initializer(init->bracket.value);
     break;
+  case IK_EMBED:
+    break;
   }
 }
 
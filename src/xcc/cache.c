@@ -0,0 +1,204 @@
+#include "../config.h"
+#include "cache.h"
+
+#include <errno.h>
+#include <inttypes.h>  // PRIx64
+#include <stdlib.h>  // qsort
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>  // getpid
+
+#include "table.h"
+#include "util.h"
+
+// Self-hosted libc lacks directory access and rename: the cache is not available.
+#if !defined(__XCC)
+#define USE_COMPILE_CACHE
+#include <dirent.h>
+#include <sys/time.h>  // utimes
+#endif
+
+static const char *cache_dir;
+static uint64_t cache_max_size;
+static uint64_t cache_size;  // Known after eviction.
+static uint64_t base_hash = HASH_OFFSET_BASIS;
+static int hit_count, miss_count, store_count, evict_count;
+
+static bool copy_file(const char *src, const char *dst) {
+  FILE *ifp = fopen(src, "rb");
+  if (ifp == NULL)
+    return false;
+  FILE *ofp = fopen(dst, "wb");
+  if (ofp == NULL) {
+    fclose(ifp);
+    return false;
+  }
+
+  bool result = true;
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), ifp)) > 0) {
+    if (fwrite(buf, 1, n, ofp) != n) {
+      result = false;
+      break;
+    }
+  }
+  fclose(ifp);
+  if (fclose(ofp) != 0)
+    result = false;
+  return result;
+}
+
+bool init_compile_cache(const char *dir, uint64_t max_size) {
+#if defined(USE_COMPILE_CACHE)
+  struct stat st;
+  if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+    perror(dir);
+    return false;
+  }
+  if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+    fprintf(stderr, "Warning: compile cache is not a directory: %s\n", dir);
+    return false;
+  }
+  cache_dir = dir;
+  cache_max_size = max_size;
+  return true;
+#else
+  UNUSED(dir);
+  UNUSED(max_size);
+  fprintf(stderr, "Warning: compile cache is not supported\n");
+  return false;
+#endif
+}
+
+void cache_add_key(const char *str) {
+  // Include the terminator to separate keys.
+  base_hash = hash_bytes(base_hash, str, strlen(str) + 1);
+}
+
+void cache_add_file_key(const char *path) {
+  cache_add_key(path);
+  struct stat st;
+  if (stat(path, &st) == 0) {
+    uint64_t id[2] = {st.st_size, st.st_mtime};
+    base_hash = hash_bytes(base_hash, id, sizeof(id));
+  }
+}
+
+char *cache_entry_path(const char *ppfn) {
+  FILE *fp = fopen(ppfn, "rb");
+  if (fp == NULL)
+    return NULL;
+
+  uint64_t hash = base_hash;
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+    hash = hash_bytes(hash, buf, n);
+  fclose(fp);
+
+  char name[sizeof(hash) * 2 + 3];
+  snprintf(name, sizeof(name), "%016" PRIx64 ".o", hash);
+  return JOIN_PATHS(cache_dir, name);
+}
+
+bool cache_fetch(const char *entry, const char *objfn) {
+  if (entry != NULL && copy_file(entry, objfn)) {
+    ++hit_count;
+#if defined(USE_COMPILE_CACHE)
+    utimes(entry, NULL);  // Mark as recently used.
+#endif
+    return true;
+  }
+  ++miss_count;
+  return false;
+}
+
+void cache_store(const char *entry, const char *objfn) {
+#if defined(USE_COMPILE_CACHE)
+  // Write to a temporary file and rename it, not to expose an incomplete entry.
+  size_t size = strlen(entry) + 32;
+  char *tmp = malloc_or_die(size);
+  snprintf(tmp, size, "%s.tmp%d", entry, (int)getpid());
+  if (copy_file(objfn, tmp) && rename(tmp, entry) == 0)
+    ++store_count;
+  else
+    remove(tmp);
+  free(tmp);
+#else
+  UNUSED(entry);
+  UNUSED(objfn);
+#endif
+}
+
+#if defined(USE_COMPILE_CACHE)
+typedef struct {
+  char *path;
+  uint64_t size;
+  time_t mtime;
+} CacheEntry;
+
+static int compare_entry_mtime(const void *pa, const void *pb) {
+  const CacheEntry *a = *(const CacheEntry**)pa;
+  const CacheEntry *b = *(const CacheEntry**)pb;
+  return a->mtime < b->mtime ? -1 : a->mtime > b->mtime ? 1 : 0;
+}
+#endif
+
+void cache_evict(void) {
+#if defined(USE_COMPILE_CACHE)
+  if (store_count == 0)
+    return;  // Size increases only by store.
+
+  DIR *dir = opendir(cache_dir);
+  if (dir == NULL)
+    return;
+  Vector *entries = new_vector();
+  uint64_t total = 0;
+  for (struct dirent *de; (de = readdir(dir)) != NULL; ) {
+    if (strcmp(get_ext(de->d_name), "o") != 0)
+      continue;
+    char *path = JOIN_PATHS(cache_dir, de->d_name);
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+      free(path);
+      continue;
+    }
+    CacheEntry *e = malloc_or_die(sizeof(*e));
+    e->path = path;
+    e->size = st.st_size;
+    e->mtime = st.st_mtime;
+    vec_push(entries, e);
+    total += e->size;
+  }
+  closedir(dir);
+
+  if (total > cache_max_size) {
+    qsort(entries->data, entries->len, sizeof(*entries->data), compare_entry_mtime);
+    for (int i = 0; i < entries->len && total > cache_max_size; ++i) {
+      CacheEntry *e = entries->data[i];
+      if (remove(e->path) == 0) {
+        total -= e->size;
+        ++evict_count;
+      }
+    }
+  }
+  cache_size = total;
+
+  for (int i = 0; i < entries->len; ++i) {
+    CacheEntry *e = entries->data[i];
+    free(e->path);
+    free(e);
+  }
+  free_vector(entries);
+#endif
+}
+
+void cache_report(FILE *fp) {
+  fprintf(fp, "Compile cache: %d hits, %d misses, %d stored, %d evicted", hit_count, miss_count,
+          store_count, evict_count);
+  if (store_count > 0)
+    fprintf(fp, ", %" PRIu64 "/%" PRIu64 " bytes", cache_size, cache_max_size);
+  fprintf(fp, "\n");
+}
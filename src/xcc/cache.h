@@ -0,0 +1,20 @@
+// Compile cache
+//
+// Object files are stored under the cache directory, keyed by the hash of
+// the preprocessed source, the compile options and the compiler binaries.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>  // uint64_t
+#include <stdio.h>  // FILE
+
+bool init_compile_cache(const char *dir, uint64_t max_size);  // false if unavailable.
+void cache_add_key(const char *str);
+void cache_add_file_key(const char *path);  // Identity of the file: size and modified time.
+
+char *cache_entry_path(const char *ppfn);  // Entry for the preprocessed file.
+bool cache_fetch(const char *entry, const char *objfn);
+void cache_store(const char *entry, const char *objfn);
+void cache_evict(void);  // Remove least recently used entries to fit in the size limit.
+void cache_report(FILE *fp);
@@ -14,6 +14,8 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include "cache.h"
+#include "report.h"
 #include "util.h"
 
   // Hack: AT_REMOVEDIR defined in riscv-gnu-toolchain differs on MacOS and Linux?
@@ -21,6 +23,8 @@
 #define __AT_REMOVEDIR  0x080
 #endif
 
+#define MAX_JOBS  256  // Upper limit for -j.
+
 static pid_t fork1(void) {
   pid_t pid = fork();
   if (pid < 0)
@@ -28,18 +32,6 @@ static pid_t fork1(void) {
   return pid;
 }
 
-static int wait_process(pid_t pid) {
-  int status = -1;
-  if (waitpid(pid, &status, 0) < 0)
-    error("wait failed");
-  return status;
-}
-
-static pid_t wait_child(int *status) {
-  *status = -1;
-  return waitpid(0, status, 0);
-}
-
 // command > ofd
 static pid_t exec_with_ofd(char **command, int ofd) {
   pid_t pid = fork1();
@@ -94,50 +86,109 @@ static void remove_tmp_files(void) {
   }
 }
 
-static int compile(const char *src, Vector *cpp_cmd, Vector *cc1_cmd, int ofd) {
-  int ofd2 = ofd;
-  int cc_fd[2];
-  pid_t cc_pid = -1;
-  int running = 0;
-  if (cc1_cmd != NULL) {
-    cc_pid = pipe_exec((char**)cc1_cmd->data, ofd, cc_fd);
-    ofd2 = cc_fd[1];
-    ++running;
+// Job: processes for one source file (cpp | cc1 | as), run concurrently with other jobs.
+
+enum JobStage {
+  JS_CPP,
+  JS_CC1,
+  JS_AS,
+  JS_COUNT,
+};
+
+typedef struct Job {
+  pid_t pids[JS_COUNT];  // -1 if not running.
+  int status;
+  bool killed;
+  const char *ofn;  // Removed when the job fails.
+  const char *objfn;
+  const char *cache_entry;  // Object file is stored to the cache when the job succeeds.
+  // Called when the job succeeds, and returns the job to continue with in its slot, or NULL.
+  struct Job *(*resume)(struct Job *job);
+  void *resume_data;
+} Job;
+
+static Job *new_job(const char *ofn) {
+  Job *job = calloc_or_die(sizeof(*job));
+  for (int i = 0; i < JS_COUNT; ++i)
+    job->pids[i] = -1;
+  job->killed = false;
+  job->ofn = ofn;
+  job->objfn = NULL;
+  job->cache_entry = NULL;
+  job->resume = NULL;
+  job->resume_data = NULL;
+  return job;
+}
+
+static bool is_job_running(Job *job) {
+  for (int i = 0; i < JS_COUNT; ++i) {
+    if (job->pids[i] != -1)
+      return true;
   }
+  return false;
+}
 
-  // When src is NULL, no input file is given and cpp read from stdin.
-  cpp_cmd->data[cpp_cmd->len - 2] = strcmp(src, "-") == 0 ? NULL : (void*)src;
-  pid_t cpp_pid = exec_with_ofd((char**)cpp_cmd->data, ofd2);
-  ++running;
+static void kill_job(Job *job) {
+  job->killed = true;
+  for (int i = 0; i < JS_COUNT; ++i) {
+    if (job->pids[i] != -1)
+      kill(job->pids[i], SIGKILL);
+  }
+}
 
-  int res = 0;
-  for (; running > 0; --running) {
-    int status;
-    pid_t done = wait_child(&status);  // cpp or cc1
-    if (done > 0) {
-      res |= status;
-      if (done == cpp_pid) {
-        cpp_pid = -1;
-        if (cc_pid != -1) {
-          if (status != 0) {
-            // Illegal: cpp exit with failure.
-            kill(cc_pid, SIGKILL);
-            break;
-          }
-          close(cc_fd[0]);
-          close(cc_fd[1]);
-        }
-      } else if (done == cc_pid) {
-        cc_pid = -1;
-        if (cpp_pid != -1) {
-          // Illegal: cc dies earlier than cpp.
-          kill(cpp_pid, SIGKILL);
-          break;
-        }
+// Wait for any child process, and return the job if all of its processes are finished.
+static Job *wait_job(Vector *jobs) {
+  int status = -1;
+  pid_t pid = waitpid(-1, &status, 0);
+  if (pid < 0)
+    error("wait failed");
+
+  for (int i = 0; i < jobs->len; ++i) {
+    Job *job = jobs->data[i];
+    for (int j = 0; j < JS_COUNT; ++j) {
+      if (job->pids[j] != pid)
+        continue;
+
+      job->pids[j] = -1;
+      if (status != 0) {
+        // Failure in the pipeline: remaining processes would get incomplete input.
+        job->status |= status;
+        kill_job(job);
       }
-    } else {
-      res |= 1;
+      if (is_job_running(job))
+        return NULL;
+
+      vec_remove_at(jobs, i);
+      if (job->status != 0 && job->ofn != NULL)
+        remove(job->ofn);
+      return job;
+    }
+  }
+  return NULL;
+}
+
+// Wait until the number of running jobs becomes less than or equal to `max_running`.
+// On the first failure, kill all other jobs and wait for them.
+static int wait_jobs(Vector *jobs, int max_running) {
+  int res = 0;
+  while (jobs->len > max_running) {
+    Job *job = wait_job(jobs);
+    if (job == NULL)
+      continue;
+    if (job->status != 0 && res == 0) {
+      res = 1;
+      for (int i = 0; i < jobs->len; ++i)
+        kill_job(jobs->data[i]);
+      max_running = 0;
     }
+    if (job->status == 0 && job->cache_entry != NULL)
+      cache_store(job->cache_entry, job->objfn);
+    if (job->status == 0 && !job->killed && job->resume != NULL) {
+      Job *next = job->resume(job);
+      if (next != NULL)
+        vec_push(jobs, next);
+    }
+    free(job);
   }
   return res;
 }
@@ -153,8 +204,25 @@ static void usage(FILE *fp) {
       "  -c                  Output object file\n"
       "  -S                  Output assembly code\n"
       "  -E                  Output preprocess result\n"
+      "  -x <language>       Source type (c, c-header, assembler)\n"
+      "  -MD                 Write dependencies into <output>.d while compiling\n"
+      "  -MMD                Same as -MD, except system headers\n"
+      "  -MF <file>          Set dependency filename\n"
+      "  -MT <target>        Set target of dependency (Default: object file)\n"
+      "  -MP                 Add phony target for each header\n"
+      "  -O<level>           Optimization level (0, 1, 2)\n"
       "  -l <name>           Add library\n"
       "  -L <path>           Add library path\n"
+      "  -j <N>              Compile sources in N parallel jobs (Default: number of CPUs)\n"
+      "  -fno-integrated-cpp  Preprocess through external cpp\n"
+      "  -fbinary-tokens     Pass binary tokens from external cpp to cc1\n"
+      "  -fcache-dir=<dir>   Use compile cache in <dir> (Default: $XCC_CACHE_DIR)\n"
+      "  -fcache-stats       Show compile cache statistics\n"
+      "  -fno-integrated-as  Output object file through external assembler\n"
+      "  -ftime-report       Report time of each phase in all tools\n"
+      "  -fmem-report        Report peak memory of each phase in all tools\n"
+      "  -fpass=<name>       Enable optimization pass, -fno-pass=<name> to disable\n"
+      "  -fpass-stats        Show change statistics of each optimization pass\n"
   );
 }
 
@@ -165,59 +233,103 @@ enum OutType {
   OutExecutable,
 };
 
-static int compile_csource(const char *source_fn, enum OutType out_type, const char *ofn, int ofd,
-                           Vector *cpp_cmd, Vector *cc1_cmd, Vector *as_cmd, Vector *ld_cmd) {
-  const char *objfn = NULL;
-  int obj_fd = -1;
-  if (out_type > OutAssembly) {
-    if (ofn != NULL && out_type < OutExecutable) {
-      objfn = ofn;
-    } else {
-      char template[] = "/tmp/xcc-XXXXXX.o";
-      obj_fd = mkstemps(template, 2);
-      if (obj_fd == -1) {
-        perror("Failed to open output file");
-        exit(1);
-      }
-      objfn = strdup(template);
-      vec_push(&remove_on_exit, objfn);
-    }
+static const char *new_tmp_file(const char *ext) {
+  char template[32];
+  snprintf(template, sizeof(template), "/tmp/xcc-XXXXXX.%s", ext);
+  int fd = mkstemps(template, strlen(ext) + 1);
+  if (fd == -1) {
+    perror("Failed to open output file");
+    exit(1);
   }
+  close(fd);
+  char *fn = strdup(template);
+  vec_push(&remove_on_exit, fn);
+  return fn;
+}
 
-  int as_fd[2];
-  pid_t as_pid = -1;
+static const char *get_objfn(enum OutType out_type, const char *ofn) {
+  if (ofn != NULL && out_type < OutExecutable)
+    return ofn;
+  return new_tmp_file("o");
+}
 
-  if (out_type > OutAssembly) {
+// Start `cpp | cc1 | as` pipeline for a C source.
+// `objfn` is used when `out_type` is object file or executable, otherwise output goes to `ofd`.
+// `objfn` is added to `ld_cmd` for an executable, unless `ld_cmd` is NULL.
+// With `skip_cpp`, cc1 reads the source by itself: already preprocessed, or with -fintegrated-cpp.
+// With `integrated_as`, cc1 outputs the object file directly and `as` is not used.
+static Job *compile_csource(const char *source_fn, enum OutType out_type, const char *objfn,
+                            int ofd, Vector *cpp_cmd, Vector *cc1_cmd, Vector *as_cmd,
+                            Vector *ld_cmd, bool skip_cpp, bool integrated_as) {
+  Job *job = new_job(out_type == OutObject ? objfn : NULL);
+  job->objfn = objfn;
+
+  // Pipe fds are closed in this process right after the child is forked,
+  // so that they are not inherited by other jobs and each reader gets EOF.
+  int pipe_ofd = -1;
+  if (out_type > OutAssembly && integrated_as) {
+    assert(cc1_cmd->len >= 4);
+    cc1_cmd->data[cc1_cmd->len - 3] = (void*)objfn;  // Overwrite output filename.
+  } else if (out_type > OutAssembly) {
+    int as_fd[2];
     assert(as_cmd->len >= 3);
     as_cmd->data[as_cmd->len - 3] = (void*)objfn;  // Overwrite output filename.
     as_cmd->data[as_cmd->len - 2] = "-";  // Overwrite source filename.
-    as_pid = pipe_exec((char**)as_cmd->data, -1, as_fd);
-    ofd = as_fd[1];
+    job->pids[JS_AS] = pipe_exec((char**)as_cmd->data, -1, as_fd);
+    close(as_fd[0]);
+    ofd = pipe_ofd = as_fd[1];
   }
 
-  int res = compile(source_fn, cpp_cmd, out_type == OutPreprocess ? NULL : cc1_cmd, ofd);
+  if (out_type != OutPreprocess && skip_cpp) {
+    cc1_cmd->data[cc1_cmd->len - 2] = (void*)source_fn;  // Overwrite source filename.
+    job->pids[JS_CC1] = exec_with_ofd((char**)cc1_cmd->data, ofd);
+  } else {
+    if (out_type != OutPreprocess) {
+      int cc_fd[2];
+      job->pids[JS_CC1] = pipe_exec((char**)cc1_cmd->data, ofd, cc_fd);
+      close(cc_fd[0]);
+      if (pipe_ofd != -1)
+        close(pipe_ofd);
+      ofd = pipe_ofd = cc_fd[1];
+    }
 
-  if (out_type >= OutExecutable)
+    // When src is NULL, no input file is given and cpp read from stdin.
+    cpp_cmd->data[cpp_cmd->len - 2] = strcmp(source_fn, "-") == 0 ? NULL : (void*)source_fn;
+    job->pids[JS_CPP] = exec_with_ofd((char**)cpp_cmd->data, ofd);
+  }
+  if (pipe_ofd != -1)
+    close(pipe_ofd);
+
+  if (out_type >= OutExecutable && ld_cmd != NULL)
     vec_push(ld_cmd, objfn);
+  return job;
+}
 
-  if (res != 0 && as_pid != -1) {
-    kill(as_pid, SIGKILL);
-    remove(ofn);
-  }
-  if (as_pid != -1) {
-    close(as_fd[0]);
-    close(as_fd[1]);
-    as_pid = -1;
-    res |= wait_process(as_pid);
-  }
-  if (obj_fd != -1) {
-    close(obj_fd);
+// Precompile a header into `ofn`, or `<header>.pch` next to it, which `#include` reads instead.
+static Job *compile_header(const char *source_fn, const char *ofn, Vector *cpp_cmd,
+                           Vector *cc1_cmd) {
+  Vector *cmd = new_vector();
+  vec_push(cmd, cc1_cmd->data[0]);
+  vec_push(cmd, "-x");
+  vec_push(cmd, "c-header");
+  vec_push(cmd, "-fintegrated-cpp");
+  for (int i = 1; i < cpp_cmd->len - 2; ++i)  // Except placeholder for source and terminator.
+    vec_push(cmd, cpp_cmd->data[i]);
+  if (ofn != NULL) {
+    vec_push(cmd, "-o");
+    vec_push(cmd, ofn);
   }
-  return res;
+  vec_push(cmd, source_fn);
+  vec_push(cmd, NULL);
+
+  Job *job = new_job(ofn);
+  job->pids[JS_CC1] = exec_with_ofd((char**)cmd->data, -1);
+  free_vector(cmd);
+  return job;
 }
 
-static int compile_asm(const char *source_fn, enum OutType out_type, const char *ofn, int ofd,
-                       Vector *as_cmd, Vector *ld_cmd) {
+static Job *compile_asm(const char *source_fn, enum OutType out_type, const char *ofn, int ofd,
+                        Vector *as_cmd, Vector *ld_cmd) {
   const char *objfn = NULL;
   if (out_type > OutAssembly) {
     if (ofn != NULL && out_type < OutExecutable) {
@@ -235,13 +347,37 @@ static int compile_asm(const char *source_fn, enum OutType out_type, const char
     as_cmd->data[as_cmd->len - 2] = (void*)source_fn;  // Overwrite source filename.
   }
 
-  int status = 0;
-  pid_t as_pid = exec_with_ofd((char**)as_cmd->data, ofd);
-  waitpid(as_pid, &status, 0);
+  Job *job = new_job(NULL);
+  job->pids[JS_AS] = exec_with_ofd((char**)as_cmd->data, ofd);
 
   if (out_type >= OutExecutable)
     vec_push(ld_cmd, objfn);
-  return status;
+  return job;
+}
+
+static uint64_t get_cache_max_size(void) {
+  uint64_t size = (uint64_t)1 << 30;  // Default: 1GiB
+  const char *str = getenv("XCC_CACHE_SIZE");
+  if (str != NULL && *str != '\0') {
+    char *p;
+    size = strtoull(str, &p, 10);
+    switch (*p) {
+    case 'G': case 'g':  size <<= 30; break;
+    case 'M': case 'm':  size <<= 20; break;
+    case 'K': case 'k':  size <<= 10; break;
+    default: break;
+    }
+  }
+  return size;
+}
+
+static int get_cpu_count(void) {
+#if defined(_SC_NPROCESSORS_ONLN)
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  if (n > 0)
+    return n;
+#endif
+  return 1;
 }
 
 static const char *get_exe_prefix(const char *path) {
@@ -269,6 +405,7 @@ enum SourceType {
   UnknownSource,
   Assembly,
   Clanguage,
+  CHeader,
   ObjectFile,
   ArchiveFile,
 };
@@ -283,8 +420,20 @@ typedef struct {
   const char *ofn;
   enum OutType out_type;
   enum SourceType src_type;
+  int jobs;  // Maximum number of sources compiled in parallel.
+  bool integrated_cpp;  // Preprocess in cc1.
+  bool binary_tokens;  // External cpp passes binary tokens to cc1.
+  bool integrated_as;  // Output object file directly from cc1.
+  const char *cache_dir;  // Compile cache is used if non-NULL.
+  bool cache_stats;
   bool nodefaultlibs, nostdlib, nostdinc;
   bool use_ld;
+  // Dependency file: Written by cpp, or cc1 with -fintegrated-cpp.
+  const char *depend;  // "-MD" or "-MMD", NULL if not written.
+  const char *dep_fn;  // -MF
+  Vector *dep_targets;  // -MT
+  bool dep_phony;  // -MP
+  int cpp_dep_index, cc1_dep_index;  // Placeholder for -MF in each command, or -1.
 } Options;
 
 static void parse_options(int argc, char *argv[], Options *opts) {
@@ -303,7 +452,11 @@ static void parse_options(int argc, char *argv[], Options *opts) {
     OPT_ANSI,
     OPT_STD,
     OPT_PEDANTIC,
+    OPT_MD,
     OPT_MMD,
+    OPT_MF,
+    OPT_MT,
+    OPT_MP,
     OPT_NO_PIE,
 
     OPT_SSA,
@@ -324,6 +477,7 @@ static void parse_options(int argc, char *argv[], Options *opts) {
     {"O", optional_argument},  // Optimization level
     {"l", required_argument},  // Library
     {"L", required_argument},  // Add library path
+    {"j", required_argument},  // Parallel jobs
     {"nodefaultlibs", no_argument, OPT_NODEFAULTLIBS},
     {"nostdlib", no_argument, OPT_NOSTDLIB},
     {"nostdinc", no_argument, OPT_NOSTDINC},
@@ -333,6 +487,11 @@ static void parse_options(int argc, char *argv[], Options *opts) {
     {"v", no_argument, OPT_VERSION},
     {"-version", no_argument, OPT_VERSION},
     {"dumpversion", no_argument, OPT_DUMP_VERSION},
+    {"MD", no_argument, OPT_MD},  // Output dependency file
+    {"MMD", no_argument, OPT_MMD},  // Output dependency file, except system headers
+    {"MF", required_argument, OPT_MF},  // Dependency filename
+    {"MT", required_argument, OPT_MT},  // Target of dependency
+    {"MP", no_argument, OPT_MP},  // Phony target for each header
 
     // Sub command
     {"f", optional_argument},
@@ -343,7 +502,6 @@ static void parse_options(int argc, char *argv[], Options *opts) {
     {"ansi", no_argument, OPT_ANSI},
     {"std", optional_argument, OPT_STD},
     {"pedantic", no_argument, OPT_PEDANTIC},
-    {"MMD", no_argument, OPT_MMD},
     {"no-pie", no_argument, OPT_NO_PIE},
 
     // Feature flag.
@@ -396,6 +554,19 @@ static void parse_options(int argc, char *argv[], Options *opts) {
     case 'C':
       vec_push(opts->cpp_cmd, "-C");
       break;
+    case OPT_MD:
+    case OPT_MMD:
+      opts->depend = argv[optind - 1];
+      break;
+    case OPT_MF:
+      opts->dep_fn = optarg;
+      break;
+    case OPT_MT:
+      vec_push(opts->dep_targets, optarg);
+      break;
+    case OPT_MP:
+      opts->dep_phony = true;
+      break;
     case 'o':
       opts->ofn = optarg;
       vec_push(opts->linker_options, "-o");
@@ -415,6 +586,8 @@ static void parse_options(int argc, char *argv[], Options *opts) {
     case 'x':
       if (strcmp(optarg, "c") == 0) {
         opts->src_type = Clanguage;
+      } else if (strcmp(optarg, "c-header") == 0) {
+        opts->src_type = CHeader;
       } else if (strcmp(optarg, "assembler") == 0) {
         opts->src_type = Assembly;
       } else {
@@ -464,6 +637,15 @@ static void parse_options(int argc, char *argv[], Options *opts) {
       vec_push(opts->ld_cmd, "-L");
       vec_push(opts->ld_cmd, optarg);
       break;
+    case 'j':
+      {
+        char *end;
+        long n = strtol(optarg, &end, 10);
+        if (end == optarg || *end != '\0' || n < 1)
+          error("invalid number of jobs: %s", optarg);
+        opts->jobs = MIN(n, MAX_JOBS);
+      }
+      break;
     case '?':
       if (strcmp(argv[optind - 1], "-") == 0) {
         if (opts->src_type == UnknownSource) {
@@ -493,6 +675,22 @@ static void parse_options(int argc, char *argv[], Options *opts) {
           fprintf(stderr, "extra argument required for '-fuse-ld");
         }
         opts->use_ld = true;
+      } else if (strncmp(optarg, "cache-dir=", 10) == 0) {
+        opts->cache_dir = &optarg[10];
+      } else if (strcmp(optarg, "cache-stats") == 0) {
+        opts->cache_stats = true;
+      } else if (parse_report_option(optarg)) {
+        // Handled in main.
+      } else if (strcmp(optarg, "integrated-cpp") == 0) {
+        opts->integrated_cpp = true;
+      } else if (strcmp(optarg, "no-integrated-cpp") == 0) {
+        opts->integrated_cpp = false;
+      } else if (strcmp(optarg, "binary-tokens") == 0) {
+        opts->binary_tokens = true;
+      } else if (strcmp(optarg, "integrated-as") == 0) {
+        opts->integrated_as = true;
+      } else if (strcmp(optarg, "no-integrated-as") == 0) {
+        opts->integrated_as = false;
       } else {
         const char *opt = argv[optind - 1];
         vec_push(opts->cc1_cmd, opt);
@@ -522,7 +720,6 @@ static void parse_options(int argc, char *argv[], Options *opts) {
     case OPT_ANSI:
     case OPT_STD:
     case OPT_PEDANTIC:
-    case OPT_MMD:
       // Silently ignored.
       vec_push(opts->linker_options, argv[optind - 1]);
       break;
@@ -534,10 +731,128 @@ static void parse_options(int argc, char *argv[], Options *opts) {
   }
 }
 
+// Push dependency options with placeholders filled for each source, and return the index of
+// the placeholder for -MF, followed by -MT if not given.
+static int push_dep_options(Vector *cmd, const Options *opts) {
+  vec_push(cmd, opts->depend);
+  if (opts->dep_phony)
+    vec_push(cmd, "-MP");
+  for (int i = 0; i < opts->dep_targets->len; ++i) {
+    vec_push(cmd, "-MT");
+    vec_push(cmd, opts->dep_targets->data[i]);
+  }
+  vec_push(cmd, "-MF");
+  vec_push(cmd, NULL);  // Placeholder for dependency filename.
+  int index = cmd->len - 1;
+  if (opts->dep_targets->len == 0) {
+    vec_push(cmd, "-MT");
+    vec_push(cmd, NULL);  // Placeholder for target.
+  }
+  return index;
+}
+
+// Name the dependency file after the output, or the source like `gcc -c`.
+// The target is the object file, or the precompiled header.
+static void set_dep_args(Options *opts, const char *src, const char *outfn, enum SourceType st) {
+  const char *base = src != NULL ? basename(strdup(src)) : "-";
+  const char *fn = opts->dep_fn;
+  if (fn == NULL) {
+    const char *ofn = opts->ofn;
+    bool named = ofn != NULL && strcmp(ofn, "-") != 0 &&
+                 (opts->out_type < OutExecutable || st == CHeader);
+    fn = change_ext(named ? ofn : base, "d");
+  }
+
+  const char *target;
+  if (st == CHeader) {
+    target = opts->ofn;
+    if (target == NULL) {
+      StringBuffer sb;
+      sb_init(&sb);
+      sb_append(&sb, src, NULL);
+      sb_append(&sb, ".pch", NULL);
+      target = sb_to_string(&sb);
+    }
+  } else {
+    target = opts->out_type == OutObject && outfn != NULL ? outfn : change_ext(base, "o");
+  }
+
+  int indices[] = {opts->cpp_dep_index, opts->cc1_dep_index};
+  Vector *cmds[] = {opts->cpp_cmd, opts->cc1_cmd};
+  for (int i = 0; i < 2; ++i) {
+    int index = indices[i];
+    if (index < 0)
+      continue;
+    cmds[i]->data[index] = (void*)fn;
+    if (opts->dep_targets->len == 0)
+      cmds[i]->data[index + 2] = (void*)target;
+  }
+}
+
+typedef struct {
+  Options *opts;
+  const char *ppfn;
+  const char *objfn;
+} CacheLookup;
+
+// Put the object file from the compile cache if exists.
+// Otherwise start compiling the preprocessed output, and store the result when succeeded.
+static Job *compile_preprocessed_cached(Job *pp_job) {
+  CacheLookup *lookup = pp_job->resume_data;
+  Options *opts = lookup->opts;
+  char *entry = cache_entry_path(lookup->ppfn);
+  Job *job = NULL;
+  if (cache_fetch(entry, lookup->objfn)) {
+    free(entry);
+  } else {
+    // Object file is already in the linker command.
+    job = compile_csource(lookup->ppfn, opts->out_type, lookup->objfn, STDOUT_FILENO,
+                          opts->cpp_cmd, opts->cc1_cmd, opts->as_cmd, NULL, true,
+                          opts->integrated_as);
+    job->cache_entry = entry;
+  }
+  free(lookup);
+  return job;
+}
+
+// Start preprocessing a C source as a job, which looks up the compile cache when finished.
+static Job *compile_csource_cached(const char *source_fn, const char *ofn, Options *opts) {
+  Vector *cpp_cmd = opts->cpp_cmd;
+  const char *ppfn = new_tmp_file("i");
+  int ppfd = open(ppfn, O_WRONLY | O_TRUNC);
+  if (ppfd == -1) {
+    perror("Failed to open output file");
+    exit(1);
+  }
+  cpp_cmd->data[cpp_cmd->len - 2] = strcmp(source_fn, "-") == 0 ? NULL : (void*)source_fn;
+  Job *job = new_job(NULL);
+  job->pids[JS_CPP] = exec_with_ofd((char**)cpp_cmd->data, ppfd);
+  close(ppfd);
+
+  CacheLookup *lookup = malloc_or_die(sizeof(*lookup));
+  lookup->opts = opts;
+  lookup->ppfn = ppfn;
+  lookup->objfn = get_objfn(opts->out_type, ofn);
+  job->resume = compile_preprocessed_cached;
+  job->resume_data = lookup;
+
+  // Keep the link order regardless of the order of completion.
+  if (opts->out_type >= OutExecutable)
+    vec_push(opts->ld_cmd, lookup->objfn);
+  return job;
+}
+
 static int do_compile(Options *opts, const char *root) {
   UNUSED(root);
-  int ofd = STDOUT_FILENO;
+  // Outputs to the same destination must not be interleaved.
+  int max_jobs = opts->jobs;
+  if (opts->out_type == OutPreprocess || (opts->out_type < OutExecutable && opts->ofn != NULL))
+    max_jobs = 1;
+
+  Vector jobs;
+  vec_init(&jobs);
   int res = 0;
+  bool has_link_input = false;  // Not only headers to precompile.
   for (int i = 0; i < opts->sources->len; ++i) {
     char *src = opts->sources->data[i];
     const char *outfn = opts->ofn;
@@ -548,6 +863,7 @@ static int do_compile(Options *opts, const char *root) {
         assert(src[1] == 'l');
         // Pass to the linker.
         vec_push(opts->ld_cmd, src);
+        has_link_input = true;
         continue;
       }
 
@@ -559,35 +875,65 @@ static int do_compile(Options *opts, const char *root) {
       }
     }
 
-    if (opts->out_type <= OutAssembly && outfn != NULL && strcmp(outfn, "-") != 0) {
-      close(STDOUT_FILENO);
-      ofd = open(outfn, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
-      if (ofd == -1) {
-        perror("Failed to open output file");
-        exit(1);
-      }
-    }
-
     enum SourceType st = opts->src_type;
     if (src != NULL) {
       char *ext = get_ext(src);
       if      (strcasecmp(ext, "c") == 0)  st = Clanguage;
+      else if (strcasecmp(ext, "h") == 0)  st = CHeader;
       else if (strcasecmp(ext, "s") == 0)  st = Assembly;
       else if (strcasecmp(ext, "o") == 0)  st = ObjectFile;
       else if (strcasecmp(ext, "a") == 0)  st = ArchiveFile;
     }
 
+    if (st == CHeader && opts->out_type == OutPreprocess)
+      st = Clanguage;
+    if (st == Clanguage || st == Assembly || st == CHeader) {
+      res = wait_jobs(&jobs, max_jobs - 1);
+      if (res != 0)
+        break;
+    }
+
+    if (st != CHeader)
+      has_link_input = true;
+    if (opts->depend != NULL && (st == Clanguage || (st == CHeader && src != NULL)))
+      set_dep_args(opts, src, outfn, st);
+
+    int ofd = STDOUT_FILENO;
+    if (opts->out_type <= OutAssembly && st != CHeader && outfn != NULL &&
+        strcmp(outfn, "-") != 0) {
+      ofd = open(outfn, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+      if (ofd == -1) {
+        perror("Failed to open output file");
+        exit(1);
+      }
+    }
+
+    Job *job = NULL;
     switch (st) {
     case UnknownSource:
       fprintf(stderr, "Unknown source type: %s\n", src);
       res = -1;
       break;
     case Clanguage:
-      res = compile_csource(src, opts->out_type, outfn, ofd, opts->cpp_cmd, opts->cc1_cmd,
-                            opts->as_cmd, opts->ld_cmd);
+      if (opts->cache_dir != NULL && opts->out_type > OutAssembly) {
+        job = compile_csource_cached(src, outfn, opts);
+        break;
+      }
+      job = compile_csource(src, opts->out_type,
+                            opts->out_type > OutAssembly ? get_objfn(opts->out_type, outfn) : NULL,
+                            ofd, opts->cpp_cmd, opts->cc1_cmd, opts->as_cmd, opts->ld_cmd,
+                            opts->integrated_cpp, opts->integrated_as);
+      break;
+    case CHeader:
+      if (src == NULL) {
+        fprintf(stderr, "Cannot precompile stdin\n");
+        res = -1;
+        break;
+      }
+      job = compile_header(src, opts->ofn, opts->cpp_cmd, opts->cc1_cmd);
       break;
     case Assembly:
-      res = compile_asm(src, opts->out_type, outfn, ofd, opts->as_cmd, opts->ld_cmd);
+      job = compile_asm(src, opts->out_type, outfn, ofd, opts->as_cmd, opts->ld_cmd);
       break;
     case ObjectFile:
     case ArchiveFile:
@@ -595,11 +941,27 @@ static int do_compile(Options *opts, const char *root) {
         vec_push(opts->ld_cmd, src);
       break;
     }
+    if (ofd != STDOUT_FILENO)
+      close(ofd);
+    if (job != NULL)
+      vec_push(&jobs, job);
     if (res != 0)
       break;
   }
 
-  if (res == 0 && opts->out_type >= OutExecutable) {
+  if (res != 0) {
+    for (int i = 0; i < jobs.len; ++i)
+      kill_job(jobs.data[i]);
+  }
+  res |= wait_jobs(&jobs, 0);
+
+  if (opts->cache_dir != NULL) {
+    cache_evict();
+    if (opts->cache_stats)
+      cache_report(stderr);
+  }
+
+  if (res == 0 && opts->out_type >= OutExecutable && has_link_input) {
     if (!opts->use_ld) {
 #if !defined(USE_SYS_LD)
       if (!opts->nostdlib) {
@@ -724,10 +1086,22 @@ int main(int argc, char *argv[]) {
     .ofn = NULL,
     .out_type = OutExecutable,
     .src_type = UnknownSource,
+    .jobs = get_cpu_count(),
+    .integrated_cpp = true,
+    .binary_tokens = false,
+    .integrated_as = true,
+    .cache_dir = NULL,
+    .cache_stats = false,
     .nodefaultlibs = false,
     .nostdlib = false,
     .nostdinc = false,
     .use_ld = false,
+    .depend = NULL,
+    .dep_fn = NULL,
+    .dep_targets = new_vector(),
+    .dep_phony = false,
+    .cpp_dep_index = -1,
+    .cc1_dep_index = -1,
   };
   parse_options(argc, argv, &opts);
 
@@ -742,9 +1116,62 @@ int main(int argc, char *argv[]) {
     vec_push(cpp_cmd, JOIN_PATHS(root, "include"));
   }
 
+  if (opts.cache_dir == NULL)
+    opts.cache_dir = getenv("XCC_CACHE_DIR");
+  if (opts.cache_dir != NULL && *opts.cache_dir != '\0' && opts.out_type > OutAssembly &&
+      init_compile_cache(opts.cache_dir, get_cache_max_size())) {
+    // Cache key needs the preprocessed output, so cpp runs separately.
+    opts.integrated_cpp = false;
+    cache_add_file_key(cc1_path);
+    cache_add_file_key(as_path);
+    for (int i = 1; i < cc1_cmd->len; ++i)
+      cache_add_key(cc1_cmd->data[i]);
+  } else {
+    opts.cache_dir = NULL;
+  }
+
+  if (opts.integrated_cpp && opts.out_type > OutPreprocess) {
+    // Pass preprocessor options to cc1.
+    vec_push(cc1_cmd, "-fintegrated-cpp");
+    for (int i = 1; i < cpp_cmd->len; ++i)
+      vec_push(cc1_cmd, cpp_cmd->data[i]);
+    if (opts.depend != NULL)
+      opts.cc1_dep_index = push_dep_options(cc1_cmd, &opts);
+  } else if (opts.binary_tokens && opts.out_type > OutPreprocess) {
+    vec_push(cpp_cmd, "-fbinary-tokens");
+  }
+
+  // Each tool appends its records to the file, and they are aggregated at the end.
+  // Records hold both time and memory, so one option is enough.
+  const char *report_fn = NULL;
+  if (report_flags != 0) {
+    report_fn = new_tmp_file("txt");
+    StringBuffer sb;
+    sb_init(&sb);
+    sb_append(&sb, "-ftime-report=", NULL);
+    sb_append(&sb, report_fn, NULL);
+    char *report_opt = sb_to_string(&sb);
+    vec_push(cpp_cmd, report_opt);
+    vec_push(cc1_cmd, report_opt);
+#if !defined(USE_SYS_AS)
+    vec_push(as_cmd, report_opt);
+#endif
+#if !defined(USE_SYS_LD)
+    if (!opts.use_ld)
+      vec_push(ld_cmd, report_opt);
+#endif
+  }
+
+  if (opts.depend != NULL)
+    opts.cpp_dep_index = push_dep_options(cpp_cmd, &opts);
   vec_push(cpp_cmd, NULL);  // Buffer for src.
   vec_push(cpp_cmd, NULL);  // Terminator.
-  vec_push(cc1_cmd, "-");   // Read from cpp pipe.
+  if (opts.integrated_as && opts.out_type > OutAssembly) {
+    vec_push(cc1_cmd, "-fintegrated-as");
+    vec_push(cc1_cmd, "-o");
+    vec_push(cc1_cmd, NULL);  // Placeholder for output filename.
+  }
+  vec_push(cc1_cmd, "-");   // Read from cpp pipe, or placeholder for source filename.
   vec_push(cc1_cmd, NULL);  // Terminator.
   vec_push(as_cmd, "-o");
   vec_push(as_cmd, opts.ofn);
@@ -769,5 +1196,10 @@ int main(int argc, char *argv[]) {
 
   atexit(remove_tmp_files);
 
-  return do_compile(&opts, root);
+  int result = do_compile(&opts, root);
+  if (report_fn != NULL) {
+    merge_report_file(report_fn);
+    output_report("xcc");
+  }
+  return result;
 }
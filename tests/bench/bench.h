@@ -0,0 +1,34 @@
+// Common for benchmark kernels
+//
+// Each kernel prints its result to stdout, to be compared between compilers,
+// and elapsed time of the kernel to stderr as `time: <usec>`.
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>  // atoi
+#include <time.h>  // clock_gettime
+
+static long long bench_now(void) {
+  struct timespec ts;
+#if defined(CLOCK_MONOTONIC)
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+  clock_gettime(CLOCK_REALTIME, &ts);
+#endif
+  return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static long long bench_start_time;
+
+static inline void bench_start(void) {
+  bench_start_time = bench_now();
+}
+
+static inline void bench_end(void) {
+  fprintf(stderr, "time: %lld\n", bench_now() - bench_start_time);
+}
+
+static inline int bench_arg(int argc, char *argv[], int default_value) {
+  return argc > 1 ? atoi(argv[1]) : default_value;
+}
@@ -0,0 +1,58 @@
+// Binary trees: allocate and deallocate many trees
+
+#include "bench.h"
+
+typedef struct Node {
+  struct Node *left, *right;
+} Node;
+
+static Node *bottom_up_tree(int depth) {
+  Node *node = malloc(sizeof(*node));
+  if (depth > 0) {
+    node->left = bottom_up_tree(depth - 1);
+    node->right = bottom_up_tree(depth - 1);
+  } else {
+    node->left = node->right = NULL;
+  }
+  return node;
+}
+
+static int item_check(const Node *node) {
+  return node->left == NULL ? 1 : 1 + item_check(node->left) + item_check(node->right);
+}
+
+static void delete_tree(Node *node) {
+  if (node->left != NULL) {
+    delete_tree(node->left);
+    delete_tree(node->right);
+  }
+  free(node);
+}
+
+int main(int argc, char *argv[]) {
+  int max_depth = bench_arg(argc, argv, 16);
+  const int min_depth = 4;
+  if (max_depth < min_depth + 2)
+    max_depth = min_depth + 2;
+
+  bench_start();
+  Node *stretch = bottom_up_tree(max_depth + 1);
+  printf("stretch tree of depth %d\t check: %d\n", max_depth + 1, item_check(stretch));
+  delete_tree(stretch);
+
+  Node *long_lived = bottom_up_tree(max_depth);
+  for (int depth = min_depth; depth <= max_depth; depth += 2) {
+    int iterations = 1 << (max_depth - depth + min_depth);
+    int check = 0;
+    for (int i = 0; i < iterations; ++i) {
+      Node *tree = bottom_up_tree(depth);
+      check += item_check(tree);
+      delete_tree(tree);
+    }
+    printf("%d\t trees of depth %d\t check: %d\n", iterations, depth, check);
+  }
+  printf("long lived tree of depth %d\t check: %d\n", max_depth, item_check(long_lived));
+  delete_tree(long_lived);
+  bench_end();
+  return 0;
+}
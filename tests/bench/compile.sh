@@ -0,0 +1,195 @@
+#!/bin/bash
+# Compile throughput benchmark: `make bench-compile`
+#
+# Compiles each corpus with xcc, and reports lines/second, time and peak RSS per tool.
+# Results are written to $BENCH_OUT in JSON, and compared against $BENCH_BASELINE:
+# fails if throughput or peak RSS regresses more than $BENCH_THRESHOLD percent.
+# The baseline is created on the first run, and updated with BENCH_UPDATE=1.
+
+set -o pipefail
+
+BENCH_DIR=$(cd "$(dirname "$0")"; pwd)
+ROOT_DIR=$(cd "$BENCH_DIR/../.."; pwd)
+XCC=${XCC:-"$ROOT_DIR/xcc"}
+THIRDPARTY_DIR="$ROOT_DIR/tests/thirdparty/.external"
+BENCH_OUT=${BENCH_OUT:-"$BENCH_DIR/compile_result.json"}
+BENCH_BASELINE=${BENCH_BASELINE:-"$BENCH_DIR/compile_baseline.json"}
+BENCH_THRESHOLD=${BENCH_THRESHOLD:-10}  # %
+BENCH_REPEAT=${BENCH_REPEAT:-3}  # Best of.
+BENCH_CFLAGS=${BENCH_CFLAGS:-}  # e.g. -fno-integrated-cpp -fno-integrated-as to see each tool.
+
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "$WORK_DIR"' EXIT
+unset XCC_CACHE_DIR
+
+# Synthetic sources
+
+gen_huge_function() {
+  awk 'BEGIN {
+    print "int huge(int a, int b) {"
+    print "  int x = a, y = b;"
+    for (i = 0; i < 5000; ++i)
+      printf("  if (x > %d) y += x * %d; else x ^= y + %d;\n", i, i % 7 + 1, i)
+    print "  return x + y;"
+    print "}"
+  }'
+}
+
+gen_deep_macro() {
+  awk 'BEGIN {
+    print "#define M0(x)  ((x) + 1)"
+    for (i = 1; i < 100; ++i)
+      printf("#define M%d(x)  M%d((x) ^ %d)\n", i, i - 1, i)
+    for (i = 0; i < 200; ++i)
+      printf("int f%d(int a) { return M99(a); }\n", i)
+  }'
+}
+
+gen_large_initializer() {
+  awk 'BEGIN {
+    print "struct S { int a; const char *s; double d; };"
+    print "const int table[] = {"
+    for (i = 0; i < 200000; ++i)
+      printf("  %d,\n", (i * 2654435761) % 65536)
+    print "};"
+    print "struct S structs[] = {"
+    for (i = 0; i < 20000; ++i)
+      printf("  {%d, \"str%d\", %d.5},\n", i, i, i)
+    print "};"
+  }'
+}
+
+# Corpus: name, cflags, files
+
+CORPUS_NAMES=()
+CORPUS_FLAGS=()
+CORPUS_FILES=()
+
+add_corpus() {
+  CORPUS_NAMES+=("$1")
+  CORPUS_FLAGS+=("$2")
+  shift 2
+  CORPUS_FILES+=("$*")
+}
+
+setup_corpus() {
+  add_corpus self "-I$ROOT_DIR/src/util -I$ROOT_DIR/src/cc/frontend -I$ROOT_DIR/src/cc/backend \
+-I$ROOT_DIR/src/cc/arch/x64 -I$ROOT_DIR/src/as -I$ROOT_DIR/src/cpp -D_DEFAULT_SOURCE" \
+      "$ROOT_DIR"/src/cc/frontend/*.c "$ROOT_DIR"/src/cc/backend/*.c
+
+  gen_huge_function > "$WORK_DIR/huge_function.c"
+  add_corpus huge_function '' "$WORK_DIR/huge_function.c"
+  gen_deep_macro > "$WORK_DIR/deep_macro.c"
+  add_corpus deep_macro '' "$WORK_DIR/deep_macro.c"
+  gen_large_initializer > "$WORK_DIR/large_initializer.c"
+  add_corpus large_initializer '' "$WORK_DIR/large_initializer.c"
+
+  # Third party sources, cached by tests/thirdparty/*.sh
+  local dir="$THIRDPARTY_DIR/lua"
+  if [[ -f "$dir/lapi.c" ]]; then
+    add_corpus lua "-I$dir" $(ls "$dir"/l*.c | grep -v -e '/lua\.c$' -e '/luac\.c$' -e '/ltests\.c$')
+  else
+    echo "lua: skipped, run tests/thirdparty/lua.sh to cache"
+  fi
+  dir="$THIRDPARTY_DIR/sqlite"
+  if [[ -f "$dir/sqlite3.c" ]]; then
+    add_corpus sqlite "-I$dir" "$dir/sqlite3.c"
+  else
+    echo "sqlite: skipped, run tests/thirdparty/sqlite.sh to cache"
+  fi
+  dir="$THIRDPARTY_DIR/libpng"
+  if [[ -f "$dir/pnglibconf.h" ]]; then
+    add_corpus libpng "-I$dir" $(ls "$dir"/png*.c | grep -v -e '/pngtest\.c$')
+  else
+    echo "libpng: skipped, run tests/thirdparty/libpng.sh to cache"
+  fi
+}
+
+# Compile corpus once, and print `tool wall user maxrss` per tool (usec, KiB).
+compile_corpus() {
+  local flags="$1"
+  local files="$2"
+  local rec="$WORK_DIR/report.txt"
+  rm -f "$rec"
+  for src in $files; do
+    $XCC -c -o "$WORK_DIR/out.o" $flags $BENCH_CFLAGS -ftime-report="$rec" -fmem-report "$src" || return 1
+  done
+  awk -F '\t' '{
+    wall[$1] += $3; user[$1] += $4
+    if ($5 > rss[$1]) rss[$1] = $5
+  } END {
+    for (t in wall) print t, wall[t], user[t], rss[t]
+  }' "$rec" | sort
+}
+
+# Print the value of `key` for corpus `name` in a result file: one corpus per line.
+lookup() {
+  local file="$1" name="$2" key="$3"
+  grep "\"name\": \"$name\"" "$file" | sed -n "s/.*\"$key\": \([0-9]*\).*/\1/p" | head -n 1
+}
+
+run_bench() {
+  local failed=0
+  local lines_total=0
+  printf '%-20s%10s%12s%14s  %s\n' 'Corpus' 'Lines' 'Wall(ms)' 'Lines/sec' 'Tools: wall(ms)/peak RSS(KiB)'
+  echo '{' > "$BENCH_OUT"
+  echo '  "corpus": [' >> "$BENCH_OUT"
+  for ((i = 0; i < ${#CORPUS_NAMES[@]}; ++i)); do
+    local name=${CORPUS_NAMES[$i]}
+    local flags=${CORPUS_FLAGS[$i]}
+    local files=${CORPUS_FILES[$i]}
+    local lines
+    lines=$(cat $files | wc -l)
+
+    local best='' best_wall=0
+    for ((r = 0; r < BENCH_REPEAT; ++r)); do
+      local result
+      result=$(compile_corpus "$flags" "$files") || { echo "$name: compile failed"; return 1; }
+      local wall
+      wall=$(echo "$result" | awk '{s += $2} END {print s}')
+      if [[ -z "$best" || $wall -lt $best_wall ]]; then
+        best=$result
+        best_wall=$wall
+      fi
+    done
+
+    local lps=$((lines * 1000000 / (best_wall > 0 ? best_wall : 1)))
+    local maxrss
+    maxrss=$(echo "$best" | awk '{if ($4 > m) m = $4} END {print m + 0}')
+    local tools_text tools_json
+    tools_text=$(echo "$best" | awk '{printf("%s %d/%d ", $1, $2 / 1000, $4)}')
+    tools_json=$(echo "$best" | awk '{
+      printf("%s\"%s\": {\"wall_us\": %d, \"user_us\": %d, \"maxrss_kib\": %d}", NR > 1 ? ", " : "", $1, $2, $3, $4)
+    }')
+    printf '%-20s%10d%12d%14d  %s\n' "$name" "$lines" $((best_wall / 1000)) "$lps" "$tools_text"
+
+    local sep=','; [[ $((i + 1)) -lt ${#CORPUS_NAMES[@]} ]] || sep=''
+    echo "    {\"name\": \"$name\", \"lines\": $lines, \"wall_us\": $best_wall, \"lines_per_sec\": $lps, \"maxrss_kib\": $maxrss, \"tools\": {$tools_json}}$sep" >> "$BENCH_OUT"
+
+    if [[ -f "$BENCH_BASELINE" && -z "$BENCH_UPDATE" ]]; then
+      local base_lps base_rss
+      base_lps=$(lookup "$BENCH_BASELINE" "$name" lines_per_sec)
+      base_rss=$(lookup "$BENCH_BASELINE" "$name" maxrss_kib)
+      if [[ -n "$base_lps" && $((lps * 100)) -lt $((base_lps * (100 - BENCH_THRESHOLD))) ]]; then
+        echo "  REGRESSION: $name: $lps lines/sec, baseline $base_lps"
+        failed=1
+      fi
+      if [[ -n "$base_rss" && $((maxrss * 100)) -gt $((base_rss * (100 + BENCH_THRESHOLD))) ]]; then
+        echo "  REGRESSION: $name: peak RSS $maxrss KiB, baseline $base_rss KiB"
+        failed=1
+      fi
+    fi
+  done
+  echo '  ]' >> "$BENCH_OUT"
+  echo '}' >> "$BENCH_OUT"
+  echo "Result: $BENCH_OUT"
+
+  if [[ ! -f "$BENCH_BASELINE" || -n "$BENCH_UPDATE" ]]; then
+    cp "$BENCH_OUT" "$BENCH_BASELINE"
+    echo "Baseline updated: $BENCH_BASELINE"
+  fi
+  return $failed
+}
+
+setup_corpus
+run_bench
@@ -0,0 +1,54 @@
+// Fannkuch-redux: maximum flips of pancakes over permutations
+
+#include "bench.h"
+
+#define MAX_N  (16)
+
+int main(int argc, char *argv[]) {
+  int n = bench_arg(argc, argv, 10);
+  if (n > MAX_N)
+    n = MAX_N;
+  int perm[MAX_N], perm1[MAX_N], count[MAX_N];
+  int max_flips = 0, checksum = 0, perm_count = 0;
+
+  for (int i = 0; i < n; ++i)
+    perm1[i] = i;
+
+  bench_start();
+  int r = n;
+  for (;;) {
+    for (; r != 1; --r)
+      count[r - 1] = r;
+
+    for (int i = 0; i < n; ++i)
+      perm[i] = perm1[i];
+    int flips = 0;
+    for (int k; (k = perm[0]) != 0; ++flips) {
+      for (int i = 0, j = k; i < j; ++i, --j) {
+        int t = perm[i];
+        perm[i] = perm[j];
+        perm[j] = t;
+      }
+    }
+    if (flips > max_flips)
+      max_flips = flips;
+    checksum += perm_count % 2 == 0 ? flips : -flips;
+
+    // Next permutation.
+    for (;;) {
+      if (r == n) {
+        bench_end();
+        printf("%d\nPfannkuchen(%d) = %d\n", checksum, n, max_flips);
+        return 0;
+      }
+      int perm0 = perm1[0];
+      for (int i = 0; i < r; ++i)
+        perm1[i] = perm1[i + 1];
+      perm1[r] = perm0;
+      if (--count[r] > 0)
+        break;
+      ++r;
+    }
+    ++perm_count;
+  }
+}
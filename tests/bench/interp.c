@@ -0,0 +1,57 @@
+// Bytecode interpreter loop
+
+#include "bench.h"
+
+enum Op {
+  PUSH, LOAD, STORE, ADD, SUB, MUL, MOD, LT, JZ, JMP, DUP, POP, HALT,
+};
+
+typedef struct {
+  enum Op op;
+  int arg;
+} Inst;
+
+static long run(const Inst *code, long *vars) {
+  long stack[64];
+  int sp = 0;
+  for (const Inst *pc = code;; ++pc) {
+    switch (pc->op) {
+    case PUSH:  stack[sp++] = pc->arg; break;
+    case LOAD:  stack[sp++] = vars[pc->arg]; break;
+    case STORE: vars[pc->arg] = stack[--sp]; break;
+    case ADD:   --sp; stack[sp - 1] += stack[sp]; break;
+    case SUB:   --sp; stack[sp - 1] -= stack[sp]; break;
+    case MUL:   --sp; stack[sp - 1] *= stack[sp]; break;
+    case MOD:   --sp; stack[sp - 1] %= stack[sp]; break;
+    case LT:    --sp; stack[sp - 1] = stack[sp - 1] < stack[sp]; break;
+    case JZ:    if (stack[--sp] == 0) pc = &code[pc->arg - 1]; break;
+    case JMP:   pc = &code[pc->arg - 1]; break;
+    case DUP:   stack[sp] = stack[sp - 1]; ++sp; break;
+    case POP:   --sp; break;
+    case HALT:  return vars[1];
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int n = bench_arg(argc, argv, 50000000);
+  // i = 0; sum = 0; while (i < n) { sum = (sum + i * i) % 1000003; i = i + 1; }
+  enum { I, SUM, N };
+  const Inst code[] = {
+    /*  0 */ {PUSH, 0}, {STORE, I},
+    /*  2 */ {PUSH, 0}, {STORE, SUM},
+    /*  4 */ {LOAD, I}, {LOAD, N}, {LT, 0}, {JZ, 21},
+    /*  8 */ {LOAD, SUM}, {LOAD, I}, {DUP, 0}, {MUL, 0}, {ADD, 0}, {PUSH, 1000003}, {MOD, 0},
+    /* 15 */ {STORE, SUM},
+    /* 16 */ {LOAD, I}, {PUSH, 1}, {ADD, 0}, {STORE, I},
+    /* 20 */ {JMP, 4},
+    /* 21 */ {HALT, 0},
+  };
+  long vars[3] = {0, 0, n};
+
+  bench_start();
+  long result = run(code, vars);
+  bench_end();
+  printf("%ld\n", result);
+  return 0;
+}
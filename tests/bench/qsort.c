@@ -0,0 +1,33 @@
+// Sort random integers with qsort
+
+#include "bench.h"
+
+static int compare_int(const void *pa, const void *pb) {
+  int a = *(const int*)pa, b = *(const int*)pb;
+  return a < b ? -1 : a > b ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+  int n = bench_arg(argc, argv, 10000000);
+  int *array = malloc(sizeof(*array) * n);
+  unsigned int x = 1;
+  for (int i = 0; i < n; ++i) {
+    x = x * 1103515245 + 12345;
+    array[i] = (int)(x >> 1);
+  }
+
+  bench_start();
+  qsort(array, n, sizeof(*array), compare_int);
+  bench_end();
+
+  unsigned long checksum = 0;
+  for (int i = 0; i < n; ++i) {
+    if (i > 0 && array[i - 1] > array[i]) {
+      printf("not sorted at %d\n", i);
+      return 1;
+    }
+    checksum = checksum * 31 + array[i];
+  }
+  printf("%lu\n", checksum);
+  return 0;
+}
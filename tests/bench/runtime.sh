@@ -0,0 +1,68 @@
+#!/bin/bash
+# Runtime benchmark of generated code: `make bench-runtime`
+#
+# Builds each kernel with xcc at each -O level, with SSA toggled by -fpass=, and with the host
+# compiler at -O0 and -O2 as reference. Prints a table of kernel time in milliseconds,
+# measured by the kernel itself with clock_gettime, and writes it to $BENCH_OUT.
+# A result different from the host -O2 build is marked with `!`.
+
+set -o pipefail
+
+BENCH_DIR=$(cd "$(dirname "$0")"; pwd)
+ROOT_DIR=$(cd "$BENCH_DIR/../.."; pwd)
+XCC=${XCC:-"$ROOT_DIR/xcc"}
+HOST_CC=${HOST_CC:-cc}
+BENCH_OUT=${BENCH_OUT:-"$BENCH_DIR/runtime_result.md"}
+BENCH_KERNELS=${BENCH_KERNELS:-"nbody spectral_norm fannkuch binary_trees sha256 interp qsort"}
+
+CONFIG_NAMES=(O0 O0+ssa O1 O2 O2-ssa host-O0 host-O2)
+CONFIG_CCS=("$XCC" "$XCC" "$XCC" "$XCC" "$XCC" "$HOST_CC" "$HOST_CC")
+CONFIG_FLAGS=(-O0 '-O0 -fpass=ssa' -O1 -O2 '-O2 -fno-pass=ssa' -O0 -O2)
+REFERENCE=6  # host-O2
+
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+# Build and run kernel, and print `<time usec> <result file>`.
+run_kernel() {
+  local kernel="$1" index="$2"
+  local exe="$WORK_DIR/$kernel-$index"
+  local libm=''; [[ ${CONFIG_CCS[$index]} == "$HOST_CC" ]] && libm='-lm'
+  ${CONFIG_CCS[$index]} -o "$exe" ${CONFIG_FLAGS[$index]} "$BENCH_DIR/$kernel.c" $libm || return 1
+  "$exe" > "$exe.out" 2> "$exe.err" || return 1
+  sed -n 's/^time: //p' "$exe.err"
+}
+
+{
+  printf '| %-14s |' 'kernel (ms)'
+  for name in "${CONFIG_NAMES[@]}"; do printf ' %8s |' "$name"; done
+  printf '\n|%s|' '----------------'
+  for name in "${CONFIG_NAMES[@]}"; do printf '%s|' '----------'; done
+  printf '\n'
+} | tee "$BENCH_OUT"
+
+failed=0
+for kernel in $BENCH_KERNELS; do
+  times=()
+  for ((i = 0; i < ${#CONFIG_NAMES[@]}; ++i)); do
+    times[$i]=$(run_kernel "$kernel" $i) || times[$i]='error'
+  done
+
+  line=$(printf '| %-14s |' "$kernel")
+  ref="$WORK_DIR/$kernel-$REFERENCE.out"
+  for ((i = 0; i < ${#CONFIG_NAMES[@]}; ++i)); do
+    cell=${times[$i]}
+    if [[ "$cell" != 'error' ]]; then
+      cell=$((cell / 1000))
+      if ! cmp -s "$WORK_DIR/$kernel-$i.out" "$ref"; then
+        cell="!$cell"
+        failed=1
+      fi
+    else
+      failed=1
+    fi
+    line+=$(printf ' %8s |' "$cell")
+  done
+  echo "$line" | tee -a "$BENCH_OUT"
+done
+exit $failed
@@ -0,0 +1,130 @@
+// Lexer scanning micro-benchmark: `make bench-scan`
+//
+// Tokenizes the concatenated sources roughly like the lexers: whitespace runs, identifiers,
+// string literals and block comments, byte by byte and with the scanning functions in util.c.
+// Both must end up with the same counts.
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+#include "bench.h"
+
+typedef struct {
+  long spaces, idents, strings, comments, others;
+} Counts;
+
+static const char *byte_skip_whitespaces(const char *p) {
+  while (isspace((unsigned char)*p))
+    ++p;
+  return p;
+}
+
+static const char *byte_skip_ident_chars(const char *p) {
+  while (isalnum_((unsigned char)*p))
+    ++p;
+  return p;
+}
+
+static const char *byte_find_char3(const char *p, char c1, char c2, char c3) {
+  for (char c; (c = *p) != '\0' && c != c1 && c != c2 && c != c3; ++p)
+    ;
+  return p;
+}
+
+#define DEFINE_TOKENIZE(name, SKIP_WS, SKIP_IDENT, FIND3) \
+  static void name(const char *p, Counts *counts) { \
+    for (;;) { \
+      const char *q = SKIP_WS(p); \
+      counts->spaces += q > p; \
+      p = q; \
+      char c = *p; \
+      if (c == '\0') \
+        break; \
+      if (isalpha((unsigned char)c) || c == '_') { \
+        p = SKIP_IDENT(p + 1); \
+        ++counts->idents; \
+      } else if (c == '"') { \
+        for (++p; *(p = FIND3(p, '"', '\\', '\n')) == '\\'; p += p[1] != '\0' ? 2 : 1) \
+          ; \
+        p += *p != '\0'; \
+        ++counts->strings; \
+      } else if (c == '/' && p[1] == '*') { \
+        for (p += 2; *(p = FIND3(p, '*', '*', '*')) != '\0' && p[1] != '/'; ++p) \
+          ; \
+        p += *p != '\0' ? 2 : 0; \
+        ++counts->comments; \
+      } else { \
+        ++p; \
+        ++counts->others; \
+      } \
+    } \
+  }
+
+DEFINE_TOKENIZE(tokenize_bytes, byte_skip_whitespaces, byte_skip_ident_chars, byte_find_char3)
+DEFINE_TOKENIZE(tokenize_scan, skip_whitespaces, skip_ident_chars, find_char3)
+
+static char *read_all(int argc, char *argv[], size_t *psize) {
+  size_t size = 0, capa = 1 << 20;
+  char *buf = malloc_or_die(capa);
+  for (int i = 1; i < argc; ++i) {
+    FILE *fp = fopen(argv[i], "rb");
+    if (fp == NULL) {
+      perror(argv[i]);
+      exit(1);
+    }
+    for (size_t n; (n = fread(buf + size, 1, capa - size - 1, fp)) > 0; ) {
+      size += n;
+      if (size + 1 >= capa)
+        buf = realloc_or_die(buf, capa *= 2);
+    }
+    fclose(fp);
+  }
+  buf[size] = '\0';
+  *psize = size;
+  return buf;
+}
+
+static long long measure(void (*tokenize)(const char*, Counts*), const char *buf, int repeat,
+                         Counts *counts) {
+  long long best = -1;
+  for (int r = 0; r < repeat; ++r) {
+    memset(counts, 0, sizeof(*counts));
+    long long start = bench_now();
+    tokenize(buf, counts);
+    long long elapsed = bench_now() - start;
+    if (best < 0 || elapsed < best)
+      best = elapsed;
+  }
+  return best;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: scan <source>...\n");
+    return 1;
+  }
+  size_t size;
+  char *buf = read_all(argc, argv, &size);
+
+  enum { REPEAT = 10 };
+  Counts bytes, scan;
+  long long t_bytes = measure(tokenize_bytes, buf, REPEAT, &bytes);
+  long long t_scan = measure(tokenize_scan, buf, REPEAT, &scan);
+  if (memcmp(&bytes, &scan, sizeof(bytes)) != 0) {
+    fprintf(stderr, "Mismatch: idents %ld/%ld, strings %ld/%ld, comments %ld/%ld\n",
+            bytes.idents, scan.idents, bytes.strings, scan.strings, bytes.comments,
+            scan.comments);
+    return 1;
+  }
+
+  printf("%zu bytes, %ld identifiers, %ld strings, %ld comments\n", size, scan.idents,
+         scan.strings, scan.comments);
+  printf("%-12s%10s%12s\n", "", "Time(us)", "MB/sec");
+  printf("%-12s%10lld%12.1f\n", "byte", t_bytes, (double)size / (t_bytes > 0 ? t_bytes : 1));
+  printf("%-12s%10lld%12.1f\n", "scan", t_scan, (double)size / (t_scan > 0 ? t_scan : 1));
+  return 0;
+}
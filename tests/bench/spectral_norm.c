@@ -0,0 +1,55 @@
+// Spectral norm of an infinite matrix
+
+#include <math.h>
+#include "bench.h"
+
+static double eval_a(int i, int j) {
+  return 1.0 / ((i + j) * (i + j + 1) / 2 + i + 1);
+}
+
+static void mul_av(int n, const double *v, double *av) {
+  for (int i = 0; i < n; ++i) {
+    double sum = 0;
+    for (int j = 0; j < n; ++j)
+      sum += eval_a(i, j) * v[j];
+    av[i] = sum;
+  }
+}
+
+static void mul_atv(int n, const double *v, double *atv) {
+  for (int i = 0; i < n; ++i) {
+    double sum = 0;
+    for (int j = 0; j < n; ++j)
+      sum += eval_a(j, i) * v[j];
+    atv[i] = sum;
+  }
+}
+
+static void mul_atav(int n, const double *v, double *out, double *tmp) {
+  mul_av(n, v, tmp);
+  mul_atv(n, tmp, out);
+}
+
+int main(int argc, char *argv[]) {
+  int n = bench_arg(argc, argv, 2000);
+  double *u = malloc(sizeof(*u) * n);
+  double *v = malloc(sizeof(*v) * n);
+  double *tmp = malloc(sizeof(*tmp) * n);
+  for (int i = 0; i < n; ++i)
+    u[i] = 1;
+
+  bench_start();
+  for (int i = 0; i < 10; ++i) {
+    mul_atav(n, u, v, tmp);
+    mul_atav(n, v, u, tmp);
+  }
+  bench_end();
+
+  double vbv = 0, vv = 0;
+  for (int i = 0; i < n; ++i) {
+    vbv += u[i] * v[i];
+    vv += v[i] * v[i];
+  }
+  printf("%.9f\n", sqrt(vbv / vv));
+  return 0;
+}
@@ -29,6 +29,7 @@ function test_basic() {
   try_pp 'empty' '' "#define EMPTY\nEMPTY"
   try_pp '#undef' 'undefined' "#define FOO\n#undef FOO\n#ifdef FOO\ndefined\n#else\nundefined\n#endif"
   try_pp 'Param' '((1) + (2))' "#define ADD(x,y)  ((x) + (y))\nADD(1, 2)"
+  try_pp 'Func macro name before spaces' 'f +1' "#define f(x) (x)\n#define g(a, b) a b\ng(f, +1)"
 
   try_pp '#ifdef' 'x' "#define X\n#ifdef X\nx\n#else\ny\n#endif"
   try_pp '#ifdef else' 'y' "#ifdef X\nx\n#else\ny\n#endif"
@@ -203,6 +204,23 @@ function test_run() {
   echo -e "#include_next <tmp.h>\n#define FOO (29)" > tmp.h
   try_run "Include with include_next" 42 "#include <tmp.h>\nint main(){return FOO+BAR;}"  "-I . -I tmp_include"
 
+  # Include guard
+  echo -e "/* guard */\n#ifndef TMP_H\n#define TMP_H\n+ 1\n#endif  // TMP_H" > tmp.h
+  try_run 'Include guard' 2 "int main(){return 0\n#include \"tmp.h\"\n#include \"tmp.h\"\n#undef TMP_H\n#include \"tmp.h\"\n;}"
+  echo -e "#if !defined(TMP_H)\n#define TMP_H\n+ 1\n#else\n+ 10\n#endif" > tmp.h
+  try_run 'Include guard with else' 11 "int main(){return 0\n#include \"tmp.h\"\n#include \"tmp.h\"\n;}"
+  echo -e "#ifndef TMP_H\n#define TMP_H\n#endif\n+ 1" > tmp.h
+  try_run 'Include guard followed by token' 2 "int main(){return 0\n#include \"tmp.h\"\n#include \"tmp.h\"\n;}"
+
+  # Large expansion through nested variadic macros, and recursion stopped by hideset.
+  try_run 'Macro expansion stress' 11 "#define X1(...) __VA_ARGS__ + __VA_ARGS__\n#define X2(...) X1(X1(__VA_ARGS__))\n#define X4(...) X2(X2(__VA_ARGS__))\n#define X8(...) X4(X4(__VA_ARGS__))\n#define X16(...) X8(X8(__VA_ARGS__))\n#define f(x) (x + f)\nint f = 5;\nint main(void) { return X16(1) == 65536 ? f(f(1)) : 0; }"
+  try_pp 'Hideset' '2*9*g h(h(1) + 1) + h(1) + 1' "#define f(a) a*g\n#define g(a) f(a)\nf(2)(9)\n#define h(x) h(x) + x\nh(h(1))"
+
+  # Pragma once identifies the file, not the path.
+  echo -e "#pragma once\n+ 1" > tmp.h
+  ln -sf tmp.h tmp_link.h
+  try_run 'Pragma once' 1 "int main(){return 0\n#include \"tmp.h\"\n#include \"tmp_link.h\"\n#include \"tmp.h\"\n;}"
+
   end_test_suite
 }
 
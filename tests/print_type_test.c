@@ -107,4 +107,16 @@ TEST(print_type) {
   }
 }
 
+TEST(canonical_type) {
+  Type *charptr = ptrof(&tyChar);
+  EXPECT_TRUE(ptrof(&tyChar) == charptr);
+  EXPECT_TRUE(ptrof(&tyVoid) == &tyVoidPtr);
+  EXPECT_TRUE(ptrof(charptr) == ptrof(ptrof(&tyChar)));
+  Type *constptr = qualified_type(charptr, TQ_CONST);
+  EXPECT_TRUE(constptr != charptr);
+  EXPECT_TRUE(qualified_type(charptr, TQ_CONST) == constptr);
+  EXPECT_TRUE(qualified_type(&tyInt, TQ_CONST) == get_fixnum_type(FX_INT, false, TQ_CONST));
+  EXPECT_TRUE(array_to_ptr(arrayof(&tyChar, 3)) == charptr);
+}
+
 XTEST_MAIN();
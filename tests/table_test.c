@@ -32,4 +32,33 @@ TEST(table) {
   EXPECT_EQ(1, table.used);
 }
 
+TEST(ptr_table) {
+  static int objs[200];
+
+  PtrTable table;
+  ptr_table_init(&table);
+  EXPECT_FALSE(ptr_table_try_get(&table, &objs[0], NULL));
+
+  // Grows over the initial capacity.
+  for (int i = 0; i < 200; ++i)
+    ptr_table_put(&table, &objs[i], &objs[199 - i]);
+  EXPECT_EQ(200, table.count);
+  void *value = NULL;
+  EXPECT_TRUE(ptr_table_try_get(&table, &objs[3], &value));
+  EXPECT_PTREQ(&objs[196], value);
+
+  ptr_table_put(&table, &objs[3], NULL);
+  EXPECT_EQ(200, table.count);
+  EXPECT_TRUE(ptr_table_try_get(&table, &objs[3], &value));
+  EXPECT_NULL(value);
+
+  ptr_table_release(&table);
+  EXPECT_FALSE(ptr_table_try_get(&table, &objs[3], NULL));
+}
+
+TEST(hash_bytes) {
+  EXPECT_EQ(HASH_OFFSET_BASIS, hash_bytes(HASH_OFFSET_BASIS, "", 0));
+  EXPECT_EQ(0xaf63dc4c8601ec8cULL, hash_bytes(HASH_OFFSET_BASIS, "a", 1));  // FNV-1a 64 of "a".
+}
+
 XTEST_MAIN();
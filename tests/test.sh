@@ -106,6 +106,35 @@ function test_function() {
   end_test_suite
 }
 
+function test_inline() {
+  begin_test_suite "Inline"
+
+  # Small static functions are inlined at -O2, and dropped if no call remains.
+  local auto_inline='static int sq(int x) {return x * x;}
+    __attribute__((noinline)) static int twice(int x) {return x * 2;}
+    static int ref(int x) {return x + 1;}
+    int main(void) {int (*fp)(int) = ref; int s = 0; for (int i = 0; i < 4; ++i) s += sq(i) + twice(i) + ref(i); return s + fp(3);}'
+  XCC="$XCC -O2" try_asm 'auto inline' \
+    "! grep -q '^sq:' tmp_asm.s && grep -q '^twice:' tmp_asm.s && grep -q '^ref:' tmp_asm.s" \
+    "$auto_inline"
+  XCC="$XCC -O2" try_direct 'auto inline result' 40 "$auto_inline"
+
+  # Constant arguments are propagated into the inlined body, and dead branches are pruned.
+  local const_args='extern int slow(int);
+    static inline int pick(int flag, int x) {if (flag) return x + 1; return slow(x);}
+    static inline int sel(int kind, int x) {switch (kind) {case 0: return slow(x); case 1: x *= 2; /* Fallthrough */ case 2: return x - 3; default: return -x;}}
+    int f(int x) {return pick(1, x) + sel(1, x) + sel(2, x) + sel(5, x);}
+    int main(void) {return f(10) + pick(0, 0) + sel(0, 1);}
+    int slow(int x) {return x * 100;}'
+  try_asm 'inline const args' '[[ $(count_asm f main slow) -eq 0 ]]' "$const_args"
+  try_direct 'inline const args result' 125 "$const_args"
+  # Each use of the parameter gets its own literal, which a cast folds in place.
+  try_direct 'inline const arg in casts' 0 'static inline long f(int x) {return (short)x + (long)x;}
+    int main(void) {return f(70000) != 74464;}'
+
+  end_test_suite
+}
+
 function test_error() {
   begin_test_suite "Error"
 
@@ -183,6 +212,8 @@ function test_error() {
   compile_error 'unused static variable' 'int main(){ static int x = 0; x = 1; return 0; }'
   compile_error 'unused static global variable'    'static int s = 0; int g; int sub(){g=1; return 2;} int main(){ s = sub(); return g; }'
   try_direct 'unused static can run w/o -Werror' 1 'static int s = 0; int g; int sub(){g=1; return 2;} int main(){ s = sub(); return g; } //-WNOERR'
+  try_direct 'static used after assigned' 45 'static int s; void set(int x){s = x;} static int get(void){return s;} int main(){ set(45); return get(); }'
+  try_direct 'always_inline with static local' 2 '__attribute__((always_inline)) int count(void){static int n; return ++n;} int main(){ count(); return count(); }'
 
   compile_error 'enum and global' 'enum Foo { BAR }; int BAR; int main(){}'
   compile_error 'global and enum' 'int BAR; enum Foo { BAR }; int main(){}'
@@ -285,6 +316,123 @@ function test_link() {
   link_success 'weak function can be overridden' -DANS=22 tmp_link_weak1.c tmp_link_weak2.c
   link_success 'first weak function alive'       -DANS=11 tmp_link_weak1.c tmp_link_weak3.c
 
+  # Parallel compilation keeps the link order, and stops on failure.
+  echo 'int weakfunc(void) {return undefined_var;}' > tmp_link_error.c
+  link_success 'parallel jobs'         -j3 -DANS=22 tmp_link_weak1.c tmp_link_weak2.c tmp_link_weak3.c
+  link_error   'parallel jobs failure' -j3 -DANS=11 tmp_link_weak1.c tmp_link_error.c tmp_link_weak3.c
+  link_error   'invalid jobs' -j0 -DANS=22 tmp_link_weak1.c tmp_link_weak2.c tmp_link_weak3.c
+  link_error   'non-numeric jobs' -j3x -DANS=22 tmp_link_weak1.c tmp_link_weak2.c tmp_link_weak3.c
+  link_success 'too many jobs' -j100000 -DANS=22 tmp_link_weak1.c tmp_link_weak2.c tmp_link_weak3.c
+
+  link_success 'external assembler' -fno-integrated-as -DANS=22 tmp_link_weak1.c tmp_link_weak2.c tmp_link_weak3.c
+  link_success 'external preprocessor' -fno-integrated-cpp -DANS=22 tmp_link_weak1.c tmp_link_weak2.c tmp_link_weak3.c
+
+  end_test_suite
+}
+
+function test_binary_tokens() {
+  begin_test_suite "Binary tokens"
+
+  XCC="$XCC -fno-integrated-cpp -fbinary-tokens" try_direct 'binary tokens' 42 '#define CAT(a, b)  a##b
+    #define STR(x)  #x
+    int CAT(foo, bar) = 10;
+    int main(void) {
+      const char *s = "ab" "c" STR(d);
+      double d = 1.5e1;
+      return foobar + (int)d + (int)sizeof(L"ab") + (s[3] == (CAT(10, 0))) * 5;
+    }'
+  # Binary tokens carry no source text: the line is read from the file for diagnostics.
+  echo 'int main(void) {return undefined_var;}' > tmp_bintok_error.c
+  begin_test 'binary tokens error line'
+  local err='' output
+  output=$($XCC -fno-integrated-cpp -fbinary-tokens -c -o /dev/null tmp_bintok_error.c 2>&1)
+  grep -q -F 'int main(void) {return undefined_var;}' <<< "$output" || err='source line expected'
+  end_test "$err"
+
+  end_test_suite
+}
+
+function test_pch() {
+  begin_test_suite "Precompiled header"
+
+  # Precompiled header is used for the same macros, and ignored when the header is modified.
+  echo -e '#pragma once\ntypedef struct { int x; } Pch;\nenum { PCH_A = 11, PCH_B };\nint pch_twice(Pch *p);\n#define PCH_ANS(p)  (pch_twice(p) - PCH_B)' > tmp_pch.h
+  echo -e '#include "tmp_pch.h"\nint pch_twice(Pch *p) {return p->x * 2;}\nint main(void){Pch p = {5}; return !(PCH_ANS(&p) == ANS);}' > tmp_pch.c
+  eval "$XCC" -DANS=-2 tmp_pch.h
+  link_success 'precompiled header' -DANS=-2 tmp_pch.c
+  link_success 'precompiled header in external cpp' -fno-integrated-cpp -DANS=-2 tmp_pch.c
+  link_success 'precompiled header for other macro' -DANS=-2 -DOTHER tmp_pch.c
+  sed -i.bak 's/PCH_B }/PCH_B = 100 }/' tmp_pch.h
+  link_success 'precompiled header modified' -DANS=-90 tmp_pch.c
+
+  end_test_suite
+}
+
+function test_dependency() {
+  begin_test_suite "Dependency file"
+
+  # Dependency file lists the source and headers once, except system headers for -MMD.
+  echo -e '#pragma once\nextern int dep;' > tmp_dep.h
+  echo -e '#include "tmp_dep.h"\n#include <stdio.h>\n#include "tmp_dep.h"' > tmp_dep.c
+  for cpp_opt in -fintegrated-cpp -fno-integrated-cpp; do
+    begin_test "dependency file $cpp_opt"
+    rm -f tmp_dep.d
+    eval "$XCC" -c -MMD -MP "$cpp_opt" -o tmp_dep.o tmp_dep.c "$SILENT"
+    local err=''
+    diff <(echo -e 'tmp_dep.o: tmp_dep.c tmp_dep.h\n\ntmp_dep.h:') tmp_dep.d > /dev/null 2>&1 ||
+      err='unexpected dependency file'
+    end_test "$err"
+  done
+
+  end_test_suite
+}
+
+function test_embed() {
+  begin_test_suite "Embed"
+
+  # #embed puts the file contents as a byte list, through both preprocessors.
+  printf 'Hello\0\1\2' > tmp_embed.bin
+  echo -e 'static const unsigned char data[] = {\n#embed "tmp_embed.bin"\n};\nchar str[] = {\n#embed "tmp_embed.bin" limit(5) suffix(, 0)\n};\nint empty[] = {\n#embed "tmp_embed.bin" limit(0) if_empty(-1)\n};\nint main(void){int ints[] = {1,\n#embed "tmp_embed.bin" limit(2)\n}; return !(sizeof(data) == 8 && data[7] == 2 && sizeof(str) == 6 && str[4] == 111 && str[5] == 0 && empty[0] == -1 && ints[2] == 101);}' > tmp_embed.c
+  link_success 'embed' tmp_embed.c
+  link_success 'embed in external cpp' -fno-integrated-cpp tmp_embed.c
+  link_success 'embed in binary tokens' -fno-integrated-cpp -fbinary-tokens tmp_embed.c
+  printf 'Hi' > 'tmp_embed"q.bin'
+  echo -e 'const char s[] = {\n#embed <tmp_embed"q.bin> suffix(, 0)\n};\nint main(void){return !(s[0] == 72 && s[1] == 105 && s[2] == 0);}' > tmp_embed_quote.c
+  link_success 'embed path with quote' -I. -fno-integrated-cpp tmp_embed_quote.c
+
+  end_test_suite
+}
+
+function test_cache() {
+  begin_test_suite "Compile cache"
+
+  # Compile cache reuses objects only for the same preprocessed output.
+  echo '__attribute__((weak)) int cached(void) {return 11;} int main(void){return !(cached() == ANS);}' > tmp_cache1.c
+  echo 'int cached(void) {return 22;}' > tmp_cache2.c
+  echo '__attribute__((weak)) int cached(void) {return 33;}' > tmp_cache3.c
+  rm -rf tmp_cache
+  link_success 'compile cache'             -fcache-dir=tmp_cache -DANS=22 tmp_cache1.c tmp_cache2.c
+  link_success 'compile cache hit'         -fcache-dir=tmp_cache -DANS=22 tmp_cache1.c tmp_cache2.c
+  link_success 'compile cache other macro' -fcache-dir=tmp_cache -DANS=11 tmp_cache1.c
+  link_success 'compile cache parallel'     -fcache-dir=tmp_cache -j2 -DANS=11 tmp_cache1.c tmp_cache3.c
+  link_success 'compile cache parallel hit' -fcache-dir=tmp_cache -j2 -DANS=11 tmp_cache1.c tmp_cache3.c
+  # The preprocessed output refers to an embedded file by its path, so its bytes are in the key.
+  echo -e '#include <stdio.h>\nconst unsigned char data[] = {\n#embed "tmp_cache.bin"\n};\nint main(void){FILE *fp = fopen("tmp_cache.bin", "rb"); return fp == NULL || fgetc(fp) != data[0];}' > tmp_cache_embed.c
+  printf 'A' > tmp_cache.bin
+  link_success 'compile cache embed'          -fcache-dir=tmp_cache tmp_cache_embed.c
+  printf 'B' > tmp_cache.bin
+  link_success 'compile cache embed modified' -fcache-dir=tmp_cache tmp_cache_embed.c
+
+  end_test_suite
+}
+
+function test_report() {
+  begin_test_suite "Report"
+
+  echo 'int report(void) {return 22;}' > tmp_report1.c
+  echo 'int report(void); int main(void){return !(report() == 22);}' > tmp_report2.c
+  link_success 'time report' -ftime-report -fmem-report -fno-integrated-cpp -fno-integrated-as tmp_report1.c tmp_report2.c
+
   end_test_suite
 }
 
@@ -292,6 +440,8 @@ test_ssa() {
   begin_test_suite "SSA"
 
   try 'swap variables' 74 'int a = 7, b = 4; for (int i = 0; i < 2; ++i) { int d = a; a = b; b = d; } return a*10 + b;'
+  try 'rotate variables' 13 'unsigned a = 1, b = 2, c = 3, d = 4; for (int i = 0; i < 3; ++i) { unsigned t = d + i; d = c; c = b; b = a; a = t + (a ^ b); } return a + b + c + d;'
+  try_direct 'asm output' 16 'int f(unsigned long x) { unsigned long r = 1; if (x > 0) __asm("mov %1, %0" : "=r"(r) : "r"(x)); return r; } int main(void) { return f(16); }'
 
   echo 'int main(void) {int x = 1, y = 0; return x / y;}' > tmp_zerodiv.c
   link_success 'zero division (NOEXEC)' tmp_zerodiv.c
@@ -307,6 +457,18 @@ test_ssa() {
     return x;
   "
 
+  # Redundant computations and loads are removed at -O2, but not across a store or a call.
+  local gvn='struct S {int a, b;};
+    int f(struct S *s) {return s->a * s->b + (s->a * s->b >> 1);}
+    int g(struct S *s, int *p) {int x = s->a; *p = 5; return x + s->a;}
+    int h(struct S *s, int (*fn)(struct S*)) {int x = s->b; return x + fn(s) + s->b;}
+    static int bump(struct S *s) {return s->b += 10;}
+    int main(void) {struct S s = {3, 4}; int r = f(&s); r += g(&s, &s.a); return r + h(&s, bump);}'
+  XCC="$XCC -O2" try_asm 'gvn' '[[ $(count_asm f g mul) -eq 1 ]]' "$gvn"
+  XCC="$XCC -O2" try_direct 'gvn result' 58 "$gvn"
+
+  link_success 'pass options' -O1 -fno-pass=copy-propagation -fpass-stats -DANS=22 tmp_link_weak1.c tmp_link_weak2.c tmp_link_weak3.c
+
   end_test_suite
 }
 
@@ -315,9 +477,16 @@ test_struct
 test_bitfield
 test_initializer
 test_function
+test_inline
 test_error
 test_error_line
 test_link
+test_binary_tokens
+test_pch
+test_dependency
+test_embed
+test_cache
+test_report
 test_ssa
 
 if [[ $FAILED_SUITE_COUNT -ne 0 ]]; then
@@ -98,6 +98,32 @@ function try() {
   try_direct "$1" "$2" "int main(void){$3\n}"
 }
 
+# Compile to assembly `tmp_asm.s`, and evaluate `check` on it.
+function try_asm() {
+  local title="$1"
+  local check="$2"
+  local input="$3"
+
+  begin_test "$title"
+
+  echo -e "$input" > tmp_asm.c
+  eval "$XCC" -S -o tmp_asm.s tmp_asm.c "$SILENT" || {
+    end_test 'Compile failed'
+    return
+  }
+
+  local err=''; eval "$check" || err="check failed: ${check}"
+  end_test "$err"
+}
+
+# Count lines matching `pattern` in `tmp_asm.s`, from label `from` to label `to`.
+function count_asm() {
+  local from="$1"
+  local to="$2"
+  local pattern="$3"
+  sed -n "/^${from}:/,/^${to}:/p" tmp_asm.s | grep -c "$pattern"
+}
+
 function try_file() {
   local title="$1"
   local expected="$2"
@@ -0,0 +1,6 @@
+struct S {int a, b;};
+    int f(struct S *s) {return s->a * s->b + (s->a * s->b >> 1);}
+    int g(struct S *s, int *p) {int x = s->a; *p = 5; return x + s->a;}
+    int h(struct S *s, int (*fn)(struct S*)) {int x = s->b; return x + fn(s) + s->b;}
+    static int bump(struct S *s) {return s->b += 10;}
+    int main(void) {struct S s = {3, 4}; int r = f(&s); r += g(&s, &s.a); return r + h(&s, bump);}
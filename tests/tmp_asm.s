@@ -0,0 +1,134 @@
+
+	.text
+	.globl f
+	.p2align 1
+	.type f, @function
+f:
+	endbr64
+
+	mov (%rdi), %eax
+	add $4, %rdi
+	mov (%rdi), %edi
+	mov %eax, %esi
+	mov %esi, %eax
+	mul %edi
+	mov %eax, %esi
+	mov %esi, %eax
+	sar $1, %eax
+	mov %esi, %edi
+	add %eax, %edi
+	mov %edi, %eax
+
+	ret
+
+	.text
+	.globl g
+	.p2align 1
+	.type g, @function
+g:
+	endbr64
+
+	mov (%rdi), %eax
+	movl $5, (%rsi)
+	mov (%rdi), %edi
+	add %edi, %eax
+
+	ret
+
+	.text
+	.globl h
+	.p2align 1
+	.type h, @function
+h:
+	endbr64
+	push %rbx
+	push %r12
+	sub $8, %rsp
+
+	mov %rdi, %rbx
+	add $4, %rbx
+	mov (%rbx), %eax
+	mov %eax, %r12d
+	call *%rsi
+	mov %r12d, %edi
+	add %eax, %edi
+	mov (%rbx), %eax
+	add %eax, %edi
+	mov %edi, %eax
+
+	add $8, %rsp
+	pop %r12
+	pop %rbx
+	ret
+
+	.text
+	.globl main
+	.p2align 1
+	.type main, @function
+main:
+	endbr64
+	push %rbx
+	push %r12
+	push %rbp
+	mov %rsp, %rbp
+	sub $16, %rsp
+
+	lea -8(%rbp), %rbx
+	mov %rbx, %rax
+	mov $2, %rdi
+L.0013:
+	movl $0, (%rax)
+	mov %rax, %rsi
+	add $4, %rsi
+	mov %rdi, %rdx
+	dec %rdx
+	mov %rdx, %rcx
+	test %rcx, %rcx
+	je L.0014
+
+	mov %rsi, %rax
+	mov %rdx, %rdi
+	jmp L.0013
+L.0014:
+	movl $3, (%rbx)
+	lea -4(%rbp), %rax
+	movl $4, (%rax)
+	mov %rbx, %rdi
+	call f
+	mov %eax, %r12d
+	mov %rbx, %rsi
+	mov %rbx, %rdi
+	call g
+	mov %r12d, %edi
+	add %eax, %edi
+	mov %edi, %r12d
+	lea bump(%rip), %rax
+	mov %rax, %rsi
+	mov %rbx, %rdi
+	call h
+	mov %r12d, %edi
+	add %eax, %edi
+	mov %edi, %eax
+
+	mov %rbp, %rsp
+	pop %rbp
+	pop %r12
+	pop %rbx
+	ret
+
+	.text
+	.local bump
+	.p2align 1
+	.type bump, @function
+bump:
+	endbr64
+
+	mov %rdi, %rax
+	add $4, %rax
+	mov (%rax), %edi
+	add $10, %edi
+	mov %edi, (%rax)
+	mov %edi, %eax
+
+	ret
+
@@ -0,0 +1 @@
+int main(void) {return undefined_var;}
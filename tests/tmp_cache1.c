@@ -0,0 +1 @@
+__attribute__((weak)) int cached(void) {return 11;} int main(void){return !(cached() == ANS);}
@@ -0,0 +1 @@
+int cached(void) {return 22;}
@@ -0,0 +1 @@
+__attribute__((weak)) int cached(void) {return 33;}
@@ -0,0 +1,5 @@
+#include <stdio.h>
+const unsigned char data[] = {
+#embed "tmp_cache.bin"
+};
+int main(void){FILE *fp = fopen("tmp_cache.bin", "rb"); return fp == NULL || fgetc(fp) != data[0];}
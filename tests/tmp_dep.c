@@ -0,0 +1,3 @@
+#include "tmp_dep.h"
+#include <stdio.h>
+#include "tmp_dep.h"
@@ -0,0 +1,12 @@
+static const unsigned char data[] = {
+#embed "tmp_embed.bin"
+};
+char str[] = {
+#embed "tmp_embed.bin" limit(5) suffix(, 0)
+};
+int empty[] = {
+#embed "tmp_embed.bin" limit(0) if_empty(-1)
+};
+int main(void){int ints[] = {1,
+#embed "tmp_embed.bin" limit(2)
+}; return !(sizeof(data) == 8 && data[7] == 2 && sizeof(str) == 6 && str[4] == 111 && str[5] == 0 && empty[0] == -1 && ints[2] == 101);}
@@ -0,0 +1,4 @@
+const char s[] = {
+#embed <tmp_embed"q.bin> suffix(, 0)
+};
+int main(void){return !(s[0] == 72 && s[1] == 105 && s[2] == 0);}
@@ -0,0 +1 @@
+int foo; int main(){return 0;}
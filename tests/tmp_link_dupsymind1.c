@@ -0,0 +1 @@
+static int foo() {return 7;} int (*f)(void) = foo; extern int (*g)(void); int main(){return !(f() * 10 + g() == 73);}
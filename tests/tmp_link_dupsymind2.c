@@ -0,0 +1 @@
+static int foo() {return 3;} int (*g)(void) = foo;
@@ -0,0 +1 @@
+int sq(int x); int main(void){return !(sq(7) == 49);}
@@ -0,0 +1 @@
+__attribute__((weak)) int weakfunc(void) {return 11;} int main(void){return !(weakfunc() == ANS);}
@@ -0,0 +1,3 @@
+#include "tmp_pch.h"
+int pch_twice(Pch *p) {return p->x * 2;}
+int main(void){Pch p = {5}; return !(PCH_ANS(&p) == ANS);}
@@ -0,0 +1,5 @@
+#pragma once
+typedef struct { int x; } Pch;
+enum { PCH_A = 11, PCH_B = 100 };
+int pch_twice(Pch *p);
+#define PCH_ANS(p)  (pch_twice(p) - PCH_B)
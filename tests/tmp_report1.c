@@ -0,0 +1 @@
+int report(void) {return 22;}
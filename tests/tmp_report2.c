@@ -0,0 +1 @@
+int report(void); int main(void){return !(report() == 22);}
@@ -0,0 +1 @@
+int main(void) {int x = 1, y = 0; return x / y;}
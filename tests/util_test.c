@@ -1,3 +1,4 @@
+#include <ctype.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -53,6 +54,36 @@ TEST(sb) {
   EXPECT_EQ(true, sb_empty(&sb));
 }
 
+TEST(arena) {
+  Arena arena;
+  arena_init(&arena);
+
+  char *p = arena_alloc(&arena, 3);
+  char *q = arena_alloc(&arena, 5);
+  EXPECT_TRUE(p != q);
+  EXPECT_EQ(0, (intptr_t)q & 15);  // Aligned.
+
+  int *zeros = arena_calloc(&arena, sizeof(int) * 100);
+  int sum = 0;
+  for (int i = 0; i < 100; ++i)
+    sum += zeros[i];
+  EXPECT_EQ(0, sum);
+
+  // Large object and many small ones across chunks.
+  char *large = arena_alloc(&arena, 1024 * 1024);
+  memset(large, 0x55, 1024 * 1024);
+  char *last = NULL;
+  for (int i = 0; i < 10000; ++i) {
+    last = arena_alloc(&arena, 24);
+    last[0] = i;
+  }
+  EXPECT_EQ(0x55, large[1024 * 1024 - 1]);
+  EXPECT_EQ((char)9999, last[0]);
+
+  arena_release(&arena);
+  EXPECT_NULL(arena.chunks);
+}
+
 TEST(escape) {
   StringBuffer sb;
   sb_init(&sb);
@@ -60,6 +91,13 @@ TEST(escape) {
   static const char s1[] = "\"a b\tc\rd\ne\\\x1b";
   escape_string(s1, sizeof(s1), &sb);
   EXPECT_STREQ("escape_string", "\\\"a b\\tc\\rd\\ne\\\\\\x1b\\0", sb_to_string(&sb));
+
+  // Digits which would be taken in the preceding escape.
+  static const char s2[] = "\x1b" "a\0" "1\x7f" "9";
+  char buf[sizeof(s2) * 4];
+  size_t len = escape_chars(s2, sizeof(s2) - 1, buf);
+  buf[len] = '\0';
+  EXPECT_STREQ("escape_chars", "\\x1b\\x61\\0\\x31\\x7f\\x39", buf);
 }
 
 TEST(is_fullpath) {
@@ -109,4 +147,80 @@ TEST(change_ext) {
   EXPECT_STREQ("dir", "/foo/bar.baz/qux.s", change_ext("/foo/bar.baz/qux", "s"));
 }
 
+TEST(source_input) {
+  char str[] = "foo\r\nbar \\\nbaz\\\r\nqux\n\nlast";
+  SourceInput input;
+  set_source_input_string(&input, str, sizeof(str) - 1);
+
+  char *line;
+  int lineno = 0;
+  EXPECT_EQ(3, source_getline_cont(&input, &line, &lineno));
+  EXPECT_STREQ("CRLF", "foo", line);
+  EXPECT_EQ(1, lineno);
+  EXPECT_EQ(10, source_getline_cont(&input, &line, &lineno));
+  EXPECT_STREQ("Continue", "bar bazqux", line);
+  EXPECT_EQ(4, lineno);
+  EXPECT_EQ(0, source_getline_cont(&input, &line, &lineno));
+  EXPECT_EQ(4, source_getline(&input, &line));
+  EXPECT_STREQ("No LF at end", "last", line);
+  EXPECT_EQ(-1, source_getline(&input, &line));
+}
+
+TEST(data_reader) {
+  DataStorage data;
+  data_init(&data);
+  data_uleb128(&data, -1, 624485);
+  data_leb128(&data, -1, -123456);
+  data_string(&data, "foo", 4);
+
+  DataReader reader;
+  data_reader_init(&reader, data.buf, data.len);
+  EXPECT_EQ(624485, data_read_uleb128(&reader));
+  EXPECT_EQ(-123456, data_read_leb128(&reader));
+  size_t len;
+  const char *str = data_read_string(&reader, &len);
+  EXPECT_EQ(4, len);
+  EXPECT_STREQ("string", "foo", str);
+  EXPECT_FALSE(reader.error);
+  EXPECT_EQ(0, data_read_uleb128(&reader));
+  EXPECT_TRUE(reader.error);
+  data_release(&data);
+}
+
+TEST(scan) {
+  // Compare with byte by byte at every start offset, over runs across blocks.
+  static const char chars[] = " \t\n\rAz_09-\"\\*/\x80\xe3";
+  char buf[256] __attribute__((aligned(16)));
+  uint32_t seed = 1;
+  int failed = 0;
+  for (int round = 0; round < 200; ++round) {
+    for (size_t i = 0; i < sizeof(buf) - 1; ++i) {
+      seed = seed * 1103515245 + 12345;
+      // Long runs of the same class, to cover whole blocks.
+      int n = (seed >> 16) % 64 < 60 && i > 0 ? -1 : (int)((seed >> 16) % (sizeof(chars) - 1));
+      buf[i] = n < 0 ? buf[i - 1] : chars[n];
+    }
+    buf[sizeof(buf) - 1 - round % 32] = '\0';
+
+    for (const char *p = buf; *p != '\0'; ++p) {
+      const char *q;
+      for (q = p; isspace((unsigned char)*q); ++q)
+        ;
+      failed += skip_whitespaces(p) != q;
+      for (q = p; isalnum((unsigned char)*q) || *q == '_'; ++q)
+        ;
+      failed += skip_ident_chars(p) != q;
+      for (q = p; *q != '\0' && *q != '"' && *q != '\\' && *q != '*'; ++q)
+        ;
+      failed += find_char3(p, '"', '\\', '*') != q;
+    }
+  }
+  EXPECT_EQ(0, failed);
+
+  EXPECT_STREQ("skip_whitespaces", "x", skip_whitespaces(" \t\n\v\f\r x"));
+  EXPECT_STREQ("skip_ident_chars", "+b", skip_ident_chars("foo_Bar9+b"));
+  EXPECT_STREQ("find_char3", "*/", find_char3(" comment */", '*', '"', '\\'));
+  EXPECT_STREQ("find_char3 end", "", find_char3("no stop", '*', '"', '\\'));
+}
+
 XTEST_MAIN();
@@ -1266,6 +1266,18 @@ TTT:;
     EXPECT("shadow var", 10, x);
   }
 
+  {
+    int x = 2;
+    {
+      int a0 = 0, a1 = 1, a2 = 2, a3 = 3, a4 = 4, a5 = 5, a6 = 6, a7 = 7, a8 = 8, a9 = 9;
+      int b0 = 0, b1 = 1, b2 = 2, b3 = 3, b4 = 4, b5 = 5, b6 = 6, b7 = 7, b8 = 8, b9 = 9;
+      x += a0 + a1 + a2 + a3 + a4 + a5 + a6 + a7 + a8 + a9;
+      int x = b0 + b1 + b2 + b3 + b4 + b5 + b6 + b7 + b8 + b9;
+      EXPECT("many vars in scope", 45, x);
+    }
+    EXPECT("shadow var in many vars", 47, x);
+  }
+
   {
     typedef int Foo;
     {